@@ -0,0 +1,37 @@
+#!/bin/sh
+# Time RUNS (default 20) sorts of a LINES-line file (default 500,000):
+# plain, and through cached, where only the first run sorts.
+#
+#   [RUNS=n] [LINES=n] bench/cached_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+RUNS=${RUNS:-20}
+LINES=${LINES:-500000}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+awk -v n="$LINES" 'BEGIN { srand(1); for (i = 0; i < n; i++) print int(rand() * n) }' > "$DIR/big.txt"
+export MYSHELL_CACHE_DIR="$DIR/cache"
+
+for kind in plain cached; do
+    case $kind in
+        plain)  body="sort -n $DIR/big.txt | uniq | tail -1" ;;
+        cached) body="cached sort -n $DIR/big.txt | uniq | tail -1" ;;
+    esac
+    {
+        echo "i=0"
+        echo "while [ \$i -lt $RUNS ]; do"
+        echo "    $body"
+        echo "    i=\$((i + 1))"
+        echo "done"
+    } > "$DIR/$kind.sh"
+done
+
+for kind in plain cached; do
+    start=$(date +%s.%N)
+    "$MYSHELL" "$DIR/$kind.sh" > /dev/null || exit 1
+    end=$(date +%s.%N)
+    awk -v n="$kind" -v c="$RUNS" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-8s %8.3f s (%d runs)\n", n, e - s, c }'
+done
+exit 0
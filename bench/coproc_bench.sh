@@ -0,0 +1,50 @@
+#!/bin/sh
+# Time QUERIES (default 1,000) lookups answered by an external helper
+# (sed) in myshell and, when installed, bash: once with a new process per
+# query ($(...)) and once with one long-lived coprocess that gets a line
+# and answers with a line.
+#
+#   [QUERIES=n] bench/coproc_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+QUERIES=${QUERIES:-1000}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/fork.sh" <<EOF
+i=0
+while [ \$i -lt $QUERIES ]; do
+    r=\$(echo \$i | sed 's/.*/<&>/')
+    i=\$((i + 1))
+done
+echo "\$r"
+EOF
+
+cat > "$DIR/coproc.sh" <<EOF
+coproc sed -u 's/.*/<&>/'
+i=0
+while [ \$i -lt $QUERIES ]; do
+    echo \$i >&\${COPROC[1]}
+    read -r r <&\${COPROC[0]}
+    i=\$((i + 1))
+done
+echo "\$r"
+EOF
+
+run() {
+    name=$1
+    script=$2
+    shift 2
+    start=$(date +%s.%N)
+    "$@" "$script" > /dev/null || return
+    end=$(date +%s.%N)
+    awk -v n="$name" -v s="$start" -v e="$end" 'BEGIN { printf "%-8s %8.3f s\n", n, e - s }'
+}
+
+for kind in fork coproc; do
+    echo "$kind ($QUERIES queries):"
+    run myshell "$DIR/$kind.sh" "$MYSHELL"
+    command -v bash >/dev/null && run bash "$DIR/$kind.sh" bash
+done
+exit 0
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Time CALLS (default 200) runs of a two-stage pipeline from a C++ program:
+# through libmyshell (make lib), which runs it in the calling process, and
+# through popen(3), which starts /bin/sh for each one.
+#
+#   [CALLS=n] bench/embed_bench.sh [path/to/libmyshell.a]
+
+LIB=${1:-./build/libmyshell.a}
+CALLS=${CALLS:-200}
+CXX=${CXX:-g++}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+cat > "$DIR/bench.cpp" <<'EOF'
+#include "myshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static const char* SCRIPT = "echo hello world | tr a-z A-Z";
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 200;
+    size_t bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    myshell::Shell sh;
+    for (int i = 0; i < calls; i++) {
+        bytes += sh.run(SCRIPT).out.size();
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        FILE* p = popen(SCRIPT, "r");
+        char buf[256];
+        while (fgets(buf, sizeof buf, p) != nullptr) {
+            bytes += std::string(buf).size();
+        }
+        pclose(p);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> lib = mid - start, shell = end - mid;
+    std::printf("%-8s %8.3f s (%d calls)\n", "libmyshell", lib.count(), calls);
+    std::printf("%-8s %8.3f s (%d calls)\n", "popen", shell.count(), calls);
+    return bytes == 0;
+}
+EOF
+
+"$CXX" -std=c++17 -O2 -Iinclude "$DIR/bench.cpp" "$LIB" -ldl -pthread -o "$DIR/bench" || exit 1
+"$DIR/bench" "$CALLS"
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Time sending SIZE MiB (default 512) from one producer to three files and
+# to two consumers: through a tee process, and through the shell's own
+# fan-out (cmd > a > b), which moves the data with tee(2) and splice(2).
+#
+#   [SIZE=n] bench/fanout_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+SIZE=${SIZE:-512}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+head -c $((SIZE * 1024 * 1024)) /dev/zero > "$DIR/data"
+
+for kind in tee-files fanout-files tee-consumers fanout-consumers; do
+    case $kind in
+        tee-files)        body="cat $DIR/data | tee $DIR/a $DIR/b > $DIR/c" ;;
+        fanout-files)     body="cat $DIR/data > $DIR/a > $DIR/b > $DIR/c" ;;
+        tee-consumers)    body="cat $DIR/data | tee >(wc -c > $DIR/a) > >(wc -c > $DIR/b)" ;;
+        fanout-consumers) body="cat $DIR/data > >(wc -c > $DIR/a) > >(wc -c > $DIR/b)" ;;
+    esac
+    echo "$body" > "$DIR/$kind.sh"
+
+    start=$(date +%s.%N)
+    "$MYSHELL" "$DIR/$kind.sh" > /dev/null || exit 1
+    end=$(date +%s.%N)
+    awk -v n="$kind" -v m="$SIZE" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-16s %8.3f s (%d MiB)\n", n, e - s, m }'
+done
+exit 0
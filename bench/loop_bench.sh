@@ -0,0 +1,39 @@
+#!/bin/sh
+# Time a 1,000,000-iteration loop (six nested 10-item for-loops running `:`)
+# in myshell and, when installed, bash and dash.
+#
+#   bench/loop_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+cat > "$SCRIPT" <<'SH'
+for a in 0 1 2 3 4 5 6 7 8 9; do
+ for b in 0 1 2 3 4 5 6 7 8 9; do
+  for c in 0 1 2 3 4 5 6 7 8 9; do
+   for d in 0 1 2 3 4 5 6 7 8 9; do
+    for e in 0 1 2 3 4 5 6 7 8 9; do
+     for f in 0 1 2 3 4 5 6 7 8 9; do
+      :
+     done
+    done
+   done
+  done
+ done
+done
+SH
+
+run() {
+    name=$1
+    shift
+    start=$(date +%s.%N)
+    "$@" "$SCRIPT" || return
+    end=$(date +%s.%N)
+    awk -v n="$name" -v s="$start" -v e="$end" 'BEGIN { printf "%-8s %8.3f s\n", n, e - s }'
+}
+
+run myshell "$MYSHELL"
+command -v bash >/dev/null && run bash bash
+command -v dash >/dev/null && run dash dash
+exit 0
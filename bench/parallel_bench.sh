@@ -0,0 +1,39 @@
+#!/bin/sh
+# Time COUNT jobs (default 64) run one after another in a for loop, through
+# xargs -P and through the parallel builtin, JOBS at a time (default: one
+# per CPU, and at least 8 for the waiting jobs). Two kinds of job: one that
+# mostly waits (sleep 0.05) and one that computes (gzip of up to 2 MiB).
+#
+#   [COUNT=n] [JOBS=n] bench/parallel_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+COUNT=${COUNT:-64}
+JOBS=${JOBS:-$(nproc)}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+i=0
+while [ "$i" -lt "$COUNT" ]; do
+    seq 1 "$((i + 1))" 400000 | head -c 2097152 > "$DIR/in$i"
+    i=$((i + 1))
+done
+
+for kind in wait gzip; do
+    jobs=$JOBS
+    case $kind in
+        wait) job="sleep 0.05; :"; [ "$jobs" -lt 8 ] && jobs=8 ;;
+        gzip) job="gzip -c \"\$1\" | wc -c" ;;
+    esac
+    echo "for f in $DIR/in*; do sh -c '$job' _ \$f; done > /dev/null" > "$DIR/loop.sh"
+    echo "ls $DIR/in* | xargs -P $jobs -n 1 sh -c '$job' _ > /dev/null" > "$DIR/xargs.sh"
+    echo "parallel -j $jobs sh -c '$job' _ {} ::: $DIR/in* > /dev/null" > "$DIR/parallel.sh"
+
+    for runner in loop xargs parallel; do
+        start=$(date +%s.%N)
+        "$MYSHELL" "$DIR/$runner.sh" < /dev/null || exit 1
+        end=$(date +%s.%N)
+        awk -v n="$kind-$runner" -v j="$jobs" -v s="$start" -v e="$end" \
+            'BEGIN { printf "%-16s %8.3f s (%d at a time)\n", n, e - s, j }'
+    done
+done
+exit 0
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Time CALLS (default 1,000) filters of a short input in myshell: through
+# the sample logfilter plugin (make plugins), which runs in the shell, and
+# through grep, which is forked and executed each time.
+#
+#   [CALLS=n] bench/plugin_bench.sh [path/to/myshell] [path/to/logfilter.so]
+
+MYSHELL=${1:-./myshell}
+PLUGIN=${2:-./build/logfilter.so}
+CALLS=${CALLS:-1000}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+printf 'INFO start\nERROR disk full\nINFO done\n' > "$DIR/log"
+
+for kind in plugin grep; do
+    case $kind in
+        plugin) body="logfilter ERROR < $DIR/log" ;;
+        grep)   body="grep ERROR < $DIR/log" ;;
+    esac
+    {
+        echo "enable -f $PLUGIN logfilter"
+        echo "i=0"
+        echo "while [ \$i -lt $CALLS ]; do"
+        echo "    $body"
+        echo "    i=\$((i + 1))"
+        echo "done"
+    } > "$DIR/$kind.sh"
+done
+
+for kind in plugin grep; do
+    start=$(date +%s.%N)
+    "$MYSHELL" "$DIR/$kind.sh" > /dev/null || exit 1
+    end=$(date +%s.%N)
+    awk -v n="$kind" -v c="$CALLS" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-8s %8.3f s (%d calls)\n", n, e - s, c }'
+done
+exit 0
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Time `while read -r line` over a generated file (1 GiB unless SIZE_MB says
+# otherwise), fed both as a redirection and through a pipe, in myshell and,
+# when installed, bash and dash.
+#
+#   [SIZE_MB=n] bench/read_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+SIZE_MB=${SIZE_MB:-1024}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+yes 'the quick brown fox jumps over the lazy dog 0123456789' |
+    head -c $((SIZE_MB * 1024 * 1024)) > "$DIR/data"
+
+printf 'while read -r line; do :; done < %s\n' "$DIR/data" > "$DIR/file.sh"
+printf 'cat %s | while read -r line; do :; done\n' "$DIR/data" > "$DIR/pipe.sh"
+
+run() {
+    name=$1
+    script=$2
+    shift 2
+    start=$(date +%s.%N)
+    "$@" "$script" || return
+    end=$(date +%s.%N)
+    awk -v n="$name" -v s="$start" -v e="$end" 'BEGIN { printf "%-8s %8.3f s\n", n, e - s }'
+}
+
+for kind in file pipe; do
+    echo "$kind ($SIZE_MB MiB):"
+    run myshell "$DIR/$kind.sh" "$MYSHELL"
+    command -v bash >/dev/null && run bash "$DIR/$kind.sh" bash
+    command -v dash >/dev/null && run dash "$DIR/$kind.sh" dash
+done
+exit 0
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Time a CPU-bound line filter over LINES lines (default 2000000) as one
+# process, then replicated with | [N] filter | for N = 1, 2, 4, ... up to
+# the number of cores, in input order and unordered ([Nu]).
+#
+#   [LINES=n] [CORES=n] [MYSHELL_CHUNK_SIZE=s] bench/replicate_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+LINES=${LINES:-2000000}
+CORES=${CORES:-$(nproc)}
+FILTER="sed -E -e 's/([0-9])([0-9])/\\2\\1/g' -e 's/(.)(.*)\\1/<\\2>/' -e '/[13579]>/d'"
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+seq 1 "$LINES" | awk '{ print $1 * 7919 % 1000003, $1, $1 * 31 }' > "$DIR/data"
+
+run() {
+    echo "$2" > "$DIR/$1.sh"
+    start=$(date +%s.%N)
+    "$MYSHELL" "$DIR/$1.sh" > "$DIR/$1.out" || exit 1
+    end=$(date +%s.%N)
+    awk -v n="$1" -v s="$start" -v e="$end" 'BEGIN { printf "%-12s %8.3f s\n", n, e - s }'
+}
+
+run plain "cat $DIR/data | $FILTER"
+n=1
+while [ "$n" -le "$CORES" ]; do
+    run "[$n]" "cat $DIR/data | [$n] $FILTER"
+    cmp -s "$DIR/plain.out" "$DIR/[$n].out" || echo "[$n]: output differs" >&2
+    run "[${n}u]" "cat $DIR/data | [${n}u] $FILTER"
+    [ "$n" -eq "$CORES" ] && break
+    n=$((n * 2))
+    [ "$n" -gt "$CORES" ] && n=$CORES
+done
+exit 0
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Startup time of a 5,000-line script with and without the compiled script
+# cache (see include/script_cache.h).
+#
+#   bench/script_cache_bench.sh [path/to/myshell] [runs]
+
+MYSHELL=${1:-./myshell}
+RUNS=${2:-50}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+SCRIPT=$WORK/script.sh
+
+# 1,000 five-line blocks that never run anything expensive
+i=0
+while [ $i -lt 1000 ]; do
+    echo "if false; then"
+    echo "    for f in a b \"c d\" \$HOME/*.txt; do echo \"\$f\" > /dev/null; done"
+    echo "else"
+    echo "    v$i='value $i'"
+    echo "fi"
+    i=$((i + 1))
+done > "$SCRIPT"
+
+run() {
+    name=$1
+    start=$(date +%s.%N)
+    n=0
+    while [ $n -lt "$RUNS" ]; do
+        "$MYSHELL" "$SCRIPT" || return
+        n=$((n + 1))
+    done
+    end=$(date +%s.%N)
+    awk -v n="$name" -v s="$start" -v e="$end" -v r="$RUNS" \
+        'BEGIN { printf "%-8s %8.2f ms/run\n", n, (e - s) * 1000 / r }'
+}
+
+MYSHELL_CACHE_DIR= run parse
+MYSHELL_CACHE_DIR=$WORK/cache "$MYSHELL" "$SCRIPT"
+MYSHELL_CACHE_DIR=$WORK/cache run cached
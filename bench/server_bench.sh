@@ -0,0 +1,60 @@
+#!/bin/sh
+# Time CALLS (default 1,000) short command lines: each started as its own
+# shell with myshell -c, each sent to a myshell --server by a new
+# myshell --client, and each sent by one long-running client that links
+# libmyshell (make lib), as an orchestrator would.
+#
+#   [CALLS=n] [WORKERS=n] bench/server_bench.sh [path/to/myshell] [path/to/libmyshell.a]
+
+MYSHELL=${1:-./myshell}
+LIB=${2:-./build/libmyshell.a}
+CALLS=${CALLS:-1000}
+WORKERS=${WORKERS:-4}
+CXX=${CXX:-g++}
+COMMAND='x=$((6 * 7)); echo "answer $x"'
+
+DIR=$(mktemp -d)
+SOCKET="$DIR/server.sock"
+"$MYSHELL" --server "$SOCKET" "$WORKERS" &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; wait $SERVER; rm -rf "$DIR"' EXIT
+
+cat > "$DIR/client.cpp" <<'EOF'
+#include "server.h"
+
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    int calls = std::atoi(argv[2]);
+    for (int i = 0; i < calls; i++) {
+        if (run_client(argv[1], argv[3]) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+EOF
+"$CXX" -std=c++17 -O2 -Iinclude "$DIR/client.cpp" "$LIB" -ldl -pthread -o "$DIR/client" || exit 1
+while [ ! -S "$SOCKET" ]; do sleep 0.05; done
+
+for kind in c client linked; do
+    start=$(date +%s.%N)
+    case $kind in
+        linked)
+            "$DIR/client" "$SOCKET" "$CALLS" "$COMMAND" ;;
+        *)
+            i=0
+            while [ $i -lt "$CALLS" ]; do
+                if [ $kind = c ]; then
+                    "$MYSHELL" -c "$COMMAND"
+                else
+                    "$MYSHELL" --client "$SOCKET" "$COMMAND"
+                fi
+                i=$((i + 1))
+            done ;;
+    esac > /dev/null || exit 1
+    end=$(date +%s.%N)
+    awk -v n="$kind" -v c="$CALLS" -v s="$start" -v e="$end" \
+        'BEGIN { printf "%-8s %8.3f s (%d calls)\n", n, e - s, c }'
+done
+exit 0
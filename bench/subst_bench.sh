@@ -0,0 +1,46 @@
+#!/bin/sh
+# Time command substitutions of three kinds in myshell and, when installed,
+# bash and dash: 10,000 of a builtin ($(echo)), 10,000 file reads
+# ($(< file)) and 100 of an external command ($(env true)).
+#
+#   bench/subst_bench.sh [path/to/myshell]
+
+MYSHELL=${1:-./myshell}
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+echo hello > "$DIR/data"
+
+for kind in builtin file external; do
+    case $kind in
+        builtin)  body='x=$(echo hello)' ;;
+        file)     body="x=\$(< $DIR/data)" ;;
+        external) body='x=$(env true)' ;;
+    esac
+    if [ "$kind" = external ]; then
+        loop='for a in 0 1 2 3 4 5 6 7 8 9; do for b in 0 1 2 3 4 5 6 7 8 9; do'
+        done_='done; done'
+    else
+        loop='for a in 0 1 2 3 4 5 6 7 8 9; do for b in 0 1 2 3 4 5 6 7 8 9; do for c in 0 1 2 3 4 5 6 7 8 9; do for d in 0 1 2 3 4 5 6 7 8 9; do'
+        done_='done; done; done; done'
+    fi
+    printf '%s\n%s\n%s\n' "$loop" "$body" "$done_" > "$DIR/$kind.sh"
+done
+
+run() {
+    name=$1
+    script=$2
+    shift 2
+    start=$(date +%s.%N)
+    "$@" "$script" || return
+    end=$(date +%s.%N)
+    awk -v n="$name" -v s="$start" -v e="$end" 'BEGIN { printf "%-8s %8.3f s\n", n, e - s }'
+}
+
+for kind in builtin file external; do
+    echo "$kind:"
+    run myshell "$DIR/$kind.sh" "$MYSHELL"
+    command -v bash >/dev/null && run bash "$DIR/$kind.sh" bash
+    [ "$kind" != file ] && command -v dash >/dev/null && run dash "$DIR/$kind.sh" dash
+done
+exit 0
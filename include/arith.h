@@ -0,0 +1,20 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <cstdint>
+#include <string>
+
+// ============================================================================
+// Arithmetic Expansion
+// ============================================================================
+// 64-bit integer expressions with the C operators (plus ** and the
+// assignment forms), as used by $(( )), (( )) and let. Variables are read
+// from and assigned to the shell's variable table. Each distinct expression
+// text is parsed once and kept in compiled form, so expressions inside
+// loops are not re-parsed on every iteration.
+
+// Evaluate an expression whose $ expansions have already been done.
+// Returns false and sets `error` on a syntax or evaluation error.
+bool arith_eval(const std::string& expr, int64_t& result, std::string& error);
+
+#endif // ARITH_H
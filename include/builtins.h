@@ -4,6 +4,7 @@
 #include "shell.h"
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
 // ============================================================================
@@ -22,12 +23,43 @@ int builtin_help(const std::vector<std::string>& args);
 int builtin_export(const std::vector<std::string>& args);
 int builtin_unset(const std::vector<std::string>& args);
 int builtin_env(const std::vector<std::string>& args);
+int builtin_history(const std::vector<std::string>& args);
+int builtin_true(const std::vector<std::string>& args);
+int builtin_false(const std::vector<std::string>& args);
+int builtin_break(const std::vector<std::string>& args);
+int builtin_return(const std::vector<std::string>& args);
+int builtin_alias(const std::vector<std::string>& args);
+int builtin_unalias(const std::vector<std::string>& args);
+int builtin_let(const std::vector<std::string>& args);
+int builtin_declare(const std::vector<std::string>& args);
+int builtin_test(const std::vector<std::string>& args);
+int builtin_read(const std::vector<std::string>& args);
+int builtin_enable(const std::vector<std::string>& args);
+int builtin_cached(const std::vector<std::string>& args);
+int builtin_ulimit(const std::vector<std::string>& args);
+int builtin_parallel(const std::vector<std::string>& args);
 
 // ============================================================================
 // Built-in Registry
 // ============================================================================
 bool is_builtin(const std::string& name);
+bool is_loaded_builtin(const std::string& name);     // Added by enable -f
 BuiltinFunc get_builtin(const std::string& name);
+std::vector<std::string> builtin_names();
 void init_builtins();
 
+// ============================================================================
+// Function and Alias Registry
+// ============================================================================
+// Functions are stored as compiled bodies and run in-process. Command
+// names resolve as alias -> function -> builtin -> PATH. An alias stands
+// for words only: alias refuses a value with operators or redirections.
+
+void define_function(const std::string& name, std::shared_ptr<const Program> body);
+std::shared_ptr<const Program> find_function(const std::string& name);
+bool unset_function(const std::string& name);
+
+// Value of an alias; false if the name is not an alias
+bool find_alias(const std::string& name, std::string& value);
+
 #endif // BUILTINS_H
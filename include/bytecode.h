@@ -0,0 +1,83 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "syntax.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Instruction Set
+// ============================================================================
+// Control flow is compiled once into a flat instruction array, so loop
+// bodies are never re-tokenized or re-parsed on each iteration. The status
+// register is $? (g_context->last_exit_status).
+
+enum OpCode : uint8_t {
+    OP_RUN,              // a = pipeline: expand and execute it; b = 1: last
+                         // command of a subshell, may replace the process
+    OP_ASSIGN,           // a = pipeline whose only command holds assignments
+    OP_JUMP,             // a = target
+    OP_JUMP_IF_FAIL,     // a = target, taken when status != 0
+    OP_JUMP_IF_OK,       // a = target, taken when status == 0
+    OP_JUMP_IF_SHADOWED, // a = target, taken when a name in word list b is now
+                         // a function or an alias
+    OP_NOT,              // status = !status
+    OP_STATUS,           // status = a
+    OP_LOOP_ENTER,       // push a loop frame (saved status 0); a = 1: the loop
+                         // owns stdin unless a function shadows a name in word list b
+    OP_EXPAND,           // a = word list: push a loop frame iterating its fields
+    OP_EXPAND_ARGS,      // push a loop frame iterating "$@"
+    OP_NEXT,             // a = exit target, b = string (variable name)
+    OP_LOOP_SAVE,        // remember status in the innermost loop frame
+    OP_LOOP_EXIT,        // status = saved status; pop the loop frame
+    OP_POP,              // pop the innermost loop frame (break/continue)
+    OP_REDIRECT,         // a = redirect list: apply to the shell, saving fds
+    OP_RESTORE,          // undo the innermost OP_REDIRECT
+    OP_DEFINE,           // a = function body, b = string (function name)
+    OP_ARITH,            // a = string: evaluate, status = (value == 0)
+    OP_COND,             // a = word list: evaluate [[ ]], status 0, 1 or 2
+    OP_COPROC,           // a = pipeline (one stage) to start as a coprocess,
+                         // b = string (its name)
+    OP_RETURN            // end of the current code block
+};
+
+struct Instr {
+    OpCode op;
+    uint32_t a;
+    uint32_t b;
+};
+
+// One stage of a pipeline: a simple command, or a compound command whose
+// compiled body starts at `entry` (run in a child process). A stage with
+// `replicas` > 0 runs as that many copies over chunks of its input.
+struct Stage {
+    SimpleCommand command;
+    int32_t entry = -1;
+    uint32_t replicas = 0;
+    bool unordered = false;
+};
+
+struct PipelineTemplate {
+    std::vector<Stage> stages;
+    bool background = false;
+    std::vector<std::string> placement;  // confine options, unexpanded
+};
+
+// ============================================================================
+// Compiled Program
+// ============================================================================
+
+struct Program {
+    std::vector<Instr> code;
+    std::vector<PipelineTemplate> pipelines;
+    std::vector<std::vector<std::string>> word_lists;   // for-loop items, [[ ]] words (raw)
+    std::vector<std::vector<Redirect>> redirect_lists;  // compound redirections
+    std::vector<std::string> strings;                   // Variable/function names
+    std::vector<Program> functions;                     // Function bodies
+};
+
+// Compile a parsed script; execution starts at pc 0 and ends at OP_RETURN
+Program compile_script(const NodeList& list);
+
+#endif // BYTECODE_H
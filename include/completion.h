@@ -0,0 +1,21 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Tab Completion
+// ============================================================================
+
+// Start building the command trie (builtins + $PATH) on a background thread
+void completion_init();
+
+// Wait for any background refresh to finish (call before exit)
+void completion_shutdown();
+
+// Completion candidates for the word ending at cursor (line editor hook)
+std::vector<std::string> complete_line(const std::string& line, size_t cursor,
+                                       size_t& word_start);
+
+#endif // COMPLETION_H
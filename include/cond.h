@@ -0,0 +1,27 @@
+#ifndef COND_H
+#define COND_H
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Conditional Expressions
+// ============================================================================
+// test and [ evaluate arguments that are already expanded. [[ ... ]] gets
+// raw words and expands each operand only when it is reached, with no
+// field splitting or globbing. Its == and != match glob patterns, and =~
+// matches POSIX extended regular expressions (each compiled once) and sets
+// BASH_REMATCH. File predicates share one stat() per path until the shell
+// runs something that might change the file system.
+
+// Evaluate the arguments of test (without a closing ]); `error` is set when
+// the expression is malformed, and the status is then 2
+int test_eval(const std::vector<std::string>& args, std::string& error);
+
+// Evaluate [[ words ]]: status 0 (true), 1 (false) or 2 (error)
+int cond_eval(const std::vector<std::string>& raw_words);
+
+// Drop cached file status; called before anything other than a test runs
+void cond_forget_stats();
+
+#endif // COND_H
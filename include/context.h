@@ -0,0 +1,56 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "builtins.h"
+#include "env.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Shell Context
+// ============================================================================
+// Everything one shell instance owns: $?, variables, arrays, positional
+// parameters, and the builtin, function and alias tables. The standalone
+// shell runs in a single default context; an embedding program (see
+// myshell.h) gets one per myshell::Shell and switches g_context to it for
+// each call. Caches keyed by script text, and process-wide state such as
+// descriptors and signal dispositions, are shared.
+
+struct ShellArray {
+    ArrayKind kind = ARRAY_INDEXED;
+    std::vector<std::string> items;      // Indexed: element i
+    std::vector<bool> present;           // Indexed: element i is set
+    size_t count = 0;                    // Indexed: number of set elements
+    std::unordered_map<std::string, std::string> map;   // Associative
+};
+
+struct ShellContext {
+    int last_exit_status = 0;            // $?
+    bool running = true;                 // Cleared by `exit`
+    std::vector<int> pipe_status;        // Status of each stage of the last pipeline
+
+    // Variables (env.cpp)
+    std::map<std::string, std::string> env_vars;        // Exported
+    std::map<std::string, std::string> shell_vars;      // Not exported
+    std::vector<std::string> positional = {"myshell"};
+    std::unordered_map<std::string, ShellArray> arrays;
+    bool owns_environ = true;            // Exports are mirrored in the process
+                                         // environment; otherwise children get
+                                         // exactly env_vars
+
+    // Commands (builtins.cpp)
+    std::unordered_map<std::string, BuiltinFunc> builtins;
+    std::unordered_map<std::string, std::shared_ptr<const Program>> functions;
+    std::unordered_map<std::string, std::string> aliases;
+    std::unordered_map<std::string, BuiltinFunc> loaded;  // enable -f, and what each replaced
+
+    std::string cwd;                     // Embedded: working directory between calls
+};
+
+// The context commands currently run in
+extern ShellContext* g_context;
+
+#endif // CONTEXT_H
@@ -0,0 +1,31 @@
+#ifndef COPROC_H
+#define COPROC_H
+
+#include "shell.h"
+#include <string>
+
+// ============================================================================
+// Coprocesses
+// ============================================================================
+// coproc NAME command starts the command in the background with its
+// standard input and output on two pipes to the shell. ${NAME[0]} is the
+// shell's reading end, ${NAME[1]} its writing end and $NAME_PID the process
+// ID, so a long-lived helper answers each query with one write and one read
+// instead of a fork and exec:
+//
+//     coproc BC bc -l
+//     echo 's(1)' >&${BC[1]}; read -u ${BC[0]} answer
+//
+// The descriptors are close-on-exec, so other commands do not inherit them
+// unless redirected. The child is tracked by the SIGCHLD reaper; once it has
+// exited, NAME_PID and ${NAME[1]} are removed and the writing end closed,
+// while ${NAME[0]} stays open so that its remaining output can be read.
+// Starting another coprocess of the same name closes the old descriptors.
+
+// Start `cmd` as coprocess `name`; returns the status of the coproc command
+int start_coproc(const std::string& name, Command& cmd);
+
+// Catch up with coprocesses that have exited (cheap when there are none)
+void reap_coprocs();
+
+#endif // COPROC_H
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 // ============================================================================
 // Environment Variable Management
@@ -23,4 +24,63 @@ void unset_env(const std::string& name);
 // Get all environment variables
 const std::map<std::string, std::string>& get_all_env();
 
+// True if the variable is set (exported or shell-local), even if empty
+bool env_is_set(const std::string& name);
+
+// ============================================================================
+// Shell Variables
+// ============================================================================
+
+// Assign a variable: updates the environment if it is exported, otherwise
+// keeps it local to the shell (not passed to child processes)
+void set_var(const std::string& name, const std::string& value);
+
+// Move a shell-local variable into the environment (export NAME)
+void export_var(const std::string& name);
+
+// ============================================================================
+// Arrays
+// ============================================================================
+// Indexed arrays are stored contiguously (unset elements leave holes) and
+// associative arrays in a hash table. Arrays belong to the shell and are
+// never exported; $name refers to element 0 (key "0").
+
+enum ArrayKind {
+    ARRAY_NONE,          // Not an array
+    ARRAY_INDEXED,       // declare -a / name=(...)
+    ARRAY_ASSOCIATIVE    // declare -A
+};
+
+ArrayKind array_kind(const std::string& name);
+
+// Make `name` an array of the given kind, keeping a scalar value as
+// element 0; false if it is already an array of the other kind
+bool declare_array(const std::string& name, bool associative);
+
+// Remove every element, keeping the array's kind
+void clear_array(const std::string& name);
+
+// Element access. For indexed arrays `key` is a decimal index, negative
+// counting back from the end; an indexed array is created if `name` is not
+// an array yet. set_array_element() fails on an out-of-range index.
+bool get_array_element(const std::string& name, const std::string& key, std::string& value);
+bool set_array_element(const std::string& name, const std::string& key, const std::string& value);
+void append_array_element(const std::string& name, const std::string& value);
+void unset_array_element(const std::string& name, const std::string& key);
+
+// Set elements' values and keys, in index order for indexed arrays
+std::vector<std::string> array_values(const std::string& name);
+std::vector<std::string> array_keys(const std::string& name);
+size_t array_size(const std::string& name);
+
+// ============================================================================
+// Positional Parameters
+// ============================================================================
+
+// Replace $0, $1, ... ($0 is params[0])
+void set_positional_params(const std::vector<std::string>& params);
+
+// Current positional parameters ($0 first)
+const std::vector<std::string>& get_positional_params();
+
 #endif // ENV_H
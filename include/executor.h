@@ -2,6 +2,9 @@
 #define EXECUTOR_H
 
 #include "shell.h"
+#include <sys/types.h>
+#include <utility>
+#include <vector>
 
 // ============================================================================
 // Command Execution
@@ -10,13 +13,38 @@
 // Execute a complete pipeline
 int execute_pipeline(Pipeline& pipeline);
 
-// Execute a single command (called internally)
-int execute_command(Command& cmd, int input_fd, int output_fd);
+// Execute a single command (called internally), confined by `placement`
+int execute_command(Command& cmd, int input_fd, int output_fd,
+                    const Placement& placement = Placement());
 
-// Execute a built-in command (returns true if command was a built-in)
+// Execute an alias, function or built-in command in the current process
+// (returns false if the command must be run from PATH)
 bool execute_builtin(Command& cmd, int& exit_status);
 
+// Replace an alias in the command name position by its value (once)
+void expand_alias(Command& cmd);
+
 // Apply I/O redirections for a command
 int apply_redirections(const Command& cmd);
 
+// Apply a command's redirections to the shell process itself, saving the
+// replaced descriptors in `saved` (used for builtins and compound commands)
+int redirect_shell(const Command& cmd, std::vector<std::pair<int, int>>& saved);
+
+// Undo redirect_shell()
+void restore_shell_fds(std::vector<std::pair<int, int>>& saved);
+
+// Wait for a child and convert its status to a shell exit code
+int wait_for_child(pid_t pid);
+
+// Run `cmd` in a freshly forked child with its pipes already in place:
+// apply its redirections, then exec it or run it in this process; never
+// returns
+void run_in_child(Command& cmd);
+
+// Replace the current process (a subshell's child) with `cmd` if it is an
+// external command; returns false, having done nothing, for anything that
+// runs in the shell
+bool exec_external(Command& cmd);
+
 #endif // EXECUTOR_H
@@ -0,0 +1,24 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <sys/types.h>
+#include <vector>
+
+// ============================================================================
+// Output Fan-Out
+// ============================================================================
+// cmd > a > b >(c) sends the command's output to every target (zsh's
+// multios). The command writes into a pipe, and a pump process passes each
+// chunk on without copying it through user space: tee(2) duplicates it
+// into targets that are pipes, and splice(2) moves it into regular files
+// (one more tee into a private pipe per extra file). A chunk is copied
+// with read/write only for targets that support neither (terminals,
+// sockets) or that had room for just part of it. Every write blocks, so
+// the command runs no faster than its slowest consumer. A target that
+// goes away (EPIPE) is dropped, and the pump exits when none are left.
+
+// Start a pump feeding `outputs` (which it takes copies of); returns its
+// pid, with the pipe's writing end in `write_fd`, or -1 on failure
+pid_t start_fanout(const std::vector<int>& outputs, int& write_fd);
+
+#endif // FANOUT_H
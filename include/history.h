@@ -0,0 +1,34 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// ============================================================================
+// Command History
+// ============================================================================
+// Entries live in an append-only log ($HISTFILE, default ~/.myshell_history)
+// shared by every running shell. Appends take an exclusive flock; readers
+// mmap the file and index new records from the last offset they saw.
+
+// Append a command line to the log (blank lines and duplicates collapse)
+void history_add(const std::string& line);
+
+// Number of (deduplicated) entries
+size_t history_size();
+
+// Entry by age: n = 0 is the most recent; false if out of range
+bool history_get(size_t n, std::string& out);
+
+// The newest `max` entries, oldest first
+std::vector<std::string> history_list(size_t max);
+
+// Reverse search: newest entry containing query at or older than position n.
+// On success n is updated to the match position (pass n + 1 to continue).
+bool history_search(const std::string& query, size_t& n, std::string& out);
+
+// Drop all entries, truncating the shared log
+void history_clear();
+
+#endif // HISTORY_H
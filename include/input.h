@@ -0,0 +1,40 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string>
+
+// ============================================================================
+// Shared Input Buffers
+// ============================================================================
+// `read` must not consume input beyond its own record, since whatever runs
+// next may read the same descriptor. How far ahead it may read depends on
+// the descriptor:
+//   - owned: a loop that is the only reader (see input_own) gets 64 KiB
+//     reads, and records are served from a buffer shared by every read in
+//     the loop
+//   - seekable: a regular file is read in chunks, and the file offset is
+//     moved back to the end of the record
+//   - anything else (pipes, terminals): one byte per read(2)
+
+enum InputStatus {
+    INPUT_OK,            // Stopped at the delimiter or the byte limit
+    INPUT_EOF,           // End of input (`out` holds anything read before it)
+    INPUT_TIMEOUT,
+    INPUT_ERROR          // errno is set
+};
+
+// Append one record from `fd` to `out`: bytes up to `delim` (consumed but
+// not stored), or at most `limit` bytes. `timeout_ms` < 0 waits forever.
+InputStatus input_read(int fd, char delim, size_t limit, int timeout_ms, std::string& out);
+
+// True if input is ready on `fd` without blocking (read -t 0)
+bool input_ready(int fd);
+
+// Mark `fd` as owned by a loop that nothing else reads from, or release it.
+// Calls nest. On the last release unread buffered input of a seekable file
+// is given back; for a pipe it is discarded, so a loop may only own a pipe
+// that nothing reads after it.
+void input_own(int fd);
+void input_release(int fd);
+
+#endif // INPUT_H
@@ -0,0 +1,41 @@
+#ifndef LINEEDIT_H
+#define LINEEDIT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Line Editor Hooks
+// ============================================================================
+
+// Fetch the n-th most recent history entry (0 = newest); false if none
+using HistoryLookup = std::function<bool(size_t n, std::string& out)>;
+
+// Find the newest entry containing query that is older than `n`;
+// on success stores the entry and its position in `n`
+using HistorySearch = std::function<bool(const std::string& query, size_t& n,
+                                         std::string& out)>;
+
+// Return completion candidates for the word ending at `cursor`;
+// `word_start` receives the offset where that word begins
+using CompletionFunc = std::function<std::vector<std::string>(
+    const std::string& line, size_t cursor, size_t& word_start)>;
+
+// ============================================================================
+// Line Editor
+// ============================================================================
+
+// True when stdin/stdout are a terminal the editor can drive
+bool lineedit_available();
+
+// Read one line in raw mode with editing keys; sets eof on Ctrl+D / EOF
+std::string lineedit_read(const std::string& prompt, bool& eof);
+
+// Install history recall / reverse search providers
+void lineedit_set_history(HistoryLookup lookup, HistorySearch search);
+
+// Install the Tab completion provider
+void lineedit_set_completion(CompletionFunc complete);
+
+#endif // LINEEDIT_H
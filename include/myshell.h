@@ -0,0 +1,64 @@
+#ifndef MYSHELL_H
+#define MYSHELL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct ShellContext;
+
+// ============================================================================
+// Embedding API (libmyshell)
+// ============================================================================
+// Runs shell pipelines inside another program, without starting an
+// interpreter process for each one:
+//
+//     myshell::Shell sh;
+//     myshell::RunResult r = sh.run("sort | uniq -c", "b\na\nb\n");
+//     // r.out == "      1 a\n      2 b\n", r.stage_statuses == {0, 0}
+//
+// Each Shell has its own variables, functions, aliases, builtins and
+// working directory, kept from one call to the next. Its environment
+// starts as a copy of the process environment, and `export` changes only
+// what its commands see, never the process environment.
+//
+// Calls may come from any thread and may nest (a plugin builtin may run a
+// script of its own); they are serialized, since a run temporarily takes
+// over the process's standard descriptors and working directory. Nothing
+// reaps a background command (`cmd &`) but the host's own SIGCHLD handling.
+
+namespace myshell {
+
+struct RunResult {
+    int status = 0;                      // Exit status of the script ($?)
+    std::vector<int> stage_statuses;     // Of each stage of the last pipeline run
+    std::string out;                     // Everything written to standard output
+    std::string err;                     // ... and to standard error
+};
+
+class Shell {
+public:
+    Shell();
+    ~Shell();
+    Shell(const Shell&) = delete;
+    Shell& operator=(const Shell&) = delete;
+
+    // Parse, compile and run `script` with `input` as its standard input.
+    // A syntax error gives status 2 and the message in `err`. Compiled
+    // scripts are kept, so running the same text again skips parsing.
+    RunResult run(const std::string& script, const std::string& input = "");
+
+    // The syntax error in `script`, or an empty string if it parses
+    static std::string check(const std::string& script);
+
+    // Shell variables; exported ones are passed to commands
+    std::string get_var(const std::string& name);
+    void set_var(const std::string& name, const std::string& value, bool exported = false);
+
+private:
+    std::unique_ptr<ShellContext> context_;
+};
+
+} // namespace myshell
+
+#endif // MYSHELL_H
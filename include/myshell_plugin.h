@@ -0,0 +1,66 @@
+#ifndef MYSHELL_PLUGIN_H
+#define MYSHELL_PLUGIN_H
+
+// ============================================================================
+// Loadable Builtin Plugin ABI
+// ============================================================================
+// A plugin is a shared object loaded with `enable -f lib.so name ...`. It
+// defines one symbol, MYSHELL_PLUGIN_SYMBOL, describing the builtins it
+// provides; each named one is added to the shell's builtin table and then
+// runs in the shell process, without a fork or exec:
+//
+//     static int hello(int argc, char** argv, int in_fd, int out_fd,
+//                      const myshell_api* api) { ... }
+//
+//     static const myshell_builtin builtins[] = {
+//         {"hello", hello},
+//         {NULL, NULL}
+//     };
+//     const myshell_plugin myshell_plugin_info = {MYSHELL_PLUGIN_ABI, builtins};
+//
+// The interface is plain C so plugins can be written in C or C++ (declare
+// the symbol extern "C"). The shell refuses plugins built for another
+// MYSHELL_PLUGIN_ABI; the number changes whenever these structures do.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MYSHELL_PLUGIN_ABI 1
+#define MYSHELL_PLUGIN_SYMBOL "myshell_plugin_info"
+
+// Access to shell variables, valid only during a call
+typedef struct myshell_api {
+    unsigned int abi_version;
+
+    // Value of a variable, or NULL if it is unset. The string stays valid
+    // until the next get_var call.
+    const char* (*get_var)(const char* name);
+
+    // Assign or remove a shell variable (exported ones update the
+    // environment); 0 on success, -1 if `name` is not a valid identifier
+    int (*set_var)(const char* name, const char* value);
+    int (*unset_var)(const char* name);
+} myshell_api;
+
+// argv[0] is the builtin's name and argv[argc] is NULL. Input is read from
+// in_fd and output written to out_fd (the command's redirections and pipes
+// are already applied to them). Returns the exit status.
+typedef int (*myshell_builtin_fn)(int argc, char** argv, int in_fd, int out_fd,
+                                  const myshell_api* api);
+
+typedef struct myshell_builtin {
+    const char* name;
+    myshell_builtin_fn run;
+} myshell_builtin;
+
+typedef struct myshell_plugin {
+    unsigned int abi_version;            // MYSHELL_PLUGIN_ABI when built
+    const myshell_builtin* builtins;     // Ends with a NULL name
+} myshell_plugin;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MYSHELL_PLUGIN_H
@@ -0,0 +1,31 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Parallel Jobs
+// ============================================================================
+// parallel [-j N] [-k] COMMAND [ARGS...] ::: INPUT... runs COMMAND once per
+// INPUT (or per line of standard input without :::), at most N at a time
+// (default: one per CPU). In the command's words {} stands for the input,
+// {.} for it without its extension and {/} for its last path component;
+// with none of them the input is added as a last argument.
+//
+// Each job is forked from the shell and run like a pipeline stage, so
+// aliases, functions and builtins work, with /dev/null as its input. A job
+// slot that frees up takes the next input at once, so short and long jobs
+// even out without a fixed split of the inputs. A job's standard output
+// and error are held until it finishes and then written out together, so
+// jobs never interleave; with -k they also come out in input order, and
+// once the jobs behind the oldest unwritten one hold N MiB of output, no
+// new job starts and they wait until it finishes.
+// Failed jobs are listed on standard error at the end.
+
+// Run the jobs; returns the number of failed jobs (at most 101), or
+// 128 + SIGINT if interrupted
+int parallel_run(const std::vector<std::string>& command, const std::vector<std::string>& inputs,
+                 unsigned jobs, bool keep_order);
+
+#endif // PARALLEL_H
@@ -11,13 +11,25 @@
 
 // Token types
 enum TokenType {
-    TOKEN_WORD,          // Regular word/argument
+    TOKEN_WORD,          // Word/argument (raw text, quotes kept until expansion)
     TOKEN_PIPE,          // |
     TOKEN_REDIRECT_IN,   // <
     TOKEN_REDIRECT_OUT,  // >
     TOKEN_REDIRECT_APPEND, // >>
     TOKEN_REDIRECT_ERR,  // 2>
+    TOKEN_DUP_IN,        // <&
+    TOKEN_DUP_OUT,       // >&
+    TOKEN_DUP_ERR,       // 2>&
     TOKEN_BACKGROUND,    // &
+    TOKEN_AND_IF,        // &&
+    TOKEN_OR_IF,         // ||
+    TOKEN_SEMI,          // ;
+    TOKEN_NEWLINE,       // Line break (command separator)
+    TOKEN_LPAREN,        // (
+    TOKEN_RPAREN,        // )
+    TOKEN_ARITH,         // (( expression )) -- value is the expression
+    TOKEN_HEREDOC,       // << or <<- -- value is the body; the delimiter word follows
+    TOKEN_HERESTRING,    // <<<
     TOKEN_END            // End of input
 };
 
@@ -33,15 +45,53 @@ struct Token {
 // Parser Functions
 // ============================================================================
 
-// Tokenize input line respecting quotes and escapes
-std::vector<Token> tokenize(const std::string& line);
+// Tokenize input respecting quotes and escapes. Sets *incomplete when the
+// input ends inside a quote or after a trailing backslash.
+std::vector<Token> tokenize(const std::string& line, bool* incomplete = nullptr);
 
 // Parse tokens into a pipeline of commands
 Pipeline parse(const std::string& line);
 
-// Expand environment variables in a string
+// Expand environment variables (and command substitutions) in a string
 std::string expand_variables(const std::string& input);
 
+// Expand a raw word: quote removal, parameters, field splitting, globbing.
+// May produce zero fields (e.g. an unquoted empty variable) or several.
+std::vector<std::string> expand_word(const std::string& raw);
+
+// Expand a raw word to exactly one string (no splitting or globbing),
+// as used for redirection targets and assignment values
+std::string expand_word_single(const std::string& raw);
+
+// Expand a raw word to a wildcard pattern: every quoted character (and
+// each character of a quoted expansion) is escaped with a backslash
+std::string expand_pattern(const std::string& raw);
+
+// Expand the body of a here-document with an unquoted delimiter: $ and `
+// substitutions, and backslash before $ ` \ or a newline
+std::string expand_here_document(const std::string& body);
+
+// True if a raw word is an assignment: NAME=value, NAME+=value,
+// NAME[subscript]=value or NAME=( words )
+bool is_assignment_word(const std::string& raw);
+
+// Expand and perform an assignment word; false (after reporting it) on an
+// expansion error or a bad array subscript
+bool assign_word(const std::string& raw);
+
+// Split NAME[subscript] and evaluate the subscript to a key of that array
+// (arithmetic for indexed arrays); false if `ref` has no subscript or the
+// subscript is invalid
+bool array_element_ref(const std::string& ref, std::string& name, std::string& key);
+
+// Set when an expansion fails (e.g. bad arithmetic); the command that was
+// being expanded is not run and its status is 1
+extern bool g_expansion_error;
+
+// Index of the ')' matching the '(' at `open` (quotes and nested parens
+// skipped), or std::string::npos if it is missing
+size_t find_closing_paren(const std::string& text, size_t open);
+
 // Expand wildcards in arguments
 std::vector<std::string> expand_wildcards(const std::string& pattern);
 
@@ -0,0 +1,63 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <string>
+#include <sys/resource.h>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Resource Limits
+// ============================================================================
+// The limits `ulimit` and `confine` know, by option letter. Sizes are given
+// in units of `unit` bytes (KiB, as in other shells), or as "unlimited".
+
+struct ResourceLimit {
+    char option;
+    int resource;                        // RLIMIT_*
+    rlim_t unit;
+    const char* description;
+    const char* unit_name;
+};
+
+const std::vector<ResourceLimit>& resource_limits();
+const ResourceLimit* find_resource_limit(char option);
+
+// Parse a limit given to `-option`; false if it is not a number (or
+// "unlimited")
+bool parse_limit(const std::string& text, const ResourceLimit& limit, rlim_t& value);
+std::string format_limit(rlim_t value, const ResourceLimit& limit);
+
+// ============================================================================
+// Job Placement
+// ============================================================================
+// confine [-C CPUS] [-P] [-N INC] [-I CLASS[:LEVEL]] [-v|-t|-n|... LIMIT] pipeline
+// runs every process of the pipeline on the CPUs in CPUS ("0-3,6"), with
+// its nice value raised by INC, in I/O scheduling class CLASS (idle,
+// best-effort, realtime or 1-3; LEVEL 0-7), and under the given resource
+// limits (soft and hard; the lower-case options of ulimit). With -P the
+// stages are pinned one CPU each, in order, to neighbouring CPUs of the
+// set (the shell's own set without -C). All of it is applied in each
+// child just before it runs its command, so the shell itself is never
+// affected; a builtin in a confined pipeline therefore runs in a child.
+
+struct Placement {
+    std::vector<int> cpus;               // Empty: wherever the shell may run
+    bool spread = false;                 // Stage i on cpus[i % cpus.size()]
+    int nice = 0;                        // Added to the nice value
+    int io_priority = -1;                // ioprio_set() value, -1 to leave as is
+    std::vector<std::pair<int, rlim_t>> limits;   // (RLIMIT_*, value)
+    bool active = false;                 // Any option was given
+
+    bool empty() const { return !active; }
+};
+
+// Parse confine's (expanded) option words; prints a message and returns
+// false if one is invalid
+bool parse_placement(const std::vector<std::string>& words, Placement& placement);
+
+// In the child for pipeline stage `stage`, just before it runs: apply
+// `placement`; prints a message and returns false on failure
+bool apply_placement(const Placement& placement, size_t stage);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,21 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "builtins.h"
+#include <string>
+
+// ============================================================================
+// Plugin Loading
+// ============================================================================
+// Shared objects are opened once (dlopen) and stay loaded for the life of
+// the shell, since builtins taken from them may still be registered. See
+// myshell_plugin.h for the interface a plugin implements.
+
+// Find builtin `name` in the plugin at `path` (opened like dlopen(3): a
+// path without a slash is looked up in the library search path). Returns
+// false with `error` set if the file cannot be loaded, was built for
+// another ABI version or has no such builtin.
+bool load_plugin_builtin(const std::string& path, const std::string& name,
+                         BuiltinFunc& func, std::string& error);
+
+#endif // PLUGIN_H
@@ -0,0 +1,30 @@
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include "shell.h"
+
+// ============================================================================
+// Replicated Pipeline Stages
+// ============================================================================
+// `producer | [N] filter | consumer` runs N copies of `filter` side by side.
+// The stage's process hands out its input in chunks of whole lines (at
+// least $MYSHELL_CHUNK_SIZE bytes each, default 1M; K, M and G suffixes
+// allowed), so it only suits filters that treat each line on its own.
+//   - [N]: output comes out in input order. Each chunk gets a copy of its
+//     own, since a long-lived copy could not mark where one chunk's output
+//     ends; at most N run at once. Output of later chunks is held in
+//     memory until its turn, up to N chunk sizes of it; beyond that the
+//     other copies are left to block until the oldest one finishes.
+//   - [Nu]: N long-lived copies each take the next chunk when idle, and
+//     their output is passed on one complete line at a time, in whatever
+//     order it comes.
+// Empty input still runs one copy. The stage succeeds if any copy did
+// (like one grep over the whole input), else it takes a failed copy's
+// status.
+
+// Run `cmd` (whose redirections are already applied) as cmd.replicas
+// copies over standard input; returns the stage's status. Only called in
+// the stage's own child process.
+int run_replicated(const Command& cmd);
+
+#endif // REPLICATE_H
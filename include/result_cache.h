@@ -0,0 +1,47 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Command Result Cache
+// ============================================================================
+// cached COMMAND... runs a deterministic command once and replays its
+// standard output, standard error and exit status on later runs with the
+// same inputs. The key covers:
+//   - the arguments, the working directory and the executable found in PATH
+//   - PATH, LANG and LC_* and any variables named with -e
+//   - the path, size, mtime and inode of every existing file or directory
+//     named by an argument (or by a word inside one, as in --in=big.txt or
+//     'sort big.txt'), and of any files named with -f. For a directory
+//     this covers every entry below it too; a command given a directory
+//     of more than 20000 entries runs without the cache.
+//   - standard input: a regular file's identity and offset, or the content
+//     of a pipe, which is read in full first and then fed to the command
+//     (even if it names input files, as awk -f prog.awk does). -n gives
+//     the command /dev/null and leaves a pipe unread.
+//
+// Results live in $MYSHELL_CACHE_DIR/results (see script_cache.h): output
+// is stored once per distinct content under objects/ (compared byte for
+// byte, not just by hash), and entries/ maps each key to its objects and
+// status. An index file keeps their sizes and use order, so that a run
+// never rescans the store. Entries are evicted least recently used first
+// once the store exceeds $MYSHELL_RESULT_CACHE_SIZE bytes
+// (K, M or G suffix; default 256M). Only output is replayed, so the command
+// must have no other effects, and its output appears once it has finished,
+// standard error after standard output. Runs stopped by a signal are not
+// stored.
+
+// Run argv[0] with arguments argv[1...] through the cache, with /dev/null
+// as its input if `no_stdin`; returns its (possibly replayed) exit status
+int cached_run(const std::vector<std::string>& argv, const std::vector<std::string>& env_names,
+               const std::vector<std::string>& files, bool no_stdin);
+
+// Print entry, object, size, hit and miss counts (cached --stats)
+int result_cache_stats();
+
+// Remove every stored result (cached --clear)
+int result_cache_clear();
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,26 @@
+#ifndef SCRIPT_CACHE_H
+#define SCRIPT_CACHE_H
+
+#include "bytecode.h"
+#include <string>
+
+// ============================================================================
+// Compiled Script Cache
+// ============================================================================
+// Compiled scripts are stored as versioned, position-independent binary
+// files named after a hash of the script text, in $MYSHELL_CACHE_DIR
+// (default $XDG_CACHE_HOME/myshell or ~/.cache/myshell). Setting
+// MYSHELL_CACHE_DIR to an empty string disables the cache.
+
+// Root of the on-disk caches ("" when disabled), shared with the result
+// cache, and mkdir -p for directories under it
+std::string cache_dir();
+bool make_dirs(const std::string& dir);
+
+// Load the compiled form of `text`; false if missing, stale or corrupt
+bool script_cache_load(const std::string& text, Program& prog);
+
+// Save the compiled form of `text` (errors are silently ignored)
+void script_cache_store(const std::string& text, const Program& prog);
+
+#endif // SCRIPT_CACHE_H
@@ -0,0 +1,40 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+// ============================================================================
+// Server Mode
+// ============================================================================
+// myshell --server SOCKET [WORKERS] initializes the shell once and keeps
+// WORKERS (default 4) forked copies of it waiting on a UNIX stream socket.
+// Each worker serves one request and exits, so every command line starts
+// from the same freshly initialized state, and the server forks a
+// replacement while the next request is served by an idle worker. SIGTERM,
+// SIGINT or SIGHUP stops the server and its workers and removes the socket.
+// The socket is created mode 0600 and a worker drops any connection from
+// a user other than the server's; an existing file that is not a socket
+// is left alone and the server does not start.
+//
+// A request is one frame, a 32-bit payload length in host byte order and
+// then the payload, a sequence of NUL-terminated strings:
+//
+//     COMMAND \0 CWD \0 [NAME=VALUE \0 | NAME \0]...
+//
+// The environment entries export NAME=VALUE or unset NAME, on top of the
+// server's environment. Descriptors passed with the frame (SCM_RIGHTS)
+// become the command's standard input, output and error in that order;
+// any not passed are /dev/null. When the command line has run, the worker
+// replies with its exit status as a 32-bit integer and closes the
+// connection.
+//
+// myshell --client SOCKET COMMAND... sends its own working directory,
+// environment and descriptors 0-2, and exits with the returned status.
+
+// Serve requests on `path` with `workers` worker processes until stopped
+int run_server(const std::string& path, int workers);
+
+// Have the server on `path` run `command`; returns its exit status
+int run_client(const std::string& path, const std::string& command);
+
+#endif // SERVER_H
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <cstdint>
+#include "placement.h"
 
 // ============================================================================
 // Error Codes
@@ -23,31 +26,41 @@ enum ShellError {
 // ============================================================================
 // Data Structures
 // ============================================================================
+struct Program;
+
 struct Command {
     std::vector<std::string> args;      // Command and arguments
     std::string input_file;              // Input redirection (<)
+    std::string here_input;              // Here-document or here-string text
+    bool has_here_input = false;         // Feed here_input to stdin (<<, <<<)
     std::string output_file;             // Output redirection (> or >>)
     bool append_output = false;          // true for >>, false for >
+    std::vector<std::pair<std::string, bool>> more_outputs;  // cmd > a > b: earlier (path, append)
     std::string error_file;              // Error redirection (2>)
+    int input_dup = -1;                  // <&N
+    int output_dup = -1;                 // >&N
+    int error_dup = -1;                  // 2>&N
+    bool error_dup_first = false;        // 2>&N came before the > redirection
     bool background = false;             // Run in background (&)
+    std::vector<std::pair<std::string, std::string>> assignments;  // VAR=val cmd
+    const Program* body = nullptr;       // Compound command run by the VM
+    uint32_t body_entry = 0;             // Entry point of body
+    bool alias_expanded = false;         // Aliases already applied to args
+    uint32_t replicas = 0;               // | [N] cmd |: run as N copies (see replicate.h)
+    bool unordered = false;              // [Nu]: copies' output in any order
     
-    bool empty() const { return args.empty(); }
+    bool empty() const { return args.empty() && body == nullptr; }
     std::string name() const { return args.empty() ? "" : args[0]; }
 };
 
 struct Pipeline {
     std::vector<Command> commands;       // Commands connected by pipes
     bool background = false;             // Entire pipeline in background
+    Placement placement;                 // confine options (see placement.h)
     
     bool empty() const { return commands.empty(); }
 };
 
-// ============================================================================
-// Global State
-// ============================================================================
-extern int g_last_exit_status;           // Exit status of last command ($?)
-extern bool g_running;                   // Main loop control
-
 // ============================================================================
 // Error Handling Functions
 // ============================================================================
@@ -61,7 +74,8 @@ const char* shell_strerror(ShellError code);
 void shell_init();
 void shell_cleanup();
 void shell_loop();
-std::string read_line();
+std::string read_line(const std::string& prompt = "myshell> ");
 void execute_line(const std::string& line);
+void execute_script(const std::string& text);
 
 #endif // SHELL_H
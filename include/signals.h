@@ -10,6 +10,9 @@
 // Current foreground process group (0 if none)
 extern volatile sig_atomic_t g_foreground_pid;
 
+// Set when Ctrl+C reaches the shell; running scripts and loops stop
+extern volatile sig_atomic_t g_interrupted;
+
 // Setup signal handlers for the shell process
 void setup_shell_signals();
 
@@ -22,4 +25,17 @@ void sigchld_handler(int sig);
 // SIGINT handler - for the shell (ignore)
 void sigint_handler(int sig);
 
+// Block SIGCHLD while foreground children are started and waited for, so
+// the reaper cannot collect them first; restore the mask afterwards
+void block_sigchld(sigset_t* old_mask);
+void restore_sigmask(const sigset_t* old_mask);
+
+// A background child whose exit the shell wants to know about (the reaper
+// collects it either way). track_child() must be called with SIGCHLD
+// blocked; it fails when every slot is taken.
+bool track_child(pid_t pid);
+
+// -1 while a tracked child runs, then its exit status (the slot is freed)
+int tracked_child_status(pid_t pid);
+
 #endif // SIGNALS_H
@@ -0,0 +1,40 @@
+#ifndef SUBST_H
+#define SUBST_H
+
+#include <string>
+
+// ============================================================================
+// Command Substitution
+// ============================================================================
+// $(...) and `...` run a script and expand to its standard output with
+// trailing newlines removed. $(< file) and simple side-effect-free builtins
+// (echo, pwd, true, false, :) are evaluated in-process; anything else runs
+// in a forked child whose output is read through a pipe.
+
+// Status of the last command substitution performed (-1 if none since
+// the variable was reset); used as $? for assignment-only commands
+extern int g_substitution_status;
+
+// Run `script` and capture its output; returns the script's exit status
+int command_substitution(const std::string& script, std::string& output);
+
+// ============================================================================
+// Process Substitution
+// ============================================================================
+// <(...) and >(...) start `script` at once, connected to a pipe, and expand
+// to the /dev/fd path of the shell's end of it, which the command being
+// expanded inherits. The processes and descriptors stay registered until
+// the pipeline that used them has finished.
+
+// Start `script` with its stdout (or, for >(...), its stdin) on a pipe
+std::string process_substitution(const std::string& script, bool feeds_script);
+
+// Number of process substitutions currently registered, to pass to
+// finish_process_substitutions() once the command using them is done
+size_t process_substitution_mark();
+
+// Close the shell's pipe ends registered after `mark`, then reap their
+// processes (or leave them running, for a background pipeline)
+void finish_process_substitutions(size_t mark, bool wait);
+
+#endif // SUBST_H
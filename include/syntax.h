@@ -0,0 +1,106 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Command Templates (unexpanded)
+// ============================================================================
+// Words keep their quotes; expansion happens each time the command runs.
+
+enum RedirType {
+    REDIR_IN,            // <
+    REDIR_OUT,           // >
+    REDIR_APPEND,        // >>
+    REDIR_ERR,           // 2>
+    REDIR_HEREDOC,       // << WORD -- target is the body, expanded when run
+    REDIR_HEREDOC_LITERAL, // << 'WORD' -- target is the body, used as is
+    REDIR_HERESTRING,    // <<< word
+    REDIR_DUP_IN,        // <&N -- target is the descriptor number
+    REDIR_DUP_OUT,       // >&N
+    REDIR_DUP_ERR        // 2>&N
+};
+
+struct Redirect {
+    RedirType type;
+    std::string target;                  // Raw word
+};
+
+struct SimpleCommand {
+    std::vector<std::string> assigns;    // Leading NAME=value words
+    std::vector<std::string> words;      // Command name and arguments
+    std::vector<Redirect> redirects;
+};
+
+// ============================================================================
+// Syntax Tree
+// ============================================================================
+
+enum NodeType {
+    NODE_COMMAND,        // Simple command
+    NODE_PIPELINE,       // Stages joined by |
+    NODE_IF,             // if/elif/else/fi
+    NODE_WHILE,          // while ... do ... done
+    NODE_UNTIL,          // until ... do ... done
+    NODE_FOR,            // for NAME [in words] do ... done
+    NODE_GROUP,          // { list; }
+    NODE_SUBSHELL,       // ( list )
+    NODE_FUNCTION,       // NAME() { ... }
+    NODE_ARITH,          // (( expression ))
+    NODE_COND,           // [[ expression ]]
+    NODE_AND_OR,         // pipeline && pipeline || ...
+    NODE_COPROC,         // coproc [NAME] command
+    NODE_ARITH_FOR       // for (( init; cond; step )) do ... done
+};
+
+struct Node;
+using NodePtr = std::unique_ptr<Node>;
+using NodeList = std::vector<NodePtr>;
+
+struct Node {
+    NodeType type;
+
+    SimpleCommand command;               // NODE_COMMAND
+
+    NodeList stages;                     // NODE_PIPELINE
+    bool negate = false;                 // ! pipeline
+    bool background = false;             // pipeline &
+    uint32_t replicas = 0;               // Pipeline stage run as N copies: | [N] cmd |
+    bool unordered = false;              // [Nu]: copies' output merged as it comes
+
+    std::vector<std::pair<NodeList, NodeList>> clauses;   // NODE_IF (cond, body)
+    NodeList condition;                  // NODE_WHILE / NODE_UNTIL
+    NodeList body;                       // Loop/group/subshell/function body, else-branch of NODE_IF,
+                                         // NODE_AND_OR pipelines, NODE_COPROC command
+    std::string var;                     // NODE_FOR variable, NODE_FUNCTION name,
+                                         // NODE_ARITH expression, NODE_COPROC name
+    std::vector<std::string> items;      // NODE_FOR raw words, NODE_ARITH_FOR
+                                         // init/cond/step expressions, NODE_COND
+                                         // words, NODE_AND_OR operators,
+                                         // NODE_PIPELINE confine options
+    bool has_items = false;              // false: iterate over "$@"
+    std::vector<Redirect> redirects;     // Redirections on a compound command
+
+    explicit Node(NodeType t) : type(t) {}
+};
+
+// ============================================================================
+// Script Parser
+// ============================================================================
+
+struct ParseResult {
+    NodeList list;                       // Top-level pipelines in order
+    bool incomplete = false;             // Input ended inside a construct
+    std::string error;                   // Syntax error message (empty if ok)
+};
+
+// Parse a whole script or command line into a syntax tree
+ParseResult parse_script(const std::string& text);
+
+// True if more input lines are needed to finish the text
+bool script_incomplete(const std::string& text);
+
+#endif // SYNTAX_H
@@ -0,0 +1,31 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "shell.h"
+
+// ============================================================================
+// Bytecode Interpreter
+// ============================================================================
+
+// Run compiled code from pc until OP_RETURN (or until the shell exits).
+// Returns the final exit status, which is also left in $?.
+int run_program(const Program& prog, uint32_t pc = 0);
+
+// Expand a pipeline template into runnable commands
+Pipeline expand_pipeline(const Program& prog, const PipelineTemplate& tmpl);
+
+// ============================================================================
+// Shell Functions
+// ============================================================================
+
+// Number of function calls currently running
+extern int g_function_depth;
+
+// Set by `return`; stops the interpreter loop of the current function
+extern bool g_returning;
+
+// Run a function body in-process with $1.. taken from args[1..]
+int call_function(const Program& body, const std::vector<std::string>& args);
+
+#endif // VM_H
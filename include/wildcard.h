@@ -15,7 +15,15 @@ bool has_wildcards(const std::string& pattern);
 // Returns original pattern if no matches found
 std::vector<std::string> expand_glob(const std::string& pattern);
 
-// Match a string against a pattern with * and ?
+// Read a directory and return the entry names matching file_pattern (sorted).
+// Hidden entries are skipped unless the pattern starts with '.'
+std::vector<std::string> match_directory(const std::string& dir_path,
+                                         const std::string& file_pattern);
+
+// Match a string against a pattern with * and ? (\\ quotes a character)
 bool match_pattern(const std::string& pattern, const std::string& str);
 
+// The same over `size` characters at `str`, without copying them
+bool match_pattern(const std::string& pattern, const char* str, size_t size);
+
 #endif // WILDCARD_H
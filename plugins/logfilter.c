@@ -0,0 +1,133 @@
+// ============================================================================
+// Sample Plugin: logfilter
+// ============================================================================
+// Build with `make plugins`, then in myshell:
+//
+//     enable -f ./build/logfilter.so logfilter
+//     logfilter [-v] WORD < app.log
+//
+// Copies the lines of standard input that contain WORD (with -v, those that
+// do not) to standard output, each prefixed with $LOGFILTER_PREFIX if set,
+// and stores the number of lines copied in LOGFILTER_COUNT.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "myshell_plugin.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE 65536
+
+// Output buffer, written out when full and at the end
+typedef struct {
+    int fd;
+    size_t used;
+    int failed;
+    char data[BUFFER_SIZE];
+} Output;
+
+static void out_flush(Output* out) {
+    size_t done = 0;
+    while (done < out->used && !out->failed) {
+        ssize_t n = write(out->fd, out->data + done, out->used - done);
+        if (n > 0) {
+            done += (size_t)n;
+        } else if (n == -1 && errno != EINTR) {
+            out->failed = 1;
+        }
+    }
+    out->used = 0;
+}
+
+static void out_write(Output* out, const char* text, size_t size) {
+    while (size > 0) {
+        if (out->used == BUFFER_SIZE) {
+            out_flush(out);
+        }
+        size_t room = BUFFER_SIZE - out->used;
+        size_t n = size < room ? size : room;
+        memcpy(out->data + out->used, text, n);
+        out->used += n;
+        text += n;
+        size -= n;
+    }
+}
+
+static int logfilter(int argc, char** argv, int in_fd, int out_fd, const myshell_api* api) {
+    int invert = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (argc != 2 + invert) {
+        fprintf(stderr, "usage: logfilter [-v] WORD\n");
+        return 2;
+    }
+    const char* word = argv[1 + invert];
+
+    const char* prefix = api->get_var("LOGFILTER_PREFIX");
+    char* saved_prefix = strdup(prefix != NULL ? prefix : "");
+    size_t prefix_size = strlen(saved_prefix);
+
+    static Output out;
+    out.fd = out_fd;
+    out.used = 0;
+    out.failed = 0;
+
+    // A line is kept in `line` until its newline arrives
+    char chunk[BUFFER_SIZE];
+    char* line = NULL;
+    size_t line_size = 0;
+    size_t line_cap = 0;
+    long count = 0;
+    int done = 0;
+
+    while (!done) {
+        ssize_t n = read(in_fd, chunk, sizeof chunk);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        done = n <= 0;
+        size_t size = n > 0 ? (size_t)n : 0;
+
+        size_t start = 0;
+        while (start < size || (done && line_size > 0)) {
+            char* newline = size > start ? memchr(chunk + start, '\n', size - start) : NULL;
+            size_t end = newline != NULL ? (size_t)(newline - chunk) + 1 : size;
+
+            if (line_size + (end - start) + 1 > line_cap) {
+                line_cap = (line_size + (end - start) + 1) * 2;
+                line = realloc(line, line_cap);
+            }
+            memcpy(line + line_size, chunk + start, end - start);
+            line_size += end - start;
+            start = end;
+            if (newline == NULL && !done) {
+                break;                           // Rest of the line still to come
+            }
+
+            line[line_size] = '\0';
+            if ((strstr(line, word) != NULL) != invert) {
+                out_write(&out, saved_prefix, prefix_size);
+                out_write(&out, line, line_size);
+                count++;
+            }
+            line_size = 0;
+        }
+    }
+    out_flush(&out);
+    free(line);
+    free(saved_prefix);
+
+    char value[32];
+    snprintf(value, sizeof value, "%ld", count);
+    api->set_var("LOGFILTER_COUNT", value);
+    return out.failed ? 1 : 0;
+}
+
+static const myshell_builtin builtins[] = {
+    {"logfilter", logfilter},
+    {NULL, NULL}
+};
+
+const myshell_plugin myshell_plugin_info = {MYSHELL_PLUGIN_ABI, builtins};
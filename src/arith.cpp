@@ -0,0 +1,573 @@
+#include "arith.h"
+#include "env.h"
+
+#include <cctype>
+#include <climits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Compiled Expression
+// ============================================================================
+
+enum ArithNodeType : uint8_t {
+    ARITH_NUM,           // value
+    ARITH_VAR,           // name
+    ARITH_UNARY,         // op (+ - ! ~) applied to lhs
+    ARITH_PRE_INC,       // ++name
+    ARITH_PRE_DEC,       // --name
+    ARITH_POST_INC,      // name++
+    ARITH_POST_DEC,      // name--
+    ARITH_BINARY,        // lhs op rhs
+    ARITH_AND,           // lhs && rhs (short-circuit)
+    ARITH_OR,            // lhs || rhs (short-circuit)
+    ARITH_COND,          // lhs ? rhs : third
+    ARITH_ASSIGN,        // name = rhs, or name op= rhs
+    ARITH_COMMA          // lhs , rhs
+};
+
+enum BinaryOp : uint8_t {
+    BIN_NONE, BIN_POW, BIN_MUL, BIN_DIV, BIN_MOD, BIN_ADD, BIN_SUB,
+    BIN_SHL, BIN_SHR, BIN_LT, BIN_LE, BIN_GT, BIN_GE, BIN_EQ, BIN_NE,
+    BIN_AND, BIN_XOR, BIN_OR
+};
+
+struct ArithNode {
+    ArithNodeType type;
+    char unary = 0;
+    BinaryOp op = BIN_NONE;
+    int64_t value = 0;
+    std::string name;
+    int lhs = -1;
+    int rhs = -1;
+    int third = -1;
+
+    explicit ArithNode(ArithNodeType t) : type(t) {}
+};
+
+struct ArithExpr {
+    std::vector<ArithNode> nodes;
+    int root = -1;                       // -1: empty expression (value 0)
+};
+
+struct ArithError {
+    std::string message;
+};
+
+// ============================================================================
+// Lexer
+// ============================================================================
+
+enum ArithTokenType { TOK_NUM, TOK_NAME, TOK_OP, TOK_END };
+
+struct ArithToken {
+    ArithTokenType type;
+    std::string text;
+    int64_t value = 0;
+};
+
+// Longest operators first
+static const char* const OPERATORS[] = {
+    "**=", "<<=", ">>=",
+    "**", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "|", "^", "!", "~",
+    "?", ":", "=", ",", "(", ")"
+};
+
+static int digit_value(char c, int base) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (base <= 36) {
+        if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    } else {
+        if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 36;
+        if (c == '@') return 62;
+        if (c == '_') return 63;
+    }
+    return 64;
+}
+
+// Integer constant: decimal, 0x hex, 0 octal or BASE#digits (2..64)
+static bool parse_number(const std::string& text, int64_t& value) {
+    int base = 10;
+    size_t i = 0;
+
+    size_t hash = text.find('#');
+    if (hash != std::string::npos) {
+        if (hash == 0 || hash > 2 || hash + 1 >= text.size()) return false;
+        for (size_t k = 0; k < hash; k++) {
+            if (!std::isdigit(static_cast<unsigned char>(text[k]))) return false;
+        }
+        base = std::stoi(text.substr(0, hash));
+        if (base < 2 || base > 64) return false;
+        i = hash + 1;
+    } else if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        i = 2;
+    } else if (text.size() > 1 && text[0] == '0') {
+        base = 8;
+        i = 1;
+    }
+
+    uint64_t result = 0;
+    for (; i < text.size(); i++) {
+        int digit = digit_value(text[i], base);
+        if (digit >= base) return false;
+        result = result * static_cast<uint64_t>(base) + static_cast<uint64_t>(digit);
+    }
+    value = static_cast<int64_t>(result);
+    return true;
+}
+
+static std::vector<ArithToken> lex(const std::string& expr) {
+    std::vector<ArithToken> tokens;
+    size_t i = 0;
+
+    while (i < expr.size()) {
+        char c = expr[i];
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c))) {
+            size_t start = i;
+            while (i < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[i])) ||
+                                       expr[i] == '#' || expr[i] == '@' || expr[i] == '_')) {
+                i++;
+            }
+            ArithToken tok{TOK_NUM, expr.substr(start, i - start)};
+            if (!parse_number(tok.text, tok.value)) {
+                throw ArithError{"value too great for base (error token is \"" + tok.text + "\")"};
+            }
+            tokens.push_back(tok);
+        }
+        else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = i;
+            while (i < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[i])) ||
+                                       expr[i] == '_')) {
+                i++;
+            }
+            tokens.push_back({TOK_NAME, expr.substr(start, i - start)});
+        }
+        else {
+            const char* match = nullptr;
+            for (const char* op : OPERATORS) {
+                if (expr.compare(i, std::char_traits<char>::length(op), op) == 0) {
+                    match = op;
+                    break;
+                }
+            }
+            if (match == nullptr) {
+                throw ArithError{"syntax error: invalid arithmetic operator (error token is \"" +
+                                 expr.substr(i) + "\")"};
+            }
+            tokens.push_back({TOK_OP, match});
+            i += tokens.back().text.size();
+        }
+    }
+
+    tokens.push_back({TOK_END, ""});
+    return tokens;
+}
+
+// ============================================================================
+// Parser (precedence climbing)
+// ============================================================================
+
+struct BinaryInfo {
+    const char* text;
+    BinaryOp op;
+    int prec;
+};
+
+// || and && (precedence 1 and 2) are handled as short-circuit nodes
+static const BinaryInfo BINARY_OPS[] = {
+    {"|", BIN_OR, 3}, {"^", BIN_XOR, 4}, {"&", BIN_AND, 5},
+    {"==", BIN_EQ, 6}, {"!=", BIN_NE, 6},
+    {"<", BIN_LT, 7}, {"<=", BIN_LE, 7}, {">", BIN_GT, 7}, {">=", BIN_GE, 7},
+    {"<<", BIN_SHL, 8}, {">>", BIN_SHR, 8},
+    {"+", BIN_ADD, 9}, {"-", BIN_SUB, 9},
+    {"*", BIN_MUL, 10}, {"/", BIN_DIV, 10}, {"%", BIN_MOD, 10},
+    {"**", BIN_POW, 11}
+};
+
+static const BinaryInfo ASSIGN_OPS[] = {
+    {"=", BIN_NONE, 0}, {"*=", BIN_MUL, 0}, {"/=", BIN_DIV, 0}, {"%=", BIN_MOD, 0},
+    {"+=", BIN_ADD, 0}, {"-=", BIN_SUB, 0}, {"<<=", BIN_SHL, 0}, {">>=", BIN_SHR, 0},
+    {"&=", BIN_AND, 0}, {"^=", BIN_XOR, 0}, {"|=", BIN_OR, 0}, {"**=", BIN_POW, 0}
+};
+
+class ArithParser {
+public:
+    explicit ArithParser(const std::string& expr) : tokens_(lex(expr)) {}
+
+    ArithExpr parse() {
+        if (peek().type != TOK_END) {
+            expr_.root = parse_comma();
+            if (peek().type != TOK_END) {
+                error();
+            }
+        }
+        return std::move(expr_);
+    }
+
+private:
+    std::vector<ArithToken> tokens_;
+    size_t pos_ = 0;
+    ArithExpr expr_;
+
+    const ArithToken& peek(size_t ahead = 0) const {
+        return tokens_[std::min(pos_ + ahead, tokens_.size() - 1)];
+    }
+
+    bool at_op(const char* op) const {
+        return peek().type == TOK_OP && peek().text == op;
+    }
+
+    [[noreturn]] void error() const {
+        if (peek().type == TOK_END) {
+            throw ArithError{"syntax error: operand expected"};
+        }
+        std::string rest;
+        for (size_t i = pos_; i < tokens_.size(); i++) {
+            if (!rest.empty() && tokens_[i].type != TOK_END) rest += ' ';
+            rest += tokens_[i].text;
+        }
+        throw ArithError{"syntax error in expression (error token is \"" + rest + "\")"};
+    }
+
+    void expect(const char* op) {
+        if (!at_op(op)) error();
+        pos_++;
+    }
+
+    int add(ArithNode node) {
+        expr_.nodes.push_back(std::move(node));
+        return static_cast<int>(expr_.nodes.size() - 1);
+    }
+
+    int add_pair(ArithNodeType type, int lhs, int rhs) {
+        ArithNode node(type);
+        node.lhs = lhs;
+        node.rhs = rhs;
+        return add(node);
+    }
+
+    int parse_comma() {
+        int node = parse_assign();
+        while (at_op(",")) {
+            pos_++;
+            node = add_pair(ARITH_COMMA, node, parse_assign());
+        }
+        return node;
+    }
+
+    int parse_assign() {
+        if (peek().type == TOK_NAME && peek(1).type == TOK_OP) {
+            for (const auto& info : ASSIGN_OPS) {
+                if (peek(1).text == info.text) {
+                    ArithNode node(ARITH_ASSIGN);
+                    node.name = peek().text;
+                    node.op = info.op;
+                    pos_ += 2;
+                    node.rhs = parse_assign();
+                    return add(node);
+                }
+            }
+        }
+        return parse_conditional();
+    }
+
+    int parse_conditional() {
+        int cond = parse_logical(1);
+        if (!at_op("?")) {
+            return cond;
+        }
+        pos_++;
+        ArithNode node(ARITH_COND);
+        node.lhs = cond;
+        node.rhs = parse_comma();
+        expect(":");
+        node.third = parse_assign();
+        return add(node);
+    }
+
+    // 1: ||   2: &&   3 and up: bitwise, comparison and arithmetic
+    int parse_logical(int level) {
+        if (level > 2) {
+            return parse_binary(3);
+        }
+        const char* op = (level == 1) ? "||" : "&&";
+        int node = parse_logical(level + 1);
+        while (at_op(op)) {
+            pos_++;
+            node = add_pair(level == 1 ? ARITH_OR : ARITH_AND, node, parse_logical(level + 1));
+        }
+        return node;
+    }
+
+    const BinaryInfo* binary_op() const {
+        if (peek().type != TOK_OP) return nullptr;
+        for (const auto& info : BINARY_OPS) {
+            if (peek().text == info.text) return &info;
+        }
+        return nullptr;
+    }
+
+    int parse_binary(int min_prec) {
+        int lhs = parse_unary();
+        while (true) {
+            const BinaryInfo* info = binary_op();
+            if (info == nullptr || info->prec < min_prec) {
+                return lhs;
+            }
+            pos_++;
+            // ** is right-associative, everything else left-associative
+            int rhs = parse_binary(info->op == BIN_POW ? info->prec : info->prec + 1);
+            ArithNode node(ARITH_BINARY);
+            node.op = info->op;
+            node.lhs = lhs;
+            node.rhs = rhs;
+            lhs = add(node);
+        }
+    }
+
+    int parse_unary() {
+        if (at_op("+") || at_op("-") || at_op("!") || at_op("~")) {
+            ArithNode node(ARITH_UNARY);
+            node.unary = peek().text[0];
+            pos_++;
+            node.lhs = parse_unary();
+            return add(node);
+        }
+        if (at_op("++") || at_op("--")) {
+            ArithNode node(at_op("++") ? ARITH_PRE_INC : ARITH_PRE_DEC);
+            pos_++;
+            if (peek().type != TOK_NAME) error();
+            node.name = peek().text;
+            pos_++;
+            return add(node);
+        }
+        return parse_postfix();
+    }
+
+    int parse_postfix() {
+        if (peek().type == TOK_NAME && peek(1).type == TOK_OP &&
+            (peek(1).text == "++" || peek(1).text == "--")) {
+            ArithNode node(peek(1).text == "++" ? ARITH_POST_INC : ARITH_POST_DEC);
+            node.name = peek().text;
+            pos_ += 2;
+            return add(node);
+        }
+        return parse_primary();
+    }
+
+    int parse_primary() {
+        const ArithToken& tok = peek();
+        if (tok.type == TOK_NUM) {
+            ArithNode node(ARITH_NUM);
+            node.value = tok.value;
+            pos_++;
+            return add(node);
+        }
+        if (tok.type == TOK_NAME) {
+            ArithNode node(ARITH_VAR);
+            node.name = tok.text;
+            pos_++;
+            return add(node);
+        }
+        if (at_op("(")) {
+            pos_++;
+            int node = parse_comma();
+            expect(")");
+            return node;
+        }
+        error();
+    }
+};
+
+// ============================================================================
+// Evaluator
+// ============================================================================
+
+static std::shared_ptr<const ArithExpr> compile_expr(const std::string& expr);
+
+// Variables holding expressions are evaluated recursively, up to a limit
+static const int MAX_RECURSION = 64;
+
+class ArithEvaluator {
+public:
+    ArithEvaluator(const ArithExpr& expr, int depth) : expr_(expr), depth_(depth) {}
+
+    int64_t run() {
+        return expr_.root < 0 ? 0 : eval(expr_.root);
+    }
+
+private:
+    const ArithExpr& expr_;
+    int depth_;
+
+    int64_t variable(const std::string& name) const {
+        std::string text = get_env(name);
+        size_t start = text.find_first_not_of(" \t\n");
+        if (start == std::string::npos) {
+            return 0;
+        }
+        size_t end = text.find_last_not_of(" \t\n");
+        std::string trimmed = text.substr(start, end - start + 1);
+
+        int64_t value;
+        if (std::isdigit(static_cast<unsigned char>(trimmed[0])) && parse_number(trimmed, value)) {
+            return value;
+        }
+        if (depth_ >= MAX_RECURSION) {
+            throw ArithError{"expression recursion level exceeded (error token is \"" + name + "\")"};
+        }
+        return ArithEvaluator(*compile_expr(trimmed), depth_ + 1).run();
+    }
+
+    static void assign(const std::string& name, int64_t value) {
+        set_var(name, std::to_string(value));
+    }
+
+    static int64_t apply(BinaryOp op, int64_t l, int64_t r) {
+        // Wrap around on overflow, like the underlying machine arithmetic
+        uint64_t ul = static_cast<uint64_t>(l);
+        uint64_t ur = static_cast<uint64_t>(r);
+
+        switch (op) {
+            case BIN_ADD: return static_cast<int64_t>(ul + ur);
+            case BIN_SUB: return static_cast<int64_t>(ul - ur);
+            case BIN_MUL: return static_cast<int64_t>(ul * ur);
+            case BIN_DIV:
+            case BIN_MOD:
+                if (r == 0) {
+                    throw ArithError{"division by 0"};
+                }
+                if (l == INT64_MIN && r == -1) {
+                    return op == BIN_DIV ? INT64_MIN : 0;
+                }
+                return op == BIN_DIV ? l / r : l % r;
+            case BIN_POW: {
+                if (r < 0) {
+                    throw ArithError{"exponent less than 0"};
+                }
+                uint64_t result = 1;
+                while (ur > 0) {
+                    if (ur & 1) result *= ul;
+                    ul *= ul;
+                    ur >>= 1;
+                }
+                return static_cast<int64_t>(result);
+            }
+            case BIN_SHL: return static_cast<int64_t>(ul << (r & 63));
+            case BIN_SHR: return l >> (r & 63);
+            case BIN_LT:  return l < r;
+            case BIN_LE:  return l <= r;
+            case BIN_GT:  return l > r;
+            case BIN_GE:  return l >= r;
+            case BIN_EQ:  return l == r;
+            case BIN_NE:  return l != r;
+            case BIN_AND: return l & r;
+            case BIN_XOR: return l ^ r;
+            case BIN_OR:  return l | r;
+            case BIN_NONE: return r;
+        }
+        return 0;
+    }
+
+    int64_t eval(int index) {
+        const ArithNode& node = expr_.nodes[index];
+
+        switch (node.type) {
+            case ARITH_NUM:
+                return node.value;
+            case ARITH_VAR:
+                return variable(node.name);
+            case ARITH_UNARY: {
+                int64_t v = eval(node.lhs);
+                switch (node.unary) {
+                    case '-': return static_cast<int64_t>(0 - static_cast<uint64_t>(v));
+                    case '!': return !v;
+                    case '~': return ~v;
+                    default:  return v;
+                }
+            }
+            case ARITH_PRE_INC:
+            case ARITH_PRE_DEC: {
+                int64_t v = apply(node.type == ARITH_PRE_INC ? BIN_ADD : BIN_SUB,
+                                  variable(node.name), 1);
+                assign(node.name, v);
+                return v;
+            }
+            case ARITH_POST_INC:
+            case ARITH_POST_DEC: {
+                int64_t old = variable(node.name);
+                assign(node.name, apply(node.type == ARITH_POST_INC ? BIN_ADD : BIN_SUB, old, 1));
+                return old;
+            }
+            case ARITH_BINARY: {
+                int64_t l = eval(node.lhs);
+                return apply(node.op, l, eval(node.rhs));
+            }
+            case ARITH_AND:
+                return eval(node.lhs) != 0 && eval(node.rhs) != 0;
+            case ARITH_OR:
+                return eval(node.lhs) != 0 || eval(node.rhs) != 0;
+            case ARITH_COND:
+                return eval(node.lhs) != 0 ? eval(node.rhs) : eval(node.third);
+            case ARITH_ASSIGN: {
+                int64_t v = eval(node.rhs);
+                if (node.op != BIN_NONE) {
+                    v = apply(node.op, variable(node.name), v);
+                }
+                assign(node.name, v);
+                return v;
+            }
+            case ARITH_COMMA:
+                eval(node.lhs);
+                return eval(node.rhs);
+        }
+        return 0;
+    }
+};
+
+// ============================================================================
+// Expression Cache
+// ============================================================================
+
+static const size_t MAX_CACHED_EXPRESSIONS = 1024;
+
+static std::unordered_map<std::string, std::shared_ptr<const ArithExpr>> g_arith_cache;
+
+static std::shared_ptr<const ArithExpr> compile_expr(const std::string& expr) {
+    auto it = g_arith_cache.find(expr);
+    if (it != g_arith_cache.end()) {
+        return it->second;
+    }
+
+    auto compiled = std::make_shared<const ArithExpr>(ArithParser(expr).parse());
+    if (g_arith_cache.size() >= MAX_CACHED_EXPRESSIONS) {
+        g_arith_cache.clear();               // Texts built from $vars can vary
+    }
+    g_arith_cache.emplace(expr, compiled);
+    return compiled;
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+bool arith_eval(const std::string& expr, int64_t& result, std::string& error) {
+    try {
+        std::shared_ptr<const ArithExpr> compiled = compile_expr(expr);
+        result = ArithEvaluator(*compiled, 0).run();
+        return true;
+    } catch (const ArithError& e) {
+        error = expr + ": " + e.message;
+        return false;
+    }
+}
@@ -1,42 +1,116 @@
 #include "builtins.h"
+#include "context.h"
 #include "env.h"
 #include "shell.h"
+#include "history.h"
+#include "parser.h"
+#include "vm.h"
+#include "arith.h"
+#include "cond.h"
+#include "input.h"
+#include "plugin.h"
+#include "result_cache.h"
+#include "placement.h"
+#include "parallel.h"
 
 #include <iostream>
 #include <unistd.h>
+#include <fcntl.h>
 #include <cstdlib>
-#include <map>
+#include <algorithm>
+#include <unordered_map>
 #include <climits>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <cstdio>
 
 // ============================================================================
 // Built-in Registry
 // ============================================================================
 
-static std::map<std::string, BuiltinFunc> g_builtins;
+// The tables themselves belong to the current ShellContext (context.h)
 
 void init_builtins() {
-    g_builtins["cd"] = builtin_cd;
-    g_builtins["pwd"] = builtin_pwd;
-    g_builtins["echo"] = builtin_echo;
-    g_builtins["exit"] = builtin_exit;
-    g_builtins["help"] = builtin_help;
-    g_builtins["export"] = builtin_export;
-    g_builtins["unset"] = builtin_unset;
-    g_builtins["env"] = builtin_env;
+    auto& builtins = g_context->builtins;
+    builtins["cd"] = builtin_cd;
+    builtins["pwd"] = builtin_pwd;
+    builtins["echo"] = builtin_echo;
+    builtins["exit"] = builtin_exit;
+    builtins["help"] = builtin_help;
+    builtins["export"] = builtin_export;
+    builtins["unset"] = builtin_unset;
+    builtins["env"] = builtin_env;
+    builtins["history"] = builtin_history;
+    builtins["true"] = builtin_true;
+    builtins[":"] = builtin_true;
+    builtins["false"] = builtin_false;
+    builtins["break"] = builtin_break;
+    builtins["continue"] = builtin_break;
+    builtins["return"] = builtin_return;
+    builtins["alias"] = builtin_alias;
+    builtins["unalias"] = builtin_unalias;
+    builtins["let"] = builtin_let;
+    builtins["declare"] = builtin_declare;
+    builtins["test"] = builtin_test;
+    builtins["["] = builtin_test;
+    builtins["read"] = builtin_read;
+    builtins["enable"] = builtin_enable;
+    builtins["cached"] = builtin_cached;
+    builtins["ulimit"] = builtin_ulimit;
+    builtins["parallel"] = builtin_parallel;
 }
 
 bool is_builtin(const std::string& name) {
-    return g_builtins.find(name) != g_builtins.end();
+    return g_context->builtins.find(name) != g_context->builtins.end();
+}
+
+bool is_loaded_builtin(const std::string& name) {
+    return !g_context->loaded.empty() && g_context->loaded.find(name) != g_context->loaded.end();
 }
 
 BuiltinFunc get_builtin(const std::string& name) {
-    auto it = g_builtins.find(name);
-    if (it != g_builtins.end()) {
+    auto it = g_context->builtins.find(name);
+    if (it != g_context->builtins.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+void define_function(const std::string& name, std::shared_ptr<const Program> body) {
+    g_context->functions[name] = std::move(body);
+}
+
+std::shared_ptr<const Program> find_function(const std::string& name) {
+    auto it = g_context->functions.find(name);
+    if (it != g_context->functions.end()) {
         return it->second;
     }
     return nullptr;
 }
 
+bool unset_function(const std::string& name) {
+    return g_context->functions.erase(name) > 0;
+}
+
+bool find_alias(const std::string& name, std::string& value) {
+    auto it = g_context->aliases.find(name);
+    if (it == g_context->aliases.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+std::vector<std::string> builtin_names() {
+    std::vector<std::string> names;
+    for (const auto& pair : g_context->builtins) {
+        names.push_back(pair.first);
+    }
+    return names;
+}
+
 // ============================================================================
 // cd - Change Directory
 // ============================================================================
@@ -139,7 +213,7 @@ int builtin_echo(const std::vector<std::string>& args) {
 // ============================================================================
 
 int builtin_exit(const std::vector<std::string>& args) {
-    int exit_code = g_last_exit_status;
+    int exit_code = g_context->last_exit_status;
     
     if (args.size() > 1) {
         try {
@@ -150,8 +224,8 @@ int builtin_exit(const std::vector<std::string>& args) {
         }
     }
     
-    g_running = false;
-    g_last_exit_status = exit_code;
+    g_context->running = false;
+    g_context->last_exit_status = exit_code;
     return exit_code;
 }
 
@@ -168,21 +242,47 @@ int builtin_help(const std::vector<std::string>& args) {
     std::cout << "  pwd            Print working directory" << std::endl;
     std::cout << "  echo [args]    Print arguments (-n for no newline)" << std::endl;
     std::cout << "  export VAR=val Set environment variable" << std::endl;
-    std::cout << "  unset VAR      Remove environment variable" << std::endl;
+    std::cout << "  unset [-f] VAR Remove environment variable (or function)" << std::endl;
+    std::cout << "  alias [n=v]    Define or list aliases (unalias [-a] n)" << std::endl;
+    std::cout << "  return [n]     Return from a shell function" << std::endl;
+    std::cout << "  let expr...    Evaluate arithmetic expressions" << std::endl;
+    std::cout << "  declare -a|-A  Declare indexed or associative arrays" << std::endl;
+    std::cout << "  test expr, [ ] Evaluate a conditional expression ([[ ]] too)" << std::endl;
+    std::cout << "  read [-r] var  Read a line into variables (-a -d -n -t -u)" << std::endl;
+    std::cout << "  enable -f so n Load builtin n from a plugin (-d n unloads)" << std::endl;
+    std::cout << "  cached cmd     Replay cmd's output if its inputs are unchanged" << std::endl;
+    std::cout << "  ulimit [-SHa]  Show or set resource limits (-c -d -f -l -m -n -s -t -u -v)" << std::endl;
+    std::cout << "  parallel -j N  Run cmd per input, N at once (cmd {} ::: args, -k: in order)" << std::endl;
     std::cout << "  env            List environment variables" << std::endl;
+    std::cout << "  history [-c|n] Show (or clear) command history" << std::endl;
     std::cout << "  exit [code]    Exit shell with optional exit code" << std::endl;
     std::cout << "  help           Show this help message" << std::endl;
     std::cout << std::endl;
     std::cout << "Features:" << std::endl;
     std::cout << "  cmd1 | cmd2    Pipe output of cmd1 to cmd2" << std::endl;
+    std::cout << "  | [N] cmd |    Run N copies of cmd over chunks of lines ([Nu]: any order)" << std::endl;
     std::cout << "  cmd < file     Redirect input from file" << std::endl;
+    std::cout << "  cmd << WORD    Here-document: input up to a line WORD" << std::endl;
+    std::cout << "  cmd <<< text   Here-string: text as input" << std::endl;
+    std::cout << "  cmd <(cmd2)    Process substitution: cmd2's output as a file" << std::endl;
     std::cout << "  cmd > file     Redirect output to file" << std::endl;
     std::cout << "  cmd >> file    Append output to file" << std::endl;
+    std::cout << "  cmd > a > b    Send output to every target (> >(cmd2) too)" << std::endl;
     std::cout << "  cmd 2> file    Redirect errors to file" << std::endl;
+    std::cout << "  cmd >&N, <&N   Use descriptor N for output or input (2>&1)" << std::endl;
     std::cout << "  cmd &          Run command in background" << std::endl;
+    std::cout << "  confine [-C cpus] [-P] [-N n] [-I class] [-v ...] pipeline" << std::endl;
+    std::cout << "                 Run a pipeline on given CPUs, niced, under limits" << std::endl;
+    std::cout << "  coproc [N] cmd Start cmd with pipes in ${N[0]} (read), ${N[1]} (write)" << std::endl;
     std::cout << "  'text'         Single quotes (literal)" << std::endl;
     std::cout << "  \"text\"         Double quotes (allows $vars)" << std::endl;
     std::cout << "  *.txt          Wildcard expansion" << std::endl;
+    std::cout << "  cmd1; cmd2     Run commands in sequence" << std::endl;
+    std::cout << "  cmd1 && cmd2   Run cmd2 if cmd1 succeeds (|| if it fails)" << std::endl;
+    std::cout << "  { ...; } (...) Group commands (in the shell / in a subshell)" << std::endl;
+    std::cout << "  if/while/until/for ... Control flow (break, continue)" << std::endl;
+    std::cout << "  name() { ...; } Define a shell function" << std::endl;
+    std::cout << "  $((expr)), ((expr)) 64-bit integer arithmetic" << std::endl;
     std::cout << std::endl;
     
     return 0;
@@ -210,7 +310,8 @@ int builtin_export(const std::vector<std::string>& args) {
             std::string value = arg.substr(eq_pos + 1);
             set_env(name, value);
         } else {
-            // Just export existing variable (no-op for now)
+            // Export an existing shell variable
+            export_var(arg);
         }
     }
     
@@ -222,8 +323,25 @@ int builtin_export(const std::vector<std::string>& args) {
 // ============================================================================
 
 int builtin_unset(const std::vector<std::string>& args) {
-    for (size_t i = 1; i < args.size(); i++) {
-        unset_env(args[i]);
+    bool functions = false;
+    size_t i = 1;
+    
+    // -f removes functions, -v (the default) variables
+    for (; i < args.size() && (args[i] == "-f" || args[i] == "-v"); i++) {
+        functions = (args[i] == "-f");
+    }
+    
+    for (; i < args.size(); i++) {
+        std::string name, key;
+        if (functions) {
+            unset_function(args[i]);
+        } else if (args[i].find('[') == std::string::npos) {
+            unset_env(args[i]);
+        } else if (array_element_ref(args[i], name, key)) {
+            unset_array_element(name, key);
+        } else {
+            return 1;
+        }
     }
     return 0;
 }
@@ -241,3 +359,756 @@ int builtin_env(const std::vector<std::string>& args) {
     
     return 0;
 }
+
+// ============================================================================
+// history - Show or Clear Command History
+// ============================================================================
+
+int builtin_history(const std::vector<std::string>& args) {
+    size_t count = static_cast<size_t>(-1);
+    
+    if (args.size() > 1) {
+        if (args[1] == "-c") {
+            history_clear();
+            return 0;
+        }
+        try {
+            count = std::stoul(args[1]);
+        } catch (...) {
+            std::cerr << "history: " << args[1] << ": numeric argument required" << std::endl;
+            return 1;
+        }
+    }
+    
+    std::vector<std::string> entries = history_list(count);
+    size_t first = history_size() - entries.size() + 1;
+    for (size_t i = 0; i < entries.size(); i++) {
+        std::cout << "  " << first + i << "  " << entries[i] << "\n";
+    }
+    std::cout << std::flush;
+    
+    return 0;
+}
+
+// ============================================================================
+// true / false / : - Fixed Exit Status
+// ============================================================================
+
+int builtin_true(const std::vector<std::string>& args) {
+    (void)args;
+    return 0;
+}
+
+int builtin_false(const std::vector<std::string>& args) {
+    (void)args;
+    return 1;
+}
+
+// ============================================================================
+// break / continue - Outside a Loop
+// ============================================================================
+// Inside a loop these are compiled into jumps; reaching the builtin means
+// there is no enclosing loop (or the count was not a literal number).
+
+int builtin_break(const std::vector<std::string>& args) {
+    std::cerr << "myshell: " << args[0] << ": only meaningful in a `for', `while', or `until' loop" << std::endl;
+    return 0;
+}
+
+// ============================================================================
+// return - Leave the Current Function
+// ============================================================================
+
+int builtin_return(const std::vector<std::string>& args) {
+    if (g_function_depth == 0) {
+        std::cerr << "myshell: return: can only `return' from a function" << std::endl;
+        return 1;
+    }
+    
+    int status = g_context->last_exit_status;
+    if (args.size() > 1) {
+        try {
+            status = std::stoi(args[1]) & 0xff;
+        } catch (...) {
+            std::cerr << "myshell: return: " << args[1] << ": numeric argument required" << std::endl;
+            status = 2;
+        }
+    }
+    
+    // The interpreter loop stops at the next instruction
+    g_returning = true;
+    return status;
+}
+
+// ============================================================================
+// alias / unalias - Command Aliases
+// ============================================================================
+
+static void print_alias(const std::string& name, const std::string& value) {
+    std::string quoted;
+    for (char c : value) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    std::cout << "alias " << name << "='" << quoted << "'" << std::endl;
+}
+
+// An alias replaces the command's words only, so a value with ;, |, &&
+// or a redirection could not mean what it says; those need a function
+static bool alias_value_ok(const std::string& name, const std::string& value) {
+    bool incomplete = false;
+    for (const auto& token : tokenize(value, &incomplete)) {
+        if (token.type != TOKEN_WORD && token.type != TOKEN_END) {
+            std::cerr << "myshell: alias: " << name
+                      << ": value is not a simple command (use a function)" << std::endl;
+            return false;
+        }
+    }
+    if (incomplete) {
+        std::cerr << "myshell: alias: " << name << ": unterminated quote in value" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int builtin_alias(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        // No arguments - list all aliases, sorted
+        std::vector<std::string> names;
+        for (const auto& pair : g_context->aliases) {
+            names.push_back(pair.first);
+        }
+        std::sort(names.begin(), names.end());
+        for (const auto& name : names) {
+            print_alias(name, g_context->aliases[name]);
+        }
+        return 0;
+    }
+    
+    int status = 0;
+    for (size_t i = 1; i < args.size(); i++) {
+        size_t eq_pos = args[i].find('=');
+        
+        if (eq_pos != std::string::npos && eq_pos > 0) {
+            std::string name = args[i].substr(0, eq_pos);
+            std::string value = args[i].substr(eq_pos + 1);
+            if (alias_value_ok(name, value)) {
+                g_context->aliases[name] = value;
+            } else {
+                status = 1;
+            }
+        } else {
+            auto it = g_context->aliases.find(args[i]);
+            if (it == g_context->aliases.end()) {
+                std::cerr << "myshell: alias: " << args[i] << ": not found" << std::endl;
+                status = 1;
+            } else {
+                print_alias(it->first, it->second);
+            }
+        }
+    }
+    
+    return status;
+}
+
+int builtin_unalias(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "unalias: usage: unalias [-a] name [name ...]" << std::endl;
+        return 2;
+    }
+    
+    int status = 0;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "-a") {
+            g_context->aliases.clear();
+        } else if (g_context->aliases.erase(args[i]) == 0) {
+            std::cerr << "myshell: unalias: " << args[i] << ": not found" << std::endl;
+            status = 1;
+        }
+    }
+    
+    return status;
+}
+
+// ============================================================================
+// declare - Declare Variables and Arrays
+// ============================================================================
+
+int builtin_declare(const std::vector<std::string>& args) {
+    bool indexed = false;
+    bool associative = false;
+    size_t i = 1;
+    
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; i++) {
+        for (char c : args[i].substr(1)) {
+            if (c == 'a') {
+                indexed = true;
+            } else if (c == 'A') {
+                associative = true;
+            } else {
+                std::cerr << "myshell: declare: -" << c << ": invalid option" << std::endl;
+                std::cerr << "usage: declare [-aA] name[=value] ..." << std::endl;
+                return ERR_INVALID_ARGS;
+            }
+        }
+    }
+    
+    int status = 0;
+    for (; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, std::min(eq, arg.find_first_of("+[")));
+        
+        if ((indexed || associative) && !declare_array(name, associative)) {
+            std::cerr << "myshell: declare: " << name << ": cannot convert "
+                      << (associative ? "indexed to associative" : "associative to indexed")
+                      << " array" << std::endl;
+            status = 1;
+            continue;
+        }
+        if (eq == std::string::npos) {
+            continue;
+        }
+        
+        // NAME=( ... ) arrives unexpanded; other values already are
+        std::string array, key;
+        if (arg.compare(eq + 1, 1, "(") == 0 && arg.back() == ')') {
+            if (!assign_word(arg)) {
+                status = 1;
+            }
+        } else if (arg.find('[') < eq) {
+            if (!array_element_ref(arg.substr(0, eq), array, key) ||
+                !set_array_element(array, key, arg.substr(eq + 1))) {
+                status = 1;
+            }
+        } else if (name.size() + 1 < eq && arg[eq - 1] == '+') {
+            set_var(name, get_env(name) + arg.substr(eq + 1));
+        } else {
+            set_var(name, arg.substr(eq + 1));
+        }
+    }
+    return status;
+}
+
+// ============================================================================
+// let - Evaluate Arithmetic Expressions
+// ============================================================================
+
+int builtin_let(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "myshell: let: expression expected" << std::endl;
+        return 1;
+    }
+    
+    int64_t value = 0;
+    for (size_t i = 1; i < args.size(); i++) {
+        std::string error;
+        if (!arith_eval(args[i], value, error)) {
+            std::cerr << "myshell: let: " << error << std::endl;
+            return 1;
+        }
+    }
+    
+    // Like (( )): success when the last value is non-zero
+    return value != 0 ? 0 : 1;
+}
+
+// ============================================================================
+// test / [ - Evaluate a Conditional Expression
+// ============================================================================
+
+int builtin_test(const std::vector<std::string>& args) {
+    const std::string& name = args[0];
+    std::vector<std::string> words(args.begin() + 1, args.end());
+    if (name == "[") {
+        if (words.empty() || words.back() != "]") {
+            std::cerr << "myshell: [: missing `]'" << std::endl;
+            return 2;
+        }
+        words.pop_back();
+    }
+    
+    std::string error;
+    int status = test_eval(words, error);
+    if (!error.empty()) {
+        std::cerr << "myshell: " << name << ": " << error << std::endl;
+    }
+    return status;
+}
+
+// ============================================================================
+// read - Read a Line into Variables
+// ============================================================================
+
+static bool is_identifier(const std::string& name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Split at unescaped IFS characters into at most `max_fields` fields (the
+// last one keeps the rest of the text). IFS whitespace around a field is
+// dropped; each other IFS character ends exactly one field.
+static std::vector<std::string> split_read_fields(const std::string& text,
+                                                  const std::vector<bool>& escaped,
+                                                  const std::string& ifs,
+                                                  size_t max_fields) {
+    auto is_sep = [&](size_t i) {
+        return !escaped[i] && ifs.find(text[i]) != std::string::npos;
+    };
+    auto is_space = [&](size_t i) {
+        return is_sep(i) && (text[i] == ' ' || text[i] == '\t' || text[i] == '\n');
+    };
+    
+    std::vector<std::string> fields;
+    size_t n = text.size();
+    size_t i = 0;
+    while (i < n && is_space(i)) i++;
+    
+    while (i < n) {
+        if (fields.size() + 1 == max_fields) {
+            // A single field left over loses its terminating separator
+            size_t end = n;
+            while (end > i && is_space(end - 1)) end--;
+            size_t sep = i;
+            while (sep < end && !is_sep(sep)) sep++;
+            if (sep + 1 == end) {
+                end = sep;
+                while (end > i && is_space(end - 1)) end--;
+            }
+            fields.push_back(text.substr(i, end - i));
+            break;
+        }
+        size_t start = i;
+        while (i < n && !is_sep(i)) i++;
+        fields.push_back(text.substr(start, i - start));
+        
+        while (i < n && is_space(i)) i++;
+        if (i < n && is_sep(i)) {
+            i++;
+            while (i < n && is_space(i)) i++;
+        }
+    }
+    return fields;
+}
+
+int builtin_read(const std::vector<std::string>& args) {
+    bool raw = false;
+    char delim = '\n';
+    size_t limit = std::string::npos;
+    int timeout_ms = -1;
+    int fd = STDIN_FILENO;
+    std::string array;
+    size_t i = 1;
+    
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; i++) {
+        if (args[i] == "--") {
+            i++;
+            break;
+        }
+        for (size_t k = 1; k < args[i].size(); k++) {
+            char c = args[i][k];
+            if (c == 'r') {
+                raw = true;
+                continue;
+            }
+            if (std::strchr("adntu", c) == nullptr) {
+                std::cerr << "myshell: read: -" << c << ": invalid option" << std::endl;
+                std::cerr << "usage: read [-r] [-a array] [-d delim] [-n nchars] [-t timeout] [-u fd] [name ...]" << std::endl;
+                return ERR_INVALID_ARGS;
+            }
+            
+            // The option's value is the rest of this word or the next word
+            std::string value;
+            if (k + 1 < args[i].size()) {
+                value = args[i].substr(k + 1);
+            } else if (i + 1 < args.size()) {
+                value = args[++i];
+            } else {
+                std::cerr << "myshell: read: -" << c << ": option requires an argument" << std::endl;
+                return ERR_INVALID_ARGS;
+            }
+            
+            char* end = nullptr;
+            if (c == 'a') {
+                array = value;
+            } else if (c == 'd') {
+                delim = value.empty() ? '\0' : value[0];
+            } else if (c == 'n') {
+                long count = std::strtol(value.c_str(), &end, 10);
+                if (value.empty() || *end != '\0' || count < 0) {
+                    std::cerr << "myshell: read: " << value << ": invalid number" << std::endl;
+                    return ERR_INVALID_ARGS;
+                }
+                limit = static_cast<size_t>(count);
+            } else if (c == 'u') {
+                long number = std::strtol(value.c_str(), &end, 10);
+                if (value.empty() || *end != '\0' || number < 0 || number > INT_MAX ||
+                    fcntl(static_cast<int>(number), F_GETFD) == -1) {
+                    std::cerr << "myshell: read: " << value << ": invalid file descriptor" << std::endl;
+                    return 1;
+                }
+                fd = static_cast<int>(number);
+            } else {
+                double seconds = std::strtod(value.c_str(), &end);
+                if (value.empty() || *end != '\0' || seconds < 0) {
+                    std::cerr << "myshell: read: " << value << ": invalid timeout specification" << std::endl;
+                    return ERR_INVALID_ARGS;
+                }
+                timeout_ms = static_cast<int>(seconds * 1000);
+            }
+            break;
+        }
+    }
+    
+    std::vector<std::string> names(args.begin() + i, args.end());
+    for (const auto& name : names) {
+        if (!is_identifier(name)) {
+            std::cerr << "myshell: read: `" << name << "': not a valid identifier" << std::endl;
+            return 1;
+        }
+    }
+    if (!array.empty() && !is_identifier(array)) {
+        std::cerr << "myshell: read: `" << array << "': not a valid identifier" << std::endl;
+        return 1;
+    }
+    
+    // -t 0 only asks whether input is waiting
+    if (timeout_ms == 0) {
+        return input_ready(fd) ? 0 : 1;
+    }
+    
+    // Without -r a backslash quotes the next character, and a backslash
+    // before the delimiter continues the record
+    std::string text;
+    std::vector<bool> escaped;
+    InputStatus status;
+    while (true) {
+        std::string record;
+        status = input_read(fd, delim, limit, timeout_ms, record);
+        bool continued = false;
+        for (size_t k = 0; k < record.size(); k++) {
+            if (!raw && record[k] == '\\') {
+                if (k + 1 == record.size()) {
+                    continued = status == INPUT_OK && record.size() != limit;
+                    break;
+                }
+                k++;
+                text += record[k];
+                escaped.push_back(true);
+            } else {
+                text += record[k];
+                escaped.push_back(false);
+            }
+        }
+        if (!continued) {
+            break;
+        }
+        if (limit != std::string::npos) {
+            limit -= record.size();
+        }
+    }
+    
+    if (status == INPUT_ERROR) {
+        std::cerr << "myshell: read: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    
+    std::string ifs = get_env("IFS");
+    if (ifs.empty() && !env_is_set("IFS")) {
+        ifs = " \t\n";
+    }
+    
+    if (!array.empty()) {
+        unset_env(array);
+        declare_array(array, false);
+        std::vector<std::string> fields = split_read_fields(text, escaped, ifs, std::string::npos);
+        for (size_t k = 0; k < fields.size(); k++) {
+            set_array_element(array, std::to_string(k), fields[k]);
+        }
+    } else if (names.empty()) {
+        set_var("REPLY", text);
+    } else {
+        std::vector<std::string> fields = split_read_fields(text, escaped, ifs, names.size());
+        for (size_t k = 0; k < names.size(); k++) {
+            set_var(names[k], k < fields.size() ? fields[k] : "");
+        }
+    }
+    
+    if (status == INPUT_TIMEOUT) {
+        return 128 + SIGALRM;
+    }
+    return status == INPUT_EOF ? 1 : 0;
+}
+
+// ============================================================================
+// enable - Load Builtins from Plugins
+// ============================================================================
+// enable -f lib.so name... adds builtins from a shared object (see
+// myshell_plugin.h); enable -d name... removes them again, bringing back
+// any builtin of the same name they replaced. Without arguments the
+// builtins are listed.
+
+int builtin_enable(const std::vector<std::string>& args) {
+    if (args.size() == 1) {
+        std::vector<std::string> names = builtin_names();
+        std::sort(names.begin(), names.end());
+        for (const auto& name : names) {
+            std::cout << "enable " << name << "\n";
+        }
+        std::cout << std::flush;
+        return 0;
+    }
+    
+    int status = 0;
+    if (args[1] == "-f" && args.size() >= 4) {
+        for (size_t i = 3; i < args.size(); i++) {
+            BuiltinFunc func;
+            std::string error;
+            if (!load_plugin_builtin(args[2], args[i], func, error)) {
+                std::cerr << "myshell: enable: " << error << std::endl;
+                status = 1;
+                continue;
+            }
+            if (g_context->loaded.find(args[i]) == g_context->loaded.end()) {
+                auto it = g_context->builtins.find(args[i]);
+                g_context->loaded[args[i]] = it != g_context->builtins.end() ? it->second : nullptr;
+            }
+            g_context->builtins[args[i]] = func;
+        }
+    } else if (args[1] == "-d" && args.size() >= 3) {
+        for (size_t i = 2; i < args.size(); i++) {
+            auto it = g_context->loaded.find(args[i]);
+            if (it == g_context->loaded.end()) {
+                std::cerr << "myshell: enable: " << args[i] << ": not dynamically loaded" << std::endl;
+                status = 1;
+                continue;
+            }
+            if (it->second) {
+                g_context->builtins[args[i]] = it->second;
+            } else {
+                g_context->builtins.erase(args[i]);
+            }
+            g_context->loaded.erase(it);
+        }
+    } else {
+        std::cerr << "usage: enable [-f file name ...] [-d name ...]" << std::endl;
+        return ERR_INVALID_ARGS;
+    }
+    return status;
+}
+
+// ============================================================================
+// cached - Memoize a Command's Output
+// ============================================================================
+// cached [-n] [-e NAME]... [-f FILE]... COMMAND [ARGS...] runs COMMAND
+// through the result cache (see result_cache.h). -e adds a variable and -f
+// a file that COMMAND reads without naming it; -n runs it with no input.
+// --stats and --clear report on and empty the cache.
+
+int builtin_cached(const std::vector<std::string>& args) {
+    if (args.size() == 2 && args[1] == "--stats") {
+        return result_cache_stats();
+    }
+    if (args.size() == 2 && args[1] == "--clear") {
+        return result_cache_clear();
+    }
+    
+    std::vector<std::string> env_names;
+    std::vector<std::string> files;
+    bool no_stdin = false;
+    size_t i = 1;
+    while (i < args.size()) {
+        if (args[i] == "-n") {
+            no_stdin = true;
+            i++;
+        } else if (i + 1 < args.size() && (args[i] == "-e" || args[i] == "-f")) {
+            (args[i] == "-e" ? env_names : files).push_back(args[i + 1]);
+            i += 2;
+        } else {
+            break;
+        }
+    }
+    bool ended = i < args.size() && args[i] == "--";
+    if (ended) {
+        i++;
+    }
+    if (i >= args.size() || (!ended && args[i][0] == '-')) {
+        std::cerr << "usage: cached [-n] [-e name] [-f file] command [args...] | --stats | --clear" << std::endl;
+        return ERR_INVALID_ARGS;
+    }
+    
+    return cached_run(std::vector<std::string>(args.begin() + i, args.end()), env_names, files,
+                      no_stdin);
+}
+
+// ============================================================================
+// ulimit - Resource Limits of the Shell
+// ============================================================================
+// ulimit [-SH] [-a | -RESOURCE... [LIMIT]] shows or sets limits of the shell
+// itself, which every later command inherits (see placement.h for limits
+// on one pipeline). Without -S or -H a new limit is both soft and hard;
+// limits shown are soft ones unless -H is given. RESOURCE defaults to -f.
+
+static void print_limit(const ResourceLimit& limit, bool hard, bool labelled) {
+    struct rlimit value;
+    if (getrlimit(limit.resource, &value) == -1) {
+        shell_perror("ulimit");
+        return;
+    }
+    std::string text = format_limit(hard ? value.rlim_max : value.rlim_cur, limit);
+    if (labelled) {
+        char units[32];
+        char label[64];
+        snprintf(units, sizeof(units), "(%s, -%c)", limit.unit_name, limit.option);
+        snprintf(label, sizeof(label), "%-20s %-14s", limit.description, units);
+        std::cout << label << " " << text << std::endl;
+    } else {
+        std::cout << text << std::endl;
+    }
+}
+
+int builtin_ulimit(const std::vector<std::string>& args) {
+    bool soft = false;
+    bool hard = false;
+    bool all = false;
+    std::vector<const ResourceLimit*> chosen;
+    size_t i = 1;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; i++) {
+        for (size_t j = 1; j < args[i].size(); j++) {
+            char option = args[i][j];
+            const ResourceLimit* limit = find_resource_limit(option);
+            if (option == 'S') {
+                soft = true;
+            } else if (option == 'H') {
+                hard = true;
+            } else if (option == 'a') {
+                all = true;
+            } else if (limit != nullptr) {
+                chosen.push_back(limit);
+            } else {
+                std::cerr << "myshell: ulimit: -" << option << ": invalid option" << std::endl;
+                std::cerr << "usage: ulimit [-SHa] [-cdflmnstuv] [limit]" << std::endl;
+                return ERR_INVALID_ARGS;
+            }
+        }
+    }
+    if (chosen.empty()) {
+        chosen.push_back(find_resource_limit('f'));
+    }
+    
+    if (all) {
+        for (const auto& limit : resource_limits()) {
+            print_limit(limit, hard, true);
+        }
+        return 0;
+    }
+    if (i == args.size()) {
+        for (const ResourceLimit* limit : chosen) {
+            print_limit(*limit, hard, chosen.size() > 1);
+        }
+        return 0;
+    }
+    if (i + 1 != args.size() || chosen.size() != 1) {
+        std::cerr << "usage: ulimit [-SHa] [-cdflmnstuv] [limit]" << std::endl;
+        return ERR_INVALID_ARGS;
+    }
+    
+    const ResourceLimit& limit = *chosen[0];
+    rlim_t value;
+    if (!parse_limit(args[i], limit, value)) {
+        std::cerr << "myshell: ulimit: " << args[i] << ": invalid number" << std::endl;
+        return 1;
+    }
+    struct rlimit current;
+    if (getrlimit(limit.resource, &current) == -1) {
+        shell_perror("ulimit");
+        return 1;
+    }
+    if (!hard || soft) {
+        current.rlim_cur = value;
+    }
+    if (!soft || hard) {
+        current.rlim_max = value;
+    }
+    if (setrlimit(limit.resource, &current) == -1) {
+        shell_perror(std::string("ulimit: ") + limit.description);
+        return 1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// parallel - Run a Command over Many Inputs at Once
+// ============================================================================
+// parallel [-j N] [-k] [--] COMMAND [ARGS...] [::: INPUT...] runs COMMAND
+// per input, N at a time (see parallel.h). Without ::: the inputs are the
+// lines of standard input.
+
+int builtin_parallel(const std::vector<std::string>& args) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool keep_order = false;
+    size_t i = 1;
+    while (i < args.size() && args[i].size() > 1 && args[i][0] == '-' && args[i] != "--") {
+        std::string value;
+        if (args[i] == "-k") {
+            keep_order = true;
+            i++;
+            continue;
+        } else if (args[i] == "-j" && i + 1 < args.size()) {
+            value = args[i + 1];
+            i += 2;
+        } else if (args[i].compare(0, 2, "-j") == 0 && args[i].size() > 2) {
+            value = args[i].substr(2);
+            i++;
+        } else {
+            break;
+        }
+        char* end;
+        jobs = strtol(value.c_str(), &end, 10);
+        if (*end != '\0' || jobs < 1) {
+            std::cerr << "myshell: parallel: " << value << ": invalid job count" << std::endl;
+            return ERR_INVALID_ARGS;
+        }
+    }
+    if (i < args.size() && args[i] == "--") {
+        i++;
+    }
+    
+    auto separator = std::find(args.begin() + i, args.end(), ":::");
+    std::vector<std::string> command(args.begin() + i, separator);
+    if (command.empty()) {
+        std::cerr << "usage: parallel [-j jobs] [-k] command [args...] [::: inputs...]" << std::endl;
+        return ERR_INVALID_ARGS;
+    }
+    
+    std::vector<std::string> inputs;
+    if (separator != args.end()) {
+        inputs.assign(separator + 1, args.end());
+    } else {
+        // Every line of input is ours, so it may be read in large chunks
+        input_own(STDIN_FILENO);
+        while (true) {
+            std::string line;
+            InputStatus status = input_read(STDIN_FILENO, '\n', std::string::npos, -1, line);
+            if (status == INPUT_OK || (status == INPUT_EOF && !line.empty())) {
+                inputs.push_back(std::move(line));
+            }
+            if (status != INPUT_OK) {
+                break;
+            }
+        }
+        input_release(STDIN_FILENO);
+    }
+    
+    return parallel_run(command, inputs, static_cast<unsigned>(jobs > 0 ? jobs : 1), keep_order);
+}
@@ -0,0 +1,766 @@
+#include "bytecode.h"
+#include "builtins.h"
+
+#include <cctype>
+#include <cstring>
+
+// ============================================================================
+// Bytecode Compiler
+// ============================================================================
+
+class Compiler {
+public:
+    Program compile(const NodeList& list) {
+        compile_list(list);
+        emit(OP_RETURN);
+        return std::move(prog_);
+    }
+
+private:
+    // Open loops and redirection scopes, innermost last; break/continue
+    // unwind through them at compile time
+    struct Scope {
+        bool loop;
+        std::vector<size_t> breaks;       // Jumps patched to the loop exit
+        std::vector<size_t> continues;    // Jumps patched to the next iteration
+    };
+
+    Program prog_;
+    std::vector<Scope> scopes_;
+
+    size_t emit(OpCode op, uint32_t a = 0, uint32_t b = 0) {
+        prog_.code.push_back({op, a, b});
+        return prog_.code.size() - 1;
+    }
+
+    uint32_t here() const {
+        return static_cast<uint32_t>(prog_.code.size());
+    }
+
+    void patch(size_t at, uint32_t target) {
+        prog_.code[at].a = target;
+    }
+
+    void patch_all(const std::vector<size_t>& sites, uint32_t target) {
+        for (size_t site : sites) patch(site, target);
+    }
+
+    void compile_list(const NodeList& list) {
+        for (const auto& node : list) {
+            compile_pipeline(*node);
+        }
+    }
+
+    void compile_pipeline(const Node& node) {
+        const Node& first = *node.stages[0];
+        bool single = node.stages.size() == 1 && !node.background && first.replicas == 0 &&
+                      node.items.empty();
+
+        if (single && first.type != NODE_COMMAND) {
+            // Foreground compound command runs inline in the shell
+            compile_compound(first);
+        } else if (single && first.type == NODE_COMMAND && first.command.words.empty() &&
+                   first.command.redirects.empty()) {
+            emit(OP_ASSIGN, add_pipeline(node));
+        } else if (!(single && compile_loop_control(first.command))) {
+            emit(OP_RUN, add_pipeline(node));
+        }
+
+        if (node.negate) {
+            emit(OP_NOT);
+        }
+    }
+
+    uint32_t add_pipeline(const Node& node) {
+        PipelineTemplate pipeline;
+        pipeline.background = node.background;
+        pipeline.placement = node.items;
+        for (size_t i = 0; i < node.stages.size(); i++) {
+            const Node& stage = *node.stages[i];
+            Stage compiled;
+            if (stage.type == NODE_COMMAND) {
+                compiled.command = stage.command;
+            } else {
+                // Only a later stage has a pipe of its own as input
+                compiled.entry = compile_detached(stage, i > 0);
+            }
+            compiled.replicas = stage.replicas;
+            compiled.unordered = stage.unordered;
+            pipeline.stages.push_back(std::move(compiled));
+        }
+        prog_.pipelines.push_back(std::move(pipeline));
+        return static_cast<uint32_t>(prog_.pipelines.size() - 1);
+    }
+
+    // Compile a compound command as an out-of-line block for a child process
+    int32_t compile_detached(const Node& node, bool piped_input) {
+        size_t skip = emit(OP_JUMP);
+        int32_t entry = static_cast<int32_t>(here());
+
+        std::vector<Scope> outer;
+        outer.swap(scopes_);             // Loops outside the child are unreachable
+        compile_compound(node, piped_input, true);
+        emit(OP_RETURN);
+        scopes_.swap(outer);
+
+        patch(skip, here());
+        return entry;
+    }
+
+    // `private_input`: nothing but this command reads its standard input.
+    // `in_child`: the code runs in a child process of its own.
+    void compile_compound(const Node& node, bool private_input = false, bool in_child = false) {
+        if (node.type == NODE_SUBSHELL && !in_child) {
+            compile_subshell(node);
+            return;
+        }
+
+        size_t redirect = begin_redirects(node);
+        switch (node.type) {
+            case NODE_IF:
+                compile_if(node);
+                break;
+            case NODE_WHILE:
+            case NODE_UNTIL:
+                compile_while(node, private_input || redirects_input(node.redirects));
+                break;
+            case NODE_FOR:
+                compile_for(node);
+                break;
+            case NODE_GROUP:
+                compile_list(node.body);
+                break;
+            case NODE_SUBSHELL:
+                compile_tail_list(node.body);
+                break;
+            case NODE_FUNCTION:
+                compile_function(node);
+                break;
+            case NODE_ARITH:
+                emit_arith(node.var);
+                break;
+            case NODE_AND_OR:
+                compile_and_or(node);
+                break;
+            case NODE_COND:
+                prog_.word_lists.push_back(node.items);
+                emit(OP_COND, static_cast<uint32_t>(prog_.word_lists.size() - 1));
+                break;
+            case NODE_ARITH_FOR:
+                compile_arith_for(node);
+                break;
+            case NODE_COPROC:
+                compile_coproc(node);
+                break;
+            default:
+                break;
+        }
+        end_redirects(redirect);
+    }
+
+    // Redirections on a compound command are applied once around all of it.
+    // Returns the OP_REDIRECT to close, or SIZE_MAX if there are none.
+    size_t begin_redirects(const Node& node) {
+        if (node.redirects.empty()) {
+            return SIZE_MAX;
+        }
+        prog_.redirect_lists.push_back(node.redirects);
+        size_t redirect = emit(OP_REDIRECT, static_cast<uint32_t>(prog_.redirect_lists.size() - 1));
+        scopes_.push_back({false, {}, {}});
+        return redirect;
+    }
+
+    void end_redirects(size_t redirect) {
+        if (redirect != SIZE_MAX) {
+            scopes_.pop_back();
+            prog_.code[redirect].b = here();   // Failure skips to the restore
+            emit(OP_RESTORE);
+        }
+    }
+
+    // ( list ): a body that cannot change the shell's state runs in the
+    // shell itself, guarded by a check that none of its command names has
+    // become a function or alias; otherwise it runs in a child
+    void compile_subshell(const Node& node) {
+        std::vector<std::string> names;
+        size_t guard = 0;
+        size_t to_end = 0;
+        bool pure = is_pure(node.body, names);
+        if (pure) {
+            prog_.word_lists.push_back(names);
+            guard = emit(OP_JUMP_IF_SHADOWED, 0,
+                         static_cast<uint32_t>(prog_.word_lists.size() - 1));
+            size_t redirect = begin_redirects(node);
+            compile_list(node.body);
+            end_redirects(redirect);
+            to_end = emit(OP_JUMP);
+            patch(guard, here());
+        }
+
+        PipelineTemplate pipeline;
+        Stage stage;
+        stage.entry = compile_detached(node, false);
+        pipeline.stages.push_back(std::move(stage));
+        prog_.pipelines.push_back(std::move(pipeline));
+        emit(OP_RUN, static_cast<uint32_t>(prog_.pipelines.size() - 1));
+
+        if (pure) {
+            patch(to_end, here());
+        }
+    }
+
+    // The body of a subshell in its child: an external command run last
+    // replaces the child instead of being forked from it
+    void compile_tail_list(const NodeList& list) {
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i + 1 == list.size()) {
+                compile_tail(*list[i]);
+            } else {
+                compile_pipeline(*list[i]);
+            }
+        }
+    }
+
+    void compile_tail(const Node& pipeline) {
+        const Node& first = *pipeline.stages[0];
+        bool single = pipeline.stages.size() == 1 && !pipeline.background && !pipeline.negate &&
+                      first.replicas == 0 && pipeline.items.empty();
+        if (single && first.type == NODE_COMMAND && !first.command.words.empty()) {
+            emit(OP_RUN, add_pipeline(pipeline), 1);
+        } else if (single && first.type == NODE_AND_OR) {
+            compile_and_or(first, true);
+        } else {
+            compile_pipeline(pipeline);
+        }
+    }
+
+    // A function body is a separate program so it can outlive this one in
+    // the function registry; defining it is a single instruction
+    void compile_function(const Node& node) {
+        Compiler body;
+        prog_.functions.push_back(body.compile(node.body));
+        prog_.strings.push_back(node.var);
+        emit(OP_DEFINE, static_cast<uint32_t>(prog_.functions.size() - 1),
+             static_cast<uint32_t>(prog_.strings.size() - 1));
+    }
+
+    // coproc NAME command: a one-stage pipeline that the VM starts with pipes
+    // to the shell. The command's standard input is its own pipe.
+    void compile_coproc(const Node& node) {
+        const Node& command = *node.body[0]->stages[0];
+        PipelineTemplate pipeline;
+        Stage stage;
+        if (command.type == NODE_COMMAND) {
+            stage.command = command.command;
+        } else {
+            stage.entry = compile_detached(command, true);
+        }
+        pipeline.stages.push_back(std::move(stage));
+        prog_.pipelines.push_back(std::move(pipeline));
+        prog_.strings.push_back(node.var);
+        emit(OP_COPROC, static_cast<uint32_t>(prog_.pipelines.size() - 1),
+             static_cast<uint32_t>(prog_.strings.size() - 1));
+    }
+
+    void compile_if(const Node& node) {
+        std::vector<size_t> to_end;
+
+        for (const auto& clause : node.clauses) {
+            compile_list(clause.first);
+            size_t skip = emit(OP_JUMP_IF_FAIL);
+            compile_list(clause.second);
+            to_end.push_back(emit(OP_JUMP));
+            patch(skip, here());
+        }
+
+        if (!node.body.empty()) {
+            compile_list(node.body);
+        } else {
+            emit(OP_STATUS, 0);              // No branch taken
+        }
+        patch_all(to_end, here());
+    }
+
+    // Each && or || tests the status left by everything before it, so a
+    // failing `a` in `a && b || c` skips b and runs c. Pipelines are only
+    // expanded when reached.
+    void compile_and_or(const Node& node, bool tail = false) {
+        compile_pipeline(*node.body[0]);
+        for (size_t i = 0; i < node.items.size(); i++) {
+            size_t skip = emit(node.items[i] == "&&" ? OP_JUMP_IF_FAIL : OP_JUMP_IF_OK);
+            if (tail && i + 1 == node.items.size()) {
+                compile_tail(*node.body[i + 1]);
+            } else {
+                compile_pipeline(*node.body[i + 1]);
+            }
+            patch(skip, here());
+        }
+    }
+
+    void compile_while(const Node& node, bool private_input) {
+        // A loop that is the only reader of its input lets `read` buffer it
+        std::vector<std::string> names;
+        if (private_input && only_read_consumes(node.condition, names) &&
+            only_read_consumes(node.body, names)) {
+            prog_.word_lists.push_back(names);
+            emit(OP_LOOP_ENTER, 1, static_cast<uint32_t>(prog_.word_lists.size() - 1));
+        } else {
+            emit(OP_LOOP_ENTER);
+        }
+        uint32_t top = here();
+        scopes_.push_back({true, {}, {}});
+
+        compile_list(node.condition);
+        size_t exit_jump = emit(node.type == NODE_WHILE ? OP_JUMP_IF_FAIL : OP_JUMP_IF_OK);
+        compile_list(node.body);
+        emit(OP_LOOP_SAVE);
+        emit(OP_JUMP, top);
+
+        uint32_t exit = here();
+        emit(OP_LOOP_EXIT);
+        patch(exit_jump, exit);
+        patch_all(scopes_.back().breaks, exit);
+        patch_all(scopes_.back().continues, top);
+        scopes_.pop_back();
+    }
+
+    void compile_for(const Node& node) {
+        if (node.has_items) {
+            prog_.word_lists.push_back(node.items);
+            emit(OP_EXPAND, static_cast<uint32_t>(prog_.word_lists.size() - 1));
+        } else {
+            emit(OP_EXPAND_ARGS);
+        }
+        prog_.strings.push_back(node.var);
+        uint32_t var = static_cast<uint32_t>(prog_.strings.size() - 1);
+
+        uint32_t next = here();
+        size_t next_op = emit(OP_NEXT, 0, var);
+        scopes_.push_back({true, {}, {}});
+
+        compile_list(node.body);
+        emit(OP_LOOP_SAVE);
+        emit(OP_JUMP, next);
+
+        uint32_t exit = here();
+        emit(OP_LOOP_EXIT);
+        patch(next_op, exit);
+        patch_all(scopes_.back().breaks, exit);
+        patch_all(scopes_.back().continues, next);
+        scopes_.pop_back();
+    }
+
+    void emit_arith(const std::string& expr) {
+        prog_.strings.push_back(expr);
+        emit(OP_ARITH, static_cast<uint32_t>(prog_.strings.size() - 1));
+    }
+
+    static bool is_blank(const std::string& expr) {
+        return expr.find_first_not_of(" \t\n") == std::string::npos;
+    }
+
+    void compile_arith_for(const Node& node) {
+        const std::string& init = node.items[0];
+        const std::string& cond = node.items[1];
+        const std::string& step = node.items[2];
+
+        if (!is_blank(init)) {
+            emit_arith(init);
+        }
+        emit(OP_LOOP_ENTER);
+        uint32_t top = here();
+        scopes_.push_back({true, {}, {}});
+
+        size_t exit_jump = 0;
+        bool has_cond = !is_blank(cond);       // An empty condition is true
+        if (has_cond) {
+            emit_arith(cond);
+            exit_jump = emit(OP_JUMP_IF_FAIL);
+        }
+        compile_list(node.body);
+        emit(OP_LOOP_SAVE);
+
+        uint32_t next = here();
+        if (!is_blank(step)) {
+            emit_arith(step);
+        }
+        emit(OP_JUMP, top);
+
+        uint32_t exit = here();
+        emit(OP_LOOP_EXIT);
+        if (has_cond) {
+            patch(exit_jump, exit);
+        }
+        patch_all(scopes_.back().breaks, exit);
+        patch_all(scopes_.back().continues, next);
+        scopes_.pop_back();
+    }
+
+    // ------------------------------------------------------------------------
+    // Input ownership: a loop may own standard input when every command in
+    // it runs in the shell, never starts a process and reads input only
+    // through `read`
+    // ------------------------------------------------------------------------
+
+    static bool redirects_input(const std::vector<Redirect>& redirects) {
+        for (const auto& redir : redirects) {
+            if (redir.type == REDIR_IN || redir.type == REDIR_HEREDOC ||
+                redir.type == REDIR_HEREDOC_LITERAL || redir.type == REDIR_HERESTRING ||
+                redir.type == REDIR_DUP_IN) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // $(...), `...`, <(...) or >(...) would start a process; $(( )) does not
+    static bool starts_process(const std::string& raw) {
+        for (size_t i = 0; i + 1 < raw.size(); i++) {
+            if (raw[i] == '`' ||
+                (std::strchr("$<>", raw[i]) != nullptr && raw[i + 1] == '(' &&
+                 !(raw[i] == '$' && i + 2 < raw.size() && raw[i + 2] == '('))) {
+                return true;
+            }
+        }
+        return !raw.empty() && raw.back() == '`';
+    }
+
+    static bool any_starts_process(const std::vector<std::string>& words) {
+        for (const auto& word : words) {
+            if (starts_process(word)) return true;
+        }
+        return false;
+    }
+
+    // Builtins that neither read standard input nor run other commands
+    static bool is_inert_builtin(const std::string& name) {
+        static const char* const NAMES[] = {
+            "read", "echo", "true", "false", ":", "test", "[", "let", "declare",
+            "export", "unset", "break", "continue", "return", "exit", "cd", "pwd",
+            "alias", "unalias", "env", "history", "help"
+        };
+        for (const char* known : NAMES) {
+            if (name == known) return true;
+        }
+        return false;
+    }
+
+    // Collects the command names used, since a function of the same name
+    // defined by the time the loop runs would take over
+    static bool only_read_consumes(const NodeList& list, std::vector<std::string>& names) {
+        for (const auto& pipeline : list) {
+            if (pipeline->background || pipeline->stages.size() != 1 ||
+                !only_read_consumes(*pipeline->stages[0], names)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool only_read_consumes(const Node& node, std::vector<std::string>& names) {
+        if (redirects_input(node.redirects)) {
+            return false;
+        }
+        for (const auto& redir : node.redirects) {
+            if (starts_process(redir.target)) return false;
+        }
+
+        switch (node.type) {
+            case NODE_COMMAND: {
+                const SimpleCommand& cmd = node.command;
+                if (redirects_input(cmd.redirects) || any_starts_process(cmd.assigns) ||
+                    any_starts_process(cmd.words)) {
+                    return false;
+                }
+                for (const auto& redir : cmd.redirects) {
+                    if (starts_process(redir.target)) return false;
+                }
+                if (cmd.words.empty()) {
+                    return true;
+                }
+                if (!is_inert_builtin(cmd.words[0])) {
+                    return false;
+                }
+                names.push_back(cmd.words[0]);
+                return true;
+            }
+            case NODE_IF:
+                for (const auto& clause : node.clauses) {
+                    if (!only_read_consumes(clause.first, names) ||
+                        !only_read_consumes(clause.second, names)) {
+                        return false;
+                    }
+                }
+                return only_read_consumes(node.body, names);
+            case NODE_WHILE:
+            case NODE_UNTIL:
+                return only_read_consumes(node.condition, names) &&
+                       only_read_consumes(node.body, names);
+            case NODE_FOR:
+            case NODE_ARITH_FOR:
+            case NODE_COND:
+                return !any_starts_process(node.items) && only_read_consumes(node.body, names);
+            case NODE_GROUP:
+            case NODE_AND_OR:
+                return only_read_consumes(node.body, names);
+            case NODE_ARITH:
+                return !starts_process(node.var);
+            default:
+                return false;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Subshell purity: a body whose commands are external programs or
+    // builtins that only report, with no assignments (including ${v:=w}),
+    // loops over variables or function definitions, leaves the shell as it
+    // found it. Arithmetic that names a variable counts as an assignment:
+    // besides x <<= 2 or ${a[i++]}, a variable's value is itself evaluated,
+    // so e="y=5"; $((e)) assigns y.
+    // ------------------------------------------------------------------------
+
+    static bool is_report_builtin(const std::string& name) {
+        static const char* const NAMES[] = {
+            "echo", "true", "false", ":", "test", "[", "pwd", "env", "help"
+        };
+        for (const char* known : NAMES) {
+            if (name == known) return true;
+        }
+        return false;
+    }
+
+    // Index of the '}' closing the "${" at `start`, skipping nested braces
+    // and single-quoted text; npos if it is not closed
+    static size_t closing_brace(const std::string& raw, size_t start) {
+        int depth = 0;
+        for (size_t i = start + 1; i < raw.size(); i++) {
+            if (raw[i] == '\\') {
+                i++;
+            } else if (raw[i] == '\'') {
+                size_t end = raw.find('\'', i + 1);
+                if (end == std::string::npos) return end;
+                i = end;
+            } else if (raw[i] == '{') {
+                depth++;
+            } else if (raw[i] == '}' && --depth == 0) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    // Index of the "))" closing the "$((" at `start`; npos if not closed
+    static size_t closing_arith(const std::string& raw, size_t start) {
+        int depth = 0;
+        for (size_t i = start + 3; i < raw.size(); i++) {
+            if (raw[i] == '(') {
+                depth++;
+            } else if (raw[i] == ')' && depth-- == 0) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    // ${v=w} / ${v:=w}, ${!ref} (which may name a[i++]), or arithmetic
+    // naming a variable: $(( )), a subscript as in ${a[i]} or an offset or
+    // length as in ${v:i:n}
+    static bool assigns_in_expansion(const std::string& raw) {
+        for (size_t i = 0; i + 1 < raw.size(); i++) {
+            if (raw[i] == '$' && raw[i + 1] == '{') {
+                size_t close = closing_brace(raw, i);
+                std::string body = raw.substr(i + 2, close == std::string::npos
+                                                         ? close : close - i - 2);
+                if (body.find('=') != std::string::npos || body[0] == '!' ||
+                    expansion_arith_names(body)) {
+                    return true;
+                }
+            } else if (raw.compare(i, 3, "$((") == 0) {
+                size_t close = closing_arith(raw, i);
+                if (arith_names_variable(raw.substr(i + 3, close == std::string::npos
+                                                               ? close : close - i - 3))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // The subscript, offset or length of a ${...} body names a variable
+    static bool expansion_arith_names(const std::string& body) {
+        size_t pos = body[0] == '#' ? 1 : 0;
+        while (pos < body.size() &&
+               (std::isalnum(static_cast<unsigned char>(body[pos])) || body[pos] == '_')) {
+            pos++;
+        }
+        if (pos < body.size() && body[pos] == '[') {
+            int depth = 0;
+            size_t end = pos;
+            for (; end < body.size(); end++) {
+                if (body[end] == '[') depth++;
+                if (body[end] == ']' && --depth == 0) break;
+            }
+            std::string subscript = body.substr(pos + 1, end - pos - 1);
+            if (subscript != "@" && subscript != "*" && arith_names_variable(subscript)) {
+                return true;
+            }
+            pos = end + 1;
+        }
+        return pos + 1 < body.size() && body[pos] == ':' &&
+               std::strchr("-=?+", body[pos + 1]) == nullptr &&
+               arith_names_variable(body.substr(pos + 1));
+    }
+
+    // An identifier (not the digits of 0x1f or 16#ff), $ or ` in an
+    // arithmetic expression
+    static bool arith_names_variable(const std::string& expr) {
+        for (size_t i = 0; i < expr.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(expr[i]);
+            if (c == '$' || c == '`') {
+                return true;
+            }
+            if ((std::isalpha(c) || c == '_') &&
+                (i == 0 || !(std::isalnum(static_cast<unsigned char>(expr[i - 1])) ||
+                             expr[i - 1] == '_' || expr[i - 1] == '#'))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool any_assigns(const std::vector<std::string>& words) {
+        for (const auto& word : words) {
+            if (assigns_in_expansion(word)) return true;
+        }
+        return false;
+    }
+
+    static bool is_pure(const NodeList& list, std::vector<std::string>& names) {
+        for (const auto& pipeline : list) {
+            if (pipeline->background) {
+                return false;
+            }
+            for (const auto& stage : pipeline->stages) {
+                if (!is_pure(*stage, names)) return false;
+            }
+        }
+        return true;
+    }
+
+    static bool is_pure(const Node& node, std::vector<std::string>& names) {
+        for (const auto& redir : node.redirects) {
+            if (assigns_in_expansion(redir.target)) return false;
+        }
+
+        switch (node.type) {
+            case NODE_COMMAND: {
+                const SimpleCommand& cmd = node.command;
+                if (cmd.words.empty() || any_assigns(cmd.assigns) || any_assigns(cmd.words)) {
+                    return false;
+                }
+                for (const auto& redir : cmd.redirects) {
+                    if (assigns_in_expansion(redir.target)) return false;
+                }
+                // The command must be known now: a literal external or report builtin
+                const std::string& name = cmd.words[0];
+                if (name.find_first_of("$`'\"\\*?[~") != std::string::npos ||
+                    (is_builtin(name) && !is_report_builtin(name))) {
+                    return false;
+                }
+                names.push_back(name);
+                return true;
+            }
+            case NODE_IF:
+                for (const auto& clause : node.clauses) {
+                    if (!is_pure(clause.first, names) || !is_pure(clause.second, names)) {
+                        return false;
+                    }
+                }
+                return is_pure(node.body, names);
+            case NODE_WHILE:
+            case NODE_UNTIL:
+                return is_pure(node.condition, names) && is_pure(node.body, names);
+            case NODE_GROUP:
+            case NODE_AND_OR:
+                return is_pure(node.body, names);
+            case NODE_SUBSHELL:
+                return true;                     // Isolates itself
+            case NODE_ARITH:
+                return !arith_names_variable(node.var);
+            case NODE_COND:
+                for (size_t k = 0; k < node.items.size(); k++) {
+                    const std::string& word = node.items[k];
+                    if (word == "=~") return false;  // Sets BASH_REMATCH
+                    // The operands of -eq and the like are arithmetic
+                    if (word.size() == 3 && word[0] == '-' && k > 0 && k + 1 < node.items.size() &&
+                        std::strstr("-eq -ne -lt -le -gt -ge", word.c_str()) != nullptr &&
+                        (arith_names_variable(node.items[k - 1]) ||
+                         arith_names_variable(node.items[k + 1]))) {
+                        return false;
+                    }
+                }
+                return !any_assigns(node.items);
+            default:
+                return false;
+        }
+    }
+
+    // Turn a literal `break [n]` / `continue [n]` into jumps. Returns false
+    // when the command is something else (or not inside a loop).
+    bool compile_loop_control(const SimpleCommand& cmd) {
+        if (cmd.words.empty() || !cmd.assigns.empty() || !cmd.redirects.empty()) {
+            return false;
+        }
+        bool is_break = cmd.words[0] == "break";
+        if (!is_break && cmd.words[0] != "continue") {
+            return false;
+        }
+
+        size_t levels = 1;
+        if (cmd.words.size() > 2) {
+            return false;
+        }
+        if (cmd.words.size() == 2) {
+            const std::string& n = cmd.words[1];
+            if (n.empty() || n.find_first_not_of("0123456789") != std::string::npos) {
+                return false;
+            }
+            levels = std::stoul(n);
+            if (levels == 0) {
+                return false;
+            }
+        }
+
+        // Find the target loop (the outermost one if n is too large)
+        long target = -1;
+        size_t seen = 0;
+        for (long i = static_cast<long>(scopes_.size()) - 1; i >= 0; i--) {
+            if (scopes_[i].loop) {
+                target = i;
+                if (++seen == levels) break;
+            }
+        }
+        if (target < 0) {
+            return false;
+        }
+
+        // Unwind inner scopes on the way out
+        for (long i = static_cast<long>(scopes_.size()) - 1; i > target; i--) {
+            emit(scopes_[i].loop ? OP_POP : OP_RESTORE);
+        }
+
+        emit(OP_STATUS, 0);
+        if (is_break) {
+            emit(OP_LOOP_SAVE);
+            scopes_[target].breaks.push_back(emit(OP_JUMP));
+        } else {
+            scopes_[target].continues.push_back(emit(OP_JUMP));
+        }
+        return true;
+    }
+};
+
+Program compile_script(const NodeList& list) {
+    Compiler compiler;
+    return compiler.compile(list);
+}
@@ -0,0 +1,332 @@
+#include "completion.h"
+#include "builtins.h"
+#include "env.h"
+#include "wildcard.h"
+
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+
+// ============================================================================
+// Command Name Trie
+// ============================================================================
+// Names are reference counted so the same executable in several $PATH
+// directories survives until its last directory drops it.
+
+class CommandTrie {
+public:
+    CommandTrie() : nodes_(1) {}
+
+    void add(const std::string& name) {
+        uint32_t node = 0;
+        for (char c : name) {
+            node = child(node, c, true);
+        }
+        nodes_[node].count++;
+    }
+
+    void remove(const std::string& name) {
+        uint32_t node = 0;
+        for (char c : name) {
+            node = child(node, c, false);
+            if (node == 0) return;
+        }
+        if (nodes_[node].count > 0) nodes_[node].count--;
+    }
+
+    // All names starting with prefix, in sorted order
+    void collect(const std::string& prefix, std::vector<std::string>& out) const {
+        uint32_t node = 0;
+        for (char c : prefix) {
+            node = find(node, c);
+            if (node == 0) return;
+        }
+        std::string name = prefix;
+        walk(node, name, out);
+    }
+
+private:
+    struct Node {
+        std::vector<std::pair<char, uint32_t>> children;   // Sorted by char
+        uint32_t count = 0;
+    };
+    std::vector<Node> nodes_;
+
+    uint32_t find(uint32_t node, char c) const {
+        const auto& kids = nodes_[node].children;
+        auto it = std::lower_bound(kids.begin(), kids.end(), std::make_pair(c, 0u));
+        return (it != kids.end() && it->first == c) ? it->second : 0;
+    }
+
+    uint32_t child(uint32_t node, char c, bool create) {
+        uint32_t found = find(node, c);
+        if (found != 0 || !create) {
+            return found;
+        }
+        uint32_t id = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+        auto& kids = nodes_[node].children;
+        kids.insert(std::lower_bound(kids.begin(), kids.end(), std::make_pair(c, 0u)),
+                    std::make_pair(c, id));
+        return id;
+    }
+
+    void walk(uint32_t node, std::string& name, std::vector<std::string>& out) const {
+        if (nodes_[node].count > 0) {
+            out.push_back(name);
+        }
+        for (const auto& kid : nodes_[node].children) {
+            name.push_back(kid.first);
+            walk(kid.second, name, out);
+            name.pop_back();
+        }
+    }
+};
+
+// ============================================================================
+// Background Indexer
+// ============================================================================
+// The worker owns the working trie and per-directory state; readers only
+// ever see immutable snapshots, so a Tab press never waits for a scan.
+
+class CompletionEngine {
+public:
+    ~CompletionEngine() {
+        shutdown();
+    }
+
+    // Start a refresh unless one is running or one ran very recently
+    void refresh(bool force) {
+        if (busy_) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!force && now - last_refresh_ < std::chrono::seconds(1)) {
+            return;
+        }
+        last_refresh_ = now;
+
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+
+        // Environment and registry are read here, on the shell's thread
+        std::vector<std::string> path_dirs;
+        std::string path = get_env("PATH");
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t colon = path.find(':', start);
+            if (colon == std::string::npos) colon = path.size();
+            std::string dir = path.substr(start, colon - start);
+            path_dirs.push_back(dir.empty() ? "." : dir);
+            start = colon + 1;
+        }
+
+        busy_ = true;
+        worker_ = std::thread(&CompletionEngine::rebuild, this,
+                              std::move(path_dirs), builtin_names());
+    }
+
+    void shutdown() {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    std::shared_ptr<const CommandTrie> snapshot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return trie_;
+    }
+
+private:
+    struct DirState {
+        struct timespec mtime;
+        std::vector<std::string> names;
+    };
+
+    std::mutex mutex_;
+    std::shared_ptr<const CommandTrie> trie_;
+    std::thread worker_;
+    std::atomic<bool> busy_{false};
+    std::chrono::steady_clock::time_point last_refresh_;
+
+    // Worker-owned state
+    CommandTrie working_;
+    std::map<std::string, DirState> dirs_;
+    std::vector<std::string> builtins_;
+
+    static bool same_time(const struct timespec& a, const struct timespec& b) {
+        return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+    }
+
+    static std::vector<std::string> scan_executables(const std::string& dir) {
+        std::vector<std::string> names;
+        for (const auto& name : match_directory(dir, "*")) {
+            struct stat st;
+            std::string full = dir + "/" + name;
+            if (stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+                (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
+                names.push_back(name);
+            }
+        }
+        return names;
+    }
+
+    void rebuild(std::vector<std::string> path_dirs, std::vector<std::string> builtins) {
+        bool changed = false;
+
+        if (builtins != builtins_) {
+            for (const auto& name : builtins_) working_.remove(name);
+            for (const auto& name : builtins) working_.add(name);
+            builtins_ = std::move(builtins);
+            changed = true;
+        }
+
+        // Forget directories that left $PATH
+        for (auto it = dirs_.begin(); it != dirs_.end();) {
+            if (std::find(path_dirs.begin(), path_dirs.end(), it->first) == path_dirs.end()) {
+                for (const auto& name : it->second.names) working_.remove(name);
+                it = dirs_.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+
+        // Rescan only directories whose mtime moved
+        for (const auto& dir : path_dirs) {
+            struct stat st;
+            if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+                continue;
+            }
+            auto it = dirs_.find(dir);
+            if (it != dirs_.end() && same_time(it->second.mtime, st.st_mtim)) {
+                continue;
+            }
+            if (it != dirs_.end()) {
+                for (const auto& name : it->second.names) working_.remove(name);
+            }
+            DirState& state = dirs_[dir];
+            state.mtime = st.st_mtim;
+            state.names = scan_executables(dir);
+            for (const auto& name : state.names) working_.add(name);
+            changed = true;
+        }
+
+        if (changed) {
+            auto published = std::make_shared<const CommandTrie>(working_);
+            std::lock_guard<std::mutex> lock(mutex_);
+            trie_ = published;
+        }
+        busy_ = false;
+    }
+};
+
+static CompletionEngine g_completion;
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+void completion_init() {
+    g_completion.refresh(true);
+}
+
+void completion_shutdown() {
+    g_completion.shutdown();
+}
+
+static bool is_word_break(char c) {
+    return c == ' ' || c == '\t' || c == '|' || c == ';' || c == '&' ||
+           c == '<' || c == '>' || c == '(' || c == ')';
+}
+
+static std::string escape_candidate(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (strchr(" \t\\'\"|&;<>()$*?#`", c) != nullptr) {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+std::vector<std::string> complete_line(const std::string& line, size_t cursor,
+                                       size_t& word_start) {
+    std::vector<std::string> candidates;
+    if (cursor > line.size()) {
+        return candidates;
+    }
+
+    // Find the start of the word under the cursor (honouring "\ ")
+    size_t start = cursor;
+    while (start > 0 && !(is_word_break(line[start - 1]) &&
+                          !(start > 1 && line[start - 2] == '\\'))) {
+        start--;
+    }
+    word_start = start;
+
+    std::string word;
+    for (size_t i = start; i < cursor; i++) {
+        if (line[i] == '\\' && i + 1 < cursor) i++;
+        word += line[i];
+    }
+
+    // Command position: first word, or right after an operator
+    size_t p = start;
+    while (p > 0 && (line[p - 1] == ' ' || line[p - 1] == '\t')) p--;
+    bool command_position = (p == 0 || strchr("|;&(", line[p - 1]) != nullptr);
+
+    // $NAME - variable names
+    if (!word.empty() && word[0] == '$') {
+        std::string prefix = word.substr(1);
+        for (const auto& pair : get_all_env()) {
+            if (pair.first.compare(0, prefix.size(), prefix) == 0) {
+                candidates.push_back("$" + pair.first);
+            }
+        }
+        return candidates;
+    }
+
+    // Command names come from the background-built trie
+    if (command_position && word.find('/') == std::string::npos) {
+        auto trie = g_completion.snapshot();
+        if (trie) {
+            trie->collect(word, candidates);
+        }
+        g_completion.refresh(false);
+        for (auto& cand : candidates) cand = escape_candidate(cand);
+        return candidates;
+    }
+
+    // File names, read with the same directory matcher as globbing
+    size_t slash = word.rfind('/');
+    std::string shown_dir = (slash == std::string::npos) ? "" : word.substr(0, slash + 1);
+    std::string prefix = (slash == std::string::npos) ? word : word.substr(slash + 1);
+    std::string dir = shown_dir;
+    if (dir.compare(0, 2, "~/") == 0) {
+        dir = get_env("HOME") + dir.substr(1);
+    }
+
+    for (const auto& name : match_directory(dir.empty() ? "." : dir, prefix + "*")) {
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::string cand = shown_dir + name;
+        struct stat st;
+        std::string full = (dir.empty() ? "" : dir) + name;
+        if (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            cand += '/';
+        }
+        candidates.push_back(escape_candidate(cand));
+    }
+    return candidates;
+}
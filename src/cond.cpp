@@ -0,0 +1,429 @@
+#include "cond.h"
+#include "arith.h"
+#include "env.h"
+#include "parser.h"
+#include "wildcard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <regex.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// ============================================================================
+// File Status Cache
+// ============================================================================
+// `[ -f x ] && [ -r x ]` or `[[ -d x && -w x ]]` stat x once. Permission
+// checks are answered from the cached mode bits instead of access().
+
+struct StatEntry {
+    bool ok;
+    struct stat st;
+};
+
+static std::unordered_map<std::string, StatEntry> g_stats;     // stat()
+static std::unordered_map<std::string, StatEntry> g_lstats;    // lstat()
+
+void cond_forget_stats() {
+    if (!g_stats.empty() || !g_lstats.empty()) {
+        g_stats.clear();
+        g_lstats.clear();
+    }
+}
+
+static const StatEntry& file_status(const std::string& path, bool follow) {
+    auto& cache = follow ? g_stats : g_lstats;
+    auto it = cache.find(path);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    StatEntry entry;
+    entry.ok = (follow ? stat(path.c_str(), &entry.st) : lstat(path.c_str(), &entry.st)) == 0;
+    return cache.emplace(path, entry).first->second;
+}
+
+static bool in_group(gid_t gid) {
+    static std::vector<gid_t> groups;
+    static bool loaded = false;
+    if (!loaded) {
+        int count = getgroups(0, nullptr);
+        if (count > 0) {
+            groups.resize(count);
+            groups.resize(std::max(0, getgroups(count, groups.data())));
+        }
+        loaded = true;
+    }
+    if (gid == getegid()) {
+        return true;
+    }
+    for (gid_t g : groups) {
+        if (g == gid) return true;
+    }
+    return false;
+}
+
+// R_OK, W_OK or X_OK for the effective user, from the mode bits
+static bool may_access(const struct stat& st, int mode) {
+    uid_t uid = geteuid();
+    if (uid == 0) {
+        // Root may read and write anything, and execute if any x bit is set
+        return mode != X_OK || (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0;
+    }
+    int shift = st.st_uid == uid ? 6 : in_group(st.st_gid) ? 3 : 0;
+    return ((st.st_mode >> shift) & mode) != 0;
+}
+
+// ============================================================================
+// Regular Expression Cache
+// ============================================================================
+
+struct CompiledRegex {
+    regex_t regex;
+    bool compiled = false;               // regcomp succeeded: regfree it
+    ~CompiledRegex() {
+        if (compiled) regfree(&regex);
+    }
+};
+
+static const size_t MAX_CACHED_REGEXES = 64;
+
+static std::unordered_map<std::string, std::unique_ptr<CompiledRegex>> g_regexes;
+
+// Compile (or reuse) `pattern`; nullptr and `error` set if it is invalid
+static const regex_t* compile_regex(const std::string& pattern, std::string& error) {
+    auto it = g_regexes.find(pattern);
+    if (it != g_regexes.end()) {
+        return &it->second->regex;
+    }
+
+    std::unique_ptr<CompiledRegex> compiled(new CompiledRegex);
+    int code = regcomp(&compiled->regex, pattern.c_str(), REG_EXTENDED);
+    if (code != 0) {
+        char buffer[256];
+        regerror(code, &compiled->regex, buffer, sizeof(buffer));
+        error = buffer;
+        return nullptr;
+    }
+    compiled->compiled = true;
+
+    if (g_regexes.size() >= MAX_CACHED_REGEXES) {
+        g_regexes.clear();
+    }
+    return &g_regexes.emplace(pattern, std::move(compiled)).first->second->regex;
+}
+
+// ============================================================================
+// Expression Evaluator
+// ============================================================================
+//
+//   or      := and (('-o' | '||') and)*
+//   and     := not (('-a' | '&&') not)*
+//   not     := '!' not | primary
+//   primary := '(' or ')' | operand binop operand | unop operand | operand
+//
+
+class CondEvaluator {
+public:
+    CondEvaluator(const std::vector<std::string>& words, bool extended)
+        : words_(words), extended_(extended) {}
+
+    // 0 true, 1 false, 2 error (`error` says why)
+    int run(std::string& error) {
+        bool value = false;
+        if (!words_.empty()) {
+            value = parse_or(true);
+            if (error_.empty() && pos_ < words_.size()) {
+                error_ = words_[pos_] + ": unexpected argument";
+            }
+        }
+        error = error_;
+        return !error_.empty() ? 2 : value ? 0 : 1;
+    }
+
+private:
+    const std::vector<std::string>& words_;
+    bool extended_;              // [[ ]]: raw words, && || < > and patterns
+    size_t pos_ = 0;
+    std::string error_;
+
+    bool at(const char* word) const {
+        return pos_ < words_.size() && words_[pos_] == word;
+    }
+
+    bool more(size_t n) const {
+        return pos_ + n < words_.size();
+    }
+
+    std::string operand(const std::string& word) const {
+        return extended_ ? expand_word_single(word) : word;
+    }
+
+    // Each parse_* consumes its words; with `eval` false (the skipped side
+    // of && or ||) nothing is expanded or tested
+    bool parse_or(bool eval) {
+        bool value = parse_and(eval);
+        while (error_.empty() && at(extended_ ? "||" : "-o")) {
+            pos_++;
+            bool rhs = parse_and(eval && !value);
+            value = value || rhs;
+        }
+        return value;
+    }
+
+    bool parse_and(bool eval) {
+        bool value = parse_not(eval);
+        while (error_.empty() && at(extended_ ? "&&" : "-a")) {
+            pos_++;
+            bool rhs = parse_not(eval && value);
+            value = value && rhs;
+        }
+        return value;
+    }
+
+    bool parse_not(bool eval) {
+        if (at("!") && more(1)) {
+            pos_++;
+            return !parse_not(eval);
+        }
+        return parse_primary(eval);
+    }
+
+    bool parse_primary(bool eval) {
+        if (pos_ >= words_.size()) {
+            error_ = "argument expected";
+            return false;
+        }
+
+        if (at("(") && more(1)) {
+            pos_++;
+            bool value = parse_or(eval);
+            if (error_.empty() && !at(")")) {
+                error_ = "`)' expected";
+            }
+            pos_++;
+            return value;
+        }
+
+        if (more(2) && is_binary(words_[pos_ + 1])) {
+            const std::string& lhs = words_[pos_];
+            const std::string& op = words_[pos_ + 1];
+            const std::string& rhs = words_[pos_ + 2];
+            pos_ += 3;
+            return eval && binary(lhs, op, rhs);
+        }
+
+        const std::string& word = words_[pos_];
+        if (more(1) && is_unary(word)) {
+            const std::string& arg = words_[pos_ + 1];
+            pos_ += 2;
+            return eval && unary(word[1], operand(arg));
+        }
+
+        pos_++;
+        return eval && !operand(word).empty();
+    }
+
+    bool is_unary(const std::string& op) const {
+        return op.size() == 2 && op[0] == '-' &&
+               std::string("abcdefghknoprstuvwxzGLOS").find(op[1]) != std::string::npos;
+    }
+
+    bool is_binary(const std::string& op) const {
+        static const char* const OPS[] = {
+            "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+            "-nt", "-ot", "-ef"
+        };
+        for (const char* known : OPS) {
+            if (op == known) return true;
+        }
+        return extended_ && op == "=~";
+    }
+
+    bool unary(char op, const std::string& arg) {
+        switch (op) {
+            case 'z': return arg.empty();
+            case 'n': return !arg.empty();
+            case 'o': return false;              // Shell options are not supported
+            case 'v': return env_is_set(arg);
+            case 't': {
+                int64_t fd;
+                return integer(arg, fd) && isatty(static_cast<int>(fd));
+            }
+            case 'h':
+            case 'L': {
+                const StatEntry& entry = file_status(arg, false);
+                return entry.ok && S_ISLNK(entry.st.st_mode);
+            }
+        }
+
+        const StatEntry& entry = file_status(arg, true);
+        if (!entry.ok) {
+            return false;
+        }
+        const struct stat& st = entry.st;
+        switch (op) {
+            case 'a':
+            case 'e': return true;
+            case 'f': return S_ISREG(st.st_mode);
+            case 'd': return S_ISDIR(st.st_mode);
+            case 'b': return S_ISBLK(st.st_mode);
+            case 'c': return S_ISCHR(st.st_mode);
+            case 'p': return S_ISFIFO(st.st_mode);
+            case 'S': return S_ISSOCK(st.st_mode);
+            case 's': return st.st_size > 0;
+            case 'g': return (st.st_mode & S_ISGID) != 0;
+            case 'u': return (st.st_mode & S_ISUID) != 0;
+            case 'k': return (st.st_mode & S_ISVTX) != 0;
+            case 'r': return may_access(st, R_OK);
+            case 'w': return may_access(st, W_OK);
+            case 'x': return may_access(st, X_OK);
+            case 'O': return st.st_uid == geteuid();
+            case 'G': return st.st_gid == getegid();
+        }
+        return false;
+    }
+
+    bool binary(const std::string& lhs_raw, const std::string& op, const std::string& rhs_raw) {
+        std::string lhs = operand(lhs_raw);
+
+        if (op == "=" || op == "==" || op == "!=") {
+            bool equal = extended_ ? match_pattern(expand_pattern(rhs_raw), lhs)
+                                   : lhs == rhs_raw;
+            return (op == "!=") != equal;
+        }
+        if (op == "=~") {
+            return regex_match(lhs, regex_pattern(rhs_raw));
+        }
+
+        std::string rhs = operand(rhs_raw);
+        if (op == "<") return lhs < rhs;
+        if (op == ">") return lhs > rhs;
+        if (op == "-nt" || op == "-ot" || op == "-ef") {
+            return compare_files(lhs, op, rhs);
+        }
+
+        int64_t a, b;
+        if (!integer(lhs, a) || !integer(rhs, b)) {
+            return false;
+        }
+        if (op == "-eq") return a == b;
+        if (op == "-ne") return a != b;
+        if (op == "-lt") return a < b;
+        if (op == "-le") return a <= b;
+        if (op == "-gt") return a > b;
+        return a >= b;                           // -ge
+    }
+
+    // test wants a decimal integer; [[ ]] evaluates an arithmetic expression
+    bool integer(const std::string& text, int64_t& value) {
+        if (extended_) {
+            std::string error;
+            if (!arith_eval(text, value, error)) {
+                error_ = error;
+                return false;
+            }
+            return true;
+        }
+
+        size_t start = text.find_first_not_of(" \t");
+        size_t end = text.find_last_not_of(" \t");
+        std::string trimmed = start == std::string::npos ? "" : text.substr(start, end - start + 1);
+        char* stop = nullptr;
+        errno = 0;
+        value = std::strtoll(trimmed.c_str(), &stop, 10);
+        if (trimmed.empty() || *stop != '\0' || errno == ERANGE) {
+            error_ = text + ": integer expression expected";
+            return false;
+        }
+        return true;
+    }
+
+    bool compare_files(const std::string& lhs, const std::string& op, const std::string& rhs) {
+        const StatEntry& a = file_status(lhs, true);
+        const StatEntry& b = file_status(rhs, true);
+        if (op == "-ef") {
+            return a.ok && b.ok && a.st.st_dev == b.st.st_dev && a.st.st_ino == b.st.st_ino;
+        }
+        // A missing file is older than any existing one
+        if (!a.ok || !b.ok) {
+            return op == "-nt" ? a.ok : b.ok;
+        }
+        const struct timespec& ta = a.st.st_mtim;
+        const struct timespec& tb = b.st.st_mtim;
+        bool newer = ta.tv_sec != tb.tv_sec ? ta.tv_sec > tb.tv_sec : ta.tv_nsec > tb.tv_nsec;
+        bool older = ta.tv_sec != tb.tv_sec ? ta.tv_sec < tb.tv_sec : ta.tv_nsec < tb.tv_nsec;
+        return op == "-nt" ? newer : older;
+    }
+
+    // Quoted parts of a =~ operand match literally: the pattern expansion
+    // marks them with backslashes, which are kept only where ERE needs them
+    std::string regex_pattern(const std::string& raw) const {
+        std::string escaped = expand_pattern(raw);
+        std::string pattern;
+        for (size_t i = 0; i < escaped.size(); i++) {
+            if (escaped[i] == '\\' && i + 1 < escaped.size()) {
+                char c = escaped[++i];
+                if (std::strchr(".[]()*+?{}|^$\\", c) != nullptr) {
+                    pattern += '\\';
+                }
+                pattern += c;
+            } else {
+                pattern += escaped[i];
+            }
+        }
+        return pattern;
+    }
+
+    // =~: on a match BASH_REMATCH holds the whole match and each group
+    bool regex_match(const std::string& text, const std::string& pattern) {
+        std::string error;
+        const regex_t* regex = compile_regex(pattern, error);
+        if (regex == nullptr) {
+            error_ = pattern + ": " + error;
+            return false;
+        }
+
+        std::vector<regmatch_t> groups(regex->re_nsub + 1);
+        bool matched = regexec(regex, text.c_str(), groups.size(), groups.data(), 0) == 0;
+
+        unset_env("BASH_REMATCH");
+        declare_array("BASH_REMATCH", false);
+        if (matched) {
+            for (size_t k = 0; k < groups.size(); k++) {
+                std::string group;
+                if (groups[k].rm_so >= 0) {
+                    group = text.substr(groups[k].rm_so, groups[k].rm_eo - groups[k].rm_so);
+                }
+                set_array_element("BASH_REMATCH", std::to_string(k), group);
+            }
+        }
+        return matched;
+    }
+};
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+int test_eval(const std::vector<std::string>& args, std::string& error) {
+    return CondEvaluator(args, false).run(error);
+}
+
+int cond_eval(const std::vector<std::string>& raw_words) {
+    g_expansion_error = false;
+    std::string error;
+    int status = CondEvaluator(raw_words, true).run(error);
+    if (!error.empty()) {
+        std::cerr << "myshell: [[: " << error << std::endl;
+    }
+    if (g_expansion_error) {
+        g_expansion_error = false;
+        status = 2;
+    }
+    return status;
+}
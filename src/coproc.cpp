@@ -0,0 +1,142 @@
+#include "coproc.h"
+#include "env.h"
+#include "executor.h"
+#include "signals.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+struct Coproc {
+    std::string name;                    // Empty once replaced by a newer one
+    pid_t pid;
+    int read_fd;                         // -1 once closed
+    int write_fd;
+    bool running;                        // Exit not seen yet (false if untracked)
+};
+
+static std::vector<Coproc> g_coprocs;
+
+// ============================================================================
+// Bookkeeping
+// ============================================================================
+
+static void close_fd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// The coprocess has exited: nothing is left to write to
+static void finish(Coproc& co) {
+    co.running = false;
+    close_fd(co.write_fd);
+    if (!co.name.empty() && get_env(co.name + "_PID") == std::to_string(co.pid)) {
+        unset_env(co.name + "_PID");
+        unset_array_element(co.name, "1");
+    }
+}
+
+void reap_coprocs() {
+    for (size_t i = 0; i < g_coprocs.size();) {
+        Coproc& co = g_coprocs[i];
+        if (co.running && tracked_child_status(co.pid) != -1) {
+            finish(co);
+        }
+        // A replaced coprocess is forgotten once it has exited
+        if (co.name.empty() && !co.running) {
+            g_coprocs.erase(g_coprocs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Close the descriptors of an older coprocess called `name`
+static void replace(const std::string& name) {
+    for (auto& co : g_coprocs) {
+        if (co.name == name) {
+            if (co.running) {
+                std::cerr << "myshell: warning: coproc [" << co.pid << ":" << name
+                          << "] still exists" << std::endl;
+            }
+            close_fd(co.read_fd);
+            close_fd(co.write_fd);
+            co.name.clear();
+        }
+    }
+}
+
+// ============================================================================
+// Starting a Coprocess
+// ============================================================================
+
+int start_coproc(const std::string& name, Command& cmd) {
+    reap_coprocs();
+
+    // to_child carries the shell's writes, from_child the coprocess's output
+    int to_child[2];
+    int from_child[2];
+    if (pipe2(to_child, O_CLOEXEC) == -1) {
+        shell_perror("pipe");
+        return ERR_PIPE_FAILED;
+    }
+    if (pipe2(from_child, O_CLOEXEC) == -1) {
+        shell_perror("pipe");
+        close(to_child[0]);
+        close(to_child[1]);
+        return ERR_PIPE_FAILED;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    // The reaper must not collect the child before it is tracked
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        shell_perror("fork");
+        for (int fd : {to_child[0], to_child[1], from_child[0], from_child[1]}) {
+            close(fd);
+        }
+        restore_sigmask(&old_mask);
+        return ERR_FORK_FAILED;
+    }
+
+    if (pid == 0) {
+        // === CHILD PROCESS ===
+        setup_child_signals();
+        for (auto& co : g_coprocs) {
+            close_fd(co.read_fd);        // Would keep other coprocesses' pipes open
+            close_fd(co.write_fd);
+        }
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        for (int fd : {to_child[0], to_child[1], from_child[0], from_child[1]}) {
+            close(fd);
+        }
+        run_in_child(cmd);
+    }
+
+    // === PARENT PROCESS ===
+    bool tracked = track_child(pid);
+    restore_sigmask(&old_mask);
+    close(to_child[0]);
+    close(from_child[1]);
+
+    replace(name);
+    g_coprocs.push_back({name, pid, from_child[0], to_child[1], tracked});
+
+    unset_env(name);
+    declare_array(name, false);
+    set_array_element(name, "0", std::to_string(from_child[0]));
+    set_array_element(name, "1", std::to_string(to_child[1]));
+    set_var(name + "_PID", std::to_string(pid));
+    return SHELL_OK;
+}
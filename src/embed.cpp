@@ -0,0 +1,273 @@
+#include "myshell.h"
+#include "builtins.h"
+#include "bytecode.h"
+#include "context.h"
+#include "env.h"
+#include "signals.h"
+#include "syntax.h"
+#include "vm.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace myshell {
+
+// Held for the whole of every call; recursive so that calls may nest
+static std::recursive_mutex g_mutex;
+
+// ============================================================================
+// Compiled Script Cache
+// ============================================================================
+
+struct CompiledScript {
+    Program program;
+    std::string error;                   // Syntax error, if any
+};
+
+static const size_t MAX_CACHED_SCRIPTS = 64;
+
+static std::unordered_map<std::string, std::shared_ptr<const CompiledScript>> g_scripts;
+
+static std::shared_ptr<const CompiledScript> compile(const std::string& script) {
+    auto it = g_scripts.find(script);
+    if (it != g_scripts.end()) {
+        return it->second;
+    }
+
+    auto compiled = std::make_shared<CompiledScript>();
+    ParseResult parsed = parse_script(script);
+    if (!parsed.error.empty()) {
+        compiled->error = parsed.error;
+    } else {
+        compiled->program = compile_script(parsed.list);
+    }
+
+    if (g_scripts.size() >= MAX_CACHED_SCRIPTS) {
+        g_scripts.clear();
+    }
+    g_scripts.emplace(script, compiled);
+    return compiled;
+}
+
+// ============================================================================
+// Entering a Shell
+// ============================================================================
+// For the length of a call g_context is the Shell's context and, if the
+// call runs commands, the process's working directory is the Shell's; both
+// are put back after it
+
+class ContextGuard {
+public:
+    ContextGuard(ShellContext* context, bool runs_commands)
+        : lock_(g_mutex), saved_context_(g_context), saved_depth_(g_function_depth),
+          saved_returning_(g_returning), runs_commands_(runs_commands) {
+        g_context = context;
+        g_function_depth = 0;
+        g_returning = false;
+        if (!runs_commands) {
+            return;
+        }
+        saved_cwd_ = current_directory();
+        if (!context->cwd.empty() && context->cwd != saved_cwd_ &&
+            chdir(context->cwd.c_str()) != 0) {
+            context->cwd.clear();        // Gone: stay where the process is
+        }
+    }
+
+    ~ContextGuard() {
+        if (runs_commands_) {
+            g_context->cwd = current_directory();
+            if (!saved_cwd_.empty() && g_context->cwd != saved_cwd_ &&
+                chdir(saved_cwd_.c_str()) != 0) {
+                std::perror("myshell: chdir");
+            }
+        }
+        g_context = saved_context_;
+        g_function_depth = saved_depth_;
+        g_returning = saved_returning_;
+    }
+
+private:
+    static std::string current_directory() {
+        char cwd[PATH_MAX];
+        return getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "";
+    }
+
+    std::lock_guard<std::recursive_mutex> lock_;
+    ShellContext* saved_context_;
+    int saved_depth_;
+    bool saved_returning_;
+    bool runs_commands_;
+    std::string saved_cwd_;
+};
+
+// ============================================================================
+// Standard Descriptors of a Run
+// ============================================================================
+// Input, output and error are memory files, so output of any size is
+// collected without a reader thread and children inherit them as usual
+
+class StdioCapture {
+public:
+    ~StdioCapture() {
+        restore();
+    }
+
+    bool begin(const std::string& input) {
+        flush();
+        for (int fd = 0; fd < 3; fd++) {
+            saved_[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+            files_[fd] = memfd_create("myshell-stdio", MFD_CLOEXEC);
+            if (files_[fd] == -1) {
+                restore();
+                return false;
+            }
+        }
+        if (!write_all(files_[0], input)) {
+            restore();
+            return false;
+        }
+        lseek(files_[0], 0, SEEK_SET);
+        for (int fd = 0; fd < 3; fd++) {
+            dup2(files_[fd], fd);
+        }
+        active_ = true;
+        return true;
+    }
+
+    void end(std::string& out, std::string& err) {
+        flush();
+        read_all(files_[1], out);
+        read_all(files_[2], err);
+        restore();
+    }
+
+private:
+    int saved_[3] = {-1, -1, -1};
+    int files_[3] = {-1, -1, -1};
+    bool active_ = false;
+
+    static void flush() {
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+    }
+
+    static bool write_all(int fd, const std::string& text) {
+        size_t done = 0;
+        while (done < text.size()) {
+            ssize_t n = write(fd, text.data() + done, text.size() - done);
+            if (n == -1 && errno != EINTR) {
+                return false;
+            }
+            done += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+        return true;
+    }
+
+    static void read_all(int fd, std::string& text) {
+        off_t size = lseek(fd, 0, SEEK_END);
+        text.resize(size > 0 ? static_cast<size_t>(size) : 0);
+        size_t done = 0;
+        while (done < text.size()) {
+            ssize_t n = pread(fd, &text[done], text.size() - done, static_cast<off_t>(done));
+            if (n <= 0 && !(n == -1 && errno == EINTR)) {
+                break;
+            }
+            done += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+        text.resize(done);
+    }
+
+    void restore() {
+        for (int fd = 0; fd < 3; fd++) {
+            if (active_) {
+                if (saved_[fd] != -1) {
+                    dup2(saved_[fd], fd);
+                } else {
+                    close(fd);
+                }
+            }
+            if (saved_[fd] != -1) close(saved_[fd]);
+            if (files_[fd] != -1) close(files_[fd]);
+            saved_[fd] = files_[fd] = -1;
+        }
+        active_ = false;
+    }
+};
+
+// ============================================================================
+// Shell
+// ============================================================================
+
+Shell::Shell() : context_(new ShellContext) {
+    ContextGuard guard(context_.get(), true);
+    g_context->owns_environ = false;
+    init_environment();
+    init_builtins();
+}
+
+Shell::~Shell() = default;
+
+RunResult Shell::run(const std::string& script, const std::string& input) {
+    RunResult result;
+    ContextGuard guard(context_.get(), true);
+    std::shared_ptr<const CompiledScript> compiled = compile(script);
+
+    StdioCapture capture;
+    if (!capture.begin(input)) {
+        result.status = ERR_REDIRECT_FAILED;
+        result.err = std::string("myshell: cannot capture output: ") + std::strerror(errno) + "\n";
+        result.stage_statuses.push_back(result.status);
+        return result;
+    }
+
+    g_context->running = true;
+    g_context->pipe_status.clear();
+    if (!compiled->error.empty()) {
+        std::cerr << "myshell: " << compiled->error << std::endl;
+        g_context->last_exit_status = ERR_SYNTAX_ERROR;
+    } else {
+        g_interrupted = 0;
+        g_context->last_exit_status = run_program(compiled->program);
+    }
+    capture.end(result.out, result.err);
+
+    // `exit` ends this run only
+    g_context->running = true;
+    result.status = g_context->last_exit_status;
+    result.stage_statuses = g_context->pipe_status;
+    if (result.stage_statuses.empty()) {
+        result.stage_statuses.push_back(result.status);
+    }
+    return result;
+}
+
+std::string Shell::check(const std::string& script) {
+    std::lock_guard<std::recursive_mutex> lock(g_mutex);
+    return compile(script)->error;
+}
+
+std::string Shell::get_var(const std::string& name) {
+    ContextGuard guard(context_.get(), false);
+    return get_env(name);
+}
+
+void Shell::set_var(const std::string& name, const std::string& value, bool exported) {
+    ContextGuard guard(context_.get(), false);
+    if (exported) {
+        set_env(name, value);
+    } else {
+        ::set_var(name, value);
+    }
+}
+
+} // namespace myshell
@@ -1,13 +1,16 @@
 #include "env.h"
+#include "context.h"
 #include <cstring>
 #include <cstdlib>
 #include <unistd.h>
+#include <unordered_map>
 
 // ============================================================================
 // Environment Variable Storage
 // ============================================================================
 
-static std::map<std::string, std::string> g_env_vars;
+// Variables, arrays and positional parameters live in the current
+// ShellContext (context.h)
 
 // ============================================================================
 // Initialize Environment from System
@@ -22,7 +25,7 @@ void init_environment() {
         if (pos != std::string::npos) {
             std::string name = entry.substr(0, pos);
             std::string value = entry.substr(pos + 1);
-            g_env_vars[name] = value;
+            g_context->env_vars[name] = value;
         }
     }
 }
@@ -32,11 +35,19 @@ void init_environment() {
 // ============================================================================
 
 std::string get_env(const std::string& name) {
-    auto it = g_env_vars.find(name);
-    if (it != g_env_vars.end()) {
+    auto it = g_context->env_vars.find(name);
+    if (it != g_context->env_vars.end()) {
         return it->second;
     }
-    return "";
+    it = g_context->shell_vars.find(name);
+    if (it != g_context->shell_vars.end()) {
+        return it->second;
+    }
+    std::string value;
+    if (!g_context->arrays.empty() && g_context->arrays.count(name) > 0) {
+        get_array_element(name, "0", value);
+    }
+    return value;
 }
 
 // ============================================================================
@@ -44,10 +55,16 @@ std::string get_env(const std::string& name) {
 // ============================================================================
 
 void set_env(const std::string& name, const std::string& value) {
-    g_env_vars[name] = value;
+    g_context->shell_vars.erase(name);
+    if (!g_context->arrays.empty()) {
+        g_context->arrays.erase(name);
+    }
+    g_context->env_vars[name] = value;
     
     // Also update the actual environment for child processes
-    setenv(name.c_str(), value.c_str(), 1);
+    if (g_context->owns_environ) {
+        setenv(name.c_str(), value.c_str(), 1);
+    }
 }
 
 // ============================================================================
@@ -55,10 +72,14 @@ void set_env(const std::string& name, const std::string& value) {
 // ============================================================================
 
 void unset_env(const std::string& name) {
-    g_env_vars.erase(name);
+    g_context->env_vars.erase(name);
+    g_context->shell_vars.erase(name);
+    g_context->arrays.erase(name);
     
     // Also remove from actual environment
-    unsetenv(name.c_str());
+    if (g_context->owns_environ) {
+        unsetenv(name.c_str());
+    }
 }
 
 // ============================================================================
@@ -66,6 +87,254 @@ void unset_env(const std::string& name) {
 // ============================================================================
 
 const std::map<std::string, std::string>& get_all_env() {
-    return g_env_vars;
+    return g_context->env_vars;
+}
+
+bool env_is_set(const std::string& name) {
+    return g_context->env_vars.count(name) > 0 || g_context->shell_vars.count(name) > 0 ||
+           g_context->arrays.count(name) > 0;
+}
+
+// ============================================================================
+// Shell Variables
+// ============================================================================
+
+void set_var(const std::string& name, const std::string& value) {
+    if (!g_context->arrays.empty() && g_context->arrays.count(name) > 0) {
+        set_array_element(name, "0", value);
+    } else if (g_context->env_vars.count(name) > 0) {
+        set_env(name, value);
+    } else {
+        g_context->shell_vars[name] = value;
+    }
+}
+
+void export_var(const std::string& name) {
+    auto it = g_context->shell_vars.find(name);
+    if (it != g_context->shell_vars.end()) {
+        std::string value = it->second;
+        set_env(name, value);
+    }
+}
+
+// ============================================================================
+// Arrays
+// ============================================================================
+
+// Indexes beyond this are refused rather than allocated
+static const long long MAX_ARRAY_INDEX = 1 << 24;
+
+ArrayKind array_kind(const std::string& name) {
+    auto it = g_context->arrays.find(name);
+    return it == g_context->arrays.end() ? ARRAY_NONE : it->second.kind;
 }
 
+bool declare_array(const std::string& name, bool associative) {
+    ArrayKind kind = associative ? ARRAY_ASSOCIATIVE : ARRAY_INDEXED;
+    auto it = g_context->arrays.find(name);
+    if (it != g_context->arrays.end()) {
+        return it->second.kind == kind;
+    }
+    
+    bool had_value = env_is_set(name);
+    std::string value = get_env(name);
+    g_context->shell_vars.erase(name);
+    if (g_context->env_vars.erase(name) > 0 && g_context->owns_environ) {
+        unsetenv(name.c_str());
+    }
+    
+    ShellArray& array = g_context->arrays[name];
+    array.kind = kind;
+    if (had_value) {
+        set_array_element(name, "0", value);
+    }
+    return true;
+}
+
+void clear_array(const std::string& name) {
+    auto it = g_context->arrays.find(name);
+    if (it != g_context->arrays.end()) {
+        ArrayKind kind = it->second.kind;
+        it->second = ShellArray();
+        it->second.kind = kind;
+    }
+}
+
+// Position of an indexed element, resolving negative indexes; -1 if none
+static long long resolve_index(const ShellArray& array, const std::string& key) {
+    char* end = nullptr;
+    long long index = std::strtoll(key.c_str(), &end, 10);
+    if (end == key.c_str() || *end != '\0') {
+        return -1;
+    }
+    if (index < 0) {
+        index += static_cast<long long>(array.items.size());
+    }
+    return index;
+}
+
+bool get_array_element(const std::string& name, const std::string& key, std::string& value) {
+    auto it = g_context->arrays.find(name);
+    if (it == g_context->arrays.end()) {
+        return false;
+    }
+    const ShellArray& array = it->second;
+    
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        auto found = array.map.find(key);
+        if (found == array.map.end()) {
+            return false;
+        }
+        value = found->second;
+        return true;
+    }
+    
+    long long index = resolve_index(array, key);
+    if (index < 0 || index >= static_cast<long long>(array.items.size()) || !array.present[index]) {
+        return false;
+    }
+    value = array.items[index];
+    return true;
+}
+
+bool set_array_element(const std::string& name, const std::string& key, const std::string& value) {
+    if (g_context->arrays.count(name) == 0) {
+        declare_array(name, false);
+    }
+    ShellArray& array = g_context->arrays[name];
+    
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        array.map[key] = value;
+        return true;
+    }
+    
+    long long index = resolve_index(array, key);
+    if (index < 0 || index > MAX_ARRAY_INDEX) {
+        return false;
+    }
+    if (index >= static_cast<long long>(array.items.size())) {
+        array.items.resize(index + 1);
+        array.present.resize(index + 1, false);
+    }
+    if (!array.present[index]) {
+        array.present[index] = true;
+        array.count++;
+    }
+    array.items[index] = value;
+    return true;
+}
+
+void append_array_element(const std::string& name, const std::string& value) {
+    if (g_context->arrays.count(name) == 0) {
+        declare_array(name, false);
+    }
+    ShellArray& array = g_context->arrays[name];
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        return;
+    }
+    array.items.push_back(value);
+    array.present.push_back(true);
+    array.count++;
+}
+
+void unset_array_element(const std::string& name, const std::string& key) {
+    auto it = g_context->arrays.find(name);
+    if (it == g_context->arrays.end()) {
+        return;
+    }
+    ShellArray& array = it->second;
+    
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        array.map.erase(key);
+        return;
+    }
+    
+    long long index = resolve_index(array, key);
+    if (index < 0 || index >= static_cast<long long>(array.items.size()) || !array.present[index]) {
+        return;
+    }
+    array.present[index] = false;
+    array.items[index].clear();
+    array.count--;
+    
+    // Trailing holes are dropped so that appends continue after the last element
+    while (!array.present.empty() && !array.present.back()) {
+        array.present.pop_back();
+        array.items.pop_back();
+    }
+}
+
+std::vector<std::string> array_values(const std::string& name) {
+    std::vector<std::string> values;
+    auto it = g_context->arrays.find(name);
+    if (it == g_context->arrays.end()) {
+        if (env_is_set(name)) {
+            values.push_back(get_env(name));
+        }
+        return values;
+    }
+    
+    const ShellArray& array = it->second;
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        for (const auto& pair : array.map) {
+            values.push_back(pair.second);
+        }
+    } else {
+        values.reserve(array.count);
+        for (size_t i = 0; i < array.items.size(); i++) {
+            if (array.present[i]) {
+                values.push_back(array.items[i]);
+            }
+        }
+    }
+    return values;
+}
+
+std::vector<std::string> array_keys(const std::string& name) {
+    std::vector<std::string> keys;
+    auto it = g_context->arrays.find(name);
+    if (it == g_context->arrays.end()) {
+        if (env_is_set(name)) {
+            keys.push_back("0");
+        }
+        return keys;
+    }
+    
+    const ShellArray& array = it->second;
+    if (array.kind == ARRAY_ASSOCIATIVE) {
+        for (const auto& pair : array.map) {
+            keys.push_back(pair.first);
+        }
+    } else {
+        for (size_t i = 0; i < array.items.size(); i++) {
+            if (array.present[i]) {
+                keys.push_back(std::to_string(i));
+            }
+        }
+    }
+    return keys;
+}
+
+size_t array_size(const std::string& name) {
+    auto it = g_context->arrays.find(name);
+    if (it == g_context->arrays.end()) {
+        return env_is_set(name) ? 1 : 0;
+    }
+    const ShellArray& array = it->second;
+    return array.kind == ARRAY_ASSOCIATIVE ? array.map.size() : array.count;
+}
+
+// ============================================================================
+// Positional Parameters
+// ============================================================================
+
+void set_positional_params(const std::vector<std::string>& params) {
+    g_context->positional = params;
+    if (g_context->positional.empty()) {
+        g_context->positional.push_back("myshell");
+    }
+}
+
+const std::vector<std::string>& get_positional_params() {
+    return g_context->positional;
+}
@@ -1,10 +1,20 @@
 #include "executor.h"
 #include "builtins.h"
 #include "signals.h"
+#include "env.h"
+#include "parser.h"
+#include "vm.h"
+#include "context.h"
+#include "fanout.h"
+#include "replicate.h"
 
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <vector>
@@ -13,7 +23,108 @@
 // Apply Redirections
 // ============================================================================
 
+// Put here-document text in a sealed in-memory file: unlike a pipe, no
+// writer has to stay around until the reader drains it, and unlike a
+// temporary file nothing reaches the disk
+static int here_document_fd(const std::string& text) {
+    int fd = memfd_create("myshell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1) {
+        shell_perror("here-document");
+        return -1;
+    }
+    
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            shell_perror("here-document");
+            close(fd);
+            return -1;
+        }
+        written += static_cast<size_t>(n);
+    }
+    
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// Fan-out pumps started by redirections in this process (cmd > a > b)
+static std::vector<pid_t> g_fanouts;
+
+// Wait for the pumps, once the output they carry has been closed
+static void finish_fanouts() {
+    for (pid_t pid : g_fanouts) {
+        while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+        }
+    }
+    g_fanouts.clear();
+}
+
+static int open_output(const std::string& path, bool append) {
+    int flags = O_WRONLY | O_CREAT;
+    flags |= append ? O_APPEND : O_TRUNC;
+    int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        shell_perror(path);
+    }
+    return fd;
+}
+
+// cmd > a > b: stdout becomes a pipe to a pump feeding every file
+static int redirect_fanout(const Command& cmd) {
+    std::vector<int> fds;
+    for (const auto& output : cmd.more_outputs) {
+        int fd = open_output(output.first, output.second);
+        if (fd != -1) {
+            fds.push_back(fd);
+        }
+    }
+    int fd = open_output(cmd.output_file, cmd.append_output);
+    if (fd != -1) {
+        fds.push_back(fd);
+    }
+    
+    int write_fd = -1;
+    pid_t pid = -1;
+    if (fds.size() == cmd.more_outputs.size() + 1) {
+        pid = start_fanout(fds, write_fd);
+    }
+    for (int output : fds) {
+        close(output);
+    }
+    if (pid == -1) {
+        return ERR_REDIRECT_FAILED;
+    }
+    g_fanouts.push_back(pid);
+    dup2(write_fd, STDOUT_FILENO);
+    close(write_fd);
+    return SHELL_OK;
+}
+
+// <&N, >&N, 2>&N: make `target` a copy of descriptor `fd`
+static int duplicate_fd(int fd, int target) {
+    if (fcntl(fd, F_GETFD) == -1 || (fd != target && dup2(fd, target) == -1)) {
+        shell_perror(std::to_string(fd));
+        return ERR_REDIRECT_FAILED;
+    }
+    return SHELL_OK;
+}
+
 int apply_redirections(const Command& cmd) {
+    // Here-document or here-string input
+    if (cmd.has_here_input) {
+        int fd = here_document_fd(cmd.here_input);
+        if (fd == -1) {
+            return ERR_REDIRECT_FAILED;
+        }
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+    
     // Input redirection
     if (!cmd.input_file.empty()) {
         int fd = open(cmd.input_file.c_str(), O_RDONLY);
@@ -24,9 +135,22 @@ int apply_redirections(const Command& cmd) {
         dup2(fd, STDIN_FILENO);
         close(fd);
     }
+    if (cmd.input_dup != -1 && duplicate_fd(cmd.input_dup, STDIN_FILENO) != SHELL_OK) {
+        return ERR_REDIRECT_FAILED;
+    }
+    
+    // 2>&1 >file copies stdout before it is redirected
+    if (cmd.error_dup != -1 && cmd.error_dup_first &&
+        duplicate_fd(cmd.error_dup, STDERR_FILENO) != SHELL_OK) {
+        return ERR_REDIRECT_FAILED;
+    }
     
     // Output redirection
-    if (!cmd.output_file.empty()) {
+    if (!cmd.output_file.empty() && !cmd.more_outputs.empty()) {
+        if (redirect_fanout(cmd) != SHELL_OK) {
+            return ERR_REDIRECT_FAILED;
+        }
+    } else if (!cmd.output_file.empty()) {
         int flags = O_WRONLY | O_CREAT;
         flags |= cmd.append_output ? O_APPEND : O_TRUNC;
         
@@ -38,6 +162,9 @@ int apply_redirections(const Command& cmd) {
         dup2(fd, STDOUT_FILENO);
         close(fd);
     }
+    if (cmd.output_dup != -1 && duplicate_fd(cmd.output_dup, STDOUT_FILENO) != SHELL_OK) {
+        return ERR_REDIRECT_FAILED;
+    }
     
     // Error redirection
     if (!cmd.error_file.empty()) {
@@ -49,15 +176,112 @@ int apply_redirections(const Command& cmd) {
         dup2(fd, STDERR_FILENO);
         close(fd);
     }
+    if (cmd.error_dup != -1 && !cmd.error_dup_first &&
+        duplicate_fd(cmd.error_dup, STDERR_FILENO) != SHELL_OK) {
+        return ERR_REDIRECT_FAILED;
+    }
+    
+    return SHELL_OK;
+}
+
+// ============================================================================
+// Redirections Applied to the Shell Itself
+// ============================================================================
+
+static void flush_output() {
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+}
+
+int redirect_shell(const Command& cmd, std::vector<std::pair<int, int>>& saved) {
+    bool redirects_input = !cmd.input_file.empty() || cmd.has_here_input || cmd.input_dup != -1;
+    bool redirects_output = !cmd.output_file.empty() || cmd.output_dup != -1;
+    bool redirects_error = !cmd.error_file.empty() || cmd.error_dup != -1;
+    if (!redirects_input && !redirects_output && !redirects_error) {
+        return SHELL_OK;
+    }
+    flush_output();
     
+    // Keep a copy of every descriptor the redirections will replace
+    int targets[3] = {
+        redirects_input ? STDIN_FILENO : -1,
+        redirects_output ? STDOUT_FILENO : -1,
+        redirects_error ? STDERR_FILENO : -1
+    };
+    for (int fd : targets) {
+        if (fd != -1) {
+            saved.push_back({fd, fcntl(fd, F_DUPFD_CLOEXEC, 10)});
+        }
+    }
+    
+    if (apply_redirections(cmd) != SHELL_OK) {
+        restore_shell_fds(saved);
+        return ERR_REDIRECT_FAILED;
+    }
     return SHELL_OK;
 }
 
+void restore_shell_fds(std::vector<std::pair<int, int>>& saved) {
+    if (saved.empty()) {
+        return;
+    }
+    flush_output();
+    
+    for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+        if (it->second != -1) {
+            dup2(it->second, it->first);
+            close(it->second);
+        } else {
+            close(it->first);
+        }
+    }
+    saved.clear();
+    finish_fanouts();
+}
+
+// ============================================================================
+// Alias Expansion
+// ============================================================================
+
+void expand_alias(Command& cmd) {
+    if (cmd.alias_expanded) {
+        return;
+    }
+    cmd.alias_expanded = true;
+    
+    // An alias may name another alias; stop at a name already replaced
+    std::vector<std::string> seen;
+    std::string value;
+    while (!cmd.args.empty() && find_alias(cmd.args[0], value) &&
+           std::find(seen.begin(), seen.end(), cmd.args[0]) == seen.end()) {
+        seen.push_back(cmd.args[0]);
+        
+        std::vector<std::string> words;
+        for (const auto& token : tokenize(value)) {
+            if (token.type == TOKEN_WORD) {
+                for (auto& field : expand_word(token.value)) {
+                    words.push_back(std::move(field));
+                }
+            }
+        }
+        cmd.args.erase(cmd.args.begin());
+        cmd.args.insert(cmd.args.begin(), words.begin(), words.end());
+    }
+}
+
 // ============================================================================
 // Execute Built-in Command
 // ============================================================================
 
+// Aliases, functions and builtins all run in the shell process itself
+static bool runs_in_shell(Command& cmd) {
+    expand_alias(cmd);
+    return cmd.args.empty() || find_function(cmd.name()) != nullptr || is_builtin(cmd.name());
+}
+
 bool execute_builtin(Command& cmd, int& exit_status) {
+    expand_alias(cmd);
     if (cmd.empty()) {
         exit_status = 0;
         return true;
@@ -65,35 +289,192 @@ bool execute_builtin(Command& cmd, int& exit_status) {
     
     const std::string& name = cmd.name();
     
-    if (!is_builtin(name)) {
-        return false;
+    // Dispatch order: alias (above) -> function -> builtin -> PATH
+    std::shared_ptr<const Program> function = find_function(name);
+    BuiltinFunc func;
+    if (function == nullptr) {
+        if (!is_builtin(name)) {
+            return false;
+        }
+        func = get_builtin(name);
     }
     
-    // Get the built-in function
-    BuiltinFunc func = get_builtin(name);
+    // VAR=value prefixes are exported for this command only
+    struct Saved {
+        std::string name;
+        std::string value;
+        bool was_set;
+        bool was_exported;
+    };
+    std::vector<Saved> previous;
+    for (const auto& assign : cmd.assignments) {
+        const std::string& var = assign.first;
+        previous.push_back({var, get_env(var), env_is_set(var), get_all_env().count(var) > 0});
+        set_env(var, assign.second);
+    }
     
     // Execute it
-    exit_status = func(cmd.args);
+    exit_status = function ? call_function(*function, cmd.args) : func(cmd.args);
+    
+    for (auto it = previous.rbegin(); it != previous.rend(); ++it) {
+        if (it->was_exported) {
+            set_env(it->name, it->value);
+        } else {
+            unset_env(it->name);
+            if (it->was_set) {
+                set_var(it->name, it->value);
+            }
+        }
+    }
     
     return true;
 }
 
+// ============================================================================
+// Run a Command Inside a Forked Child
+// ============================================================================
+
+// Leave the child without running the parent's static destructors
+static void child_exit(int status) {
+    flush_output();
+    _exit(status);
+}
+
+void run_in_child(Command& cmd) {
+    // Apply file redirections (overrides pipe if specified)
+    if (apply_redirections(cmd) != SHELL_OK) {
+        child_exit(ERR_REDIRECT_FAILED);
+    }
+    
+    // With a fan-out pump this process stays behind: whoever waits for it
+    // must not go on until the pump has written out the last of the output
+    if (!g_fanouts.empty()) {
+        sigset_t old_mask;
+        block_sigchld(&old_mask);
+        flush_output();
+        pid_t pid = fork();
+        if (pid == 0) {
+            restore_sigmask(&old_mask);
+            g_fanouts.clear();
+        } else {
+            close(STDOUT_FILENO);
+            int status = ERR_FORK_FAILED;
+            if (pid == -1) {
+                shell_perror("fork");
+            } else {
+                status = wait_for_child(pid);
+            }
+            finish_fanouts();
+            child_exit(status);
+        }
+    }
+    
+    // | [N] cmd |: this process hands out the input to the copies
+    if (cmd.replicas > 0) {
+        child_exit(run_replicated(cmd));
+    }
+    
+    // Compound command body (loop, if, ...) runs in this process
+    if (cmd.body != nullptr) {
+        for (const auto& assign : cmd.assignments) {
+            set_var(assign.first, assign.second);
+        }
+        child_exit(run_program(*cmd.body, cmd.body_entry));
+    }
+    
+    // Built-ins inside a pipeline run in the child too
+    int builtin_status;
+    if (execute_builtin(cmd, builtin_status)) {
+        child_exit(builtin_status);
+    }
+    
+    // Build argument array for execvp
+    std::vector<char*> argv;
+    for (auto& arg : cmd.args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    
+    // Execute the command
+    if (g_context->owns_environ) {
+        for (const auto& assign : cmd.assignments) {
+            setenv(assign.first.c_str(), assign.second.c_str(), 1);
+        }
+        execvp(argv[0], argv.data());
+    } else {
+        // An embedded shell's exports never reach the process environment
+        std::map<std::string, std::string> vars = get_all_env();
+        for (const auto& assign : cmd.assignments) {
+            vars[assign.first] = assign.second;
+        }
+        std::vector<std::string> entries;
+        for (const auto& var : vars) {
+            entries.push_back(var.first + "=" + var.second);
+        }
+        std::vector<char*> envp;
+        for (auto& entry : entries) {
+            envp.push_back(&entry[0]);
+        }
+        envp.push_back(nullptr);
+        execvpe(argv[0], argv.data(), envp.data());
+    }
+    
+    // If we get here, exec failed
+    if (errno == ENOENT) {
+        shell_error(ERR_CMD_NOT_FOUND, cmd.name());
+        child_exit(ERR_CMD_NOT_FOUND);
+    } else if (errno == EACCES) {
+        shell_error(ERR_PERMISSION_DENIED, cmd.name());
+        child_exit(ERR_PERMISSION_DENIED);
+    } else {
+        shell_perror(cmd.name());
+        child_exit(ERR_EXEC_FAILED);
+    }
+}
+
+bool exec_external(Command& cmd) {
+    if (cmd.empty() || cmd.body != nullptr || cmd.replicas > 0 || runs_in_shell(cmd)) {
+        return false;
+    }
+    flush_output();
+    run_in_child(cmd);
+    return true;                         // Not reached
+}
+
+// Wait for a child and convert its status to a shell exit code
+int wait_for_child(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return SHELL_OK;
+        }
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return SHELL_OK;
+}
+
 // ============================================================================
 // Execute Single Command
 // ============================================================================
 
-int execute_command(Command& cmd, int input_fd, int output_fd) {
+int execute_command(Command& cmd, int input_fd, int output_fd, const Placement& placement) {
     if (cmd.empty()) {
         return SHELL_OK;
     }
     
     // Check for built-in commands (only if no pipes)
     int builtin_status;
-    if (input_fd == -1 && output_fd == -1 && execute_builtin(cmd, builtin_status)) {
+    if (input_fd == -1 && output_fd == -1 && !cmd.background && cmd.body == nullptr &&
+        cmd.replicas == 0 && placement.empty() && execute_builtin(cmd, builtin_status)) {
         return builtin_status;
     }
     
     // Fork for external command
+    flush_output();
     pid_t pid = fork();
     
     if (pid == -1) {
@@ -117,32 +498,10 @@ int execute_command(Command& cmd, int input_fd, int output_fd) {
             close(output_fd);
         }
         
-        // Apply file redirections (overrides pipe if specified)
-        if (apply_redirections(cmd) != SHELL_OK) {
-            exit(ERR_REDIRECT_FAILED);
-        }
-        
-        // Build argument array for execvp
-        std::vector<char*> argv;
-        for (auto& arg : cmd.args) {
-            argv.push_back(const_cast<char*>(arg.c_str()));
-        }
-        argv.push_back(nullptr);
-        
-        // Execute the command
-        execvp(argv[0], argv.data());
-        
-        // If we get here, exec failed
-        if (errno == ENOENT) {
-            shell_error(ERR_CMD_NOT_FOUND, cmd.name());
-            exit(ERR_CMD_NOT_FOUND);
-        } else if (errno == EACCES) {
-            shell_error(ERR_PERMISSION_DENIED, cmd.name());
-            exit(ERR_PERMISSION_DENIED);
-        } else {
-            shell_perror(cmd.name());
-            exit(ERR_EXEC_FAILED);
+        if (!apply_placement(placement, 0)) {
+            child_exit(1);
         }
+        run_in_child(cmd);
     }
     
     // === PARENT PROCESS ===
@@ -153,7 +512,8 @@ int execute_command(Command& cmd, int input_fd, int output_fd) {
 // Execute Pipeline
 // ============================================================================
 
-int execute_pipeline(Pipeline& pipeline) {
+// Run the commands; a pipeline of several records each stage's status
+static int run_commands(Pipeline& pipeline) {
     if (pipeline.empty()) {
         return SHELL_OK;
     }
@@ -165,37 +525,47 @@ int execute_pipeline(Pipeline& pipeline) {
         Command& cmd = pipeline.commands[0];
         
         // Try builtin first (for commands like cd that must run in parent)
-        int builtin_status;
-        if (execute_builtin(cmd, builtin_status)) {
+        if (!pipeline.background && cmd.body == nullptr && cmd.replicas == 0 &&
+            pipeline.placement.empty() && runs_in_shell(cmd)) {
+            std::vector<std::pair<int, int>> saved;
+            if (redirect_shell(cmd, saved) != SHELL_OK) {
+                return 1;
+            }
+            int builtin_status = 0;
+            execute_builtin(cmd, builtin_status);
+            restore_shell_fds(saved);
             return builtin_status;
         }
         
-        // External command
-        pid_t pid = execute_command(cmd, -1, -1);
+        // External command (SIGCHLD held off until we have waited for it)
+        sigset_t old_mask;
+        block_sigchld(&old_mask);
+        pid_t pid = execute_command(cmd, -1, -1, pipeline.placement);
         if (pid < 0) {
+            restore_sigmask(&old_mask);
             return -pid;  // Error code
         }
         
         // Wait for completion (unless background)
+        int result = SHELL_OK;
         if (!pipeline.background) {
-            int status;
-            waitpid(pid, &status, 0);
-            if (WIFEXITED(status)) {
-                return WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                return 128 + WTERMSIG(status);
-            }
+            result = wait_for_child(pid);
         } else {
             std::cout << "[" << pid << "] Running in background" << std::endl;
         }
+        restore_sigmask(&old_mask);
         
-        return SHELL_OK;
+        return result;
     }
     
     // Multiple commands - create pipeline
     std::vector<pid_t> pids;
     int prev_pipe_read = -1;
     
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    flush_output();
+    
     for (int i = 0; i < n; i++) {
         int pipefd[2] = {-1, -1};
         
@@ -203,6 +573,8 @@ int execute_pipeline(Pipeline& pipeline) {
         if (i < n - 1) {
             if (pipe(pipefd) == -1) {
                 shell_perror("pipe");
+                if (prev_pipe_read != -1) close(prev_pipe_read);
+                restore_sigmask(&old_mask);
                 return ERR_PIPE_FAILED;
             }
         }
@@ -216,6 +588,7 @@ int execute_pipeline(Pipeline& pipeline) {
             if (prev_pipe_read != -1) close(prev_pipe_read);
             if (pipefd[0] != -1) close(pipefd[0]);
             if (pipefd[1] != -1) close(pipefd[1]);
+            restore_sigmask(&old_mask);
             return ERR_FORK_FAILED;
         }
         
@@ -236,29 +609,11 @@ int execute_pipeline(Pipeline& pipeline) {
                 close(pipefd[1]);
             }
             
-            // Apply file redirections
-            Command& cmd = pipeline.commands[i];
-            if (apply_redirections(cmd) != SHELL_OK) {
-                exit(ERR_REDIRECT_FAILED);
-            }
-            
-            // Execute command
-            std::vector<char*> argv;
-            for (auto& arg : cmd.args) {
-                argv.push_back(const_cast<char*>(arg.c_str()));
-            }
-            argv.push_back(nullptr);
-            
-            execvp(argv[0], argv.data());
-            
-            // Exec failed
-            if (errno == ENOENT) {
-                shell_error(ERR_CMD_NOT_FOUND, cmd.name());
-                exit(ERR_CMD_NOT_FOUND);
-            } else {
-                shell_perror(cmd.name());
-                exit(ERR_EXEC_FAILED);
+            // Confine, redirect, then exec (or run the builtin / compound body)
+            if (!apply_placement(pipeline.placement, i)) {
+                child_exit(1);
             }
+            run_in_child(pipeline.commands[i]);
         }
         
         // === PARENT PROCESS ===
@@ -275,20 +630,25 @@ int execute_pipeline(Pipeline& pipeline) {
     }
     
     // Wait for all children (unless background)
+    int last_status = SHELL_OK;
     if (!pipeline.background) {
-        int last_status = 0;
         for (pid_t pid : pids) {
-            int status;
-            waitpid(pid, &status, 0);
-            if (WIFEXITED(status)) {
-                last_status = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                last_status = 128 + WTERMSIG(status);
-            }
+            last_status = wait_for_child(pid);
+            g_context->pipe_status.push_back(last_status);
         }
-        return last_status;
     } else {
         std::cout << "[Pipeline] Running in background" << std::endl;
-        return SHELL_OK;
     }
+    restore_sigmask(&old_mask);
+    
+    return last_status;
+}
+
+int execute_pipeline(Pipeline& pipeline) {
+    g_context->pipe_status.clear();
+    int status = run_commands(pipeline);
+    if (g_context->pipe_status.empty()) {
+        g_context->pipe_status.push_back(status);
+    }
+    return status;
 }
@@ -0,0 +1,253 @@
+#include "fanout.h"
+#include "shell.h"
+#include "signals.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum TargetKind {
+    TARGET_PIPE,         // tee(2) from the input pipe
+    TARGET_FILE,         // splice(2), through a private pipe unless last
+    TARGET_OTHER         // read/write
+};
+
+struct Target {
+    int fd;
+    TargetKind kind;
+    size_t done = 0;     // Bytes of the current chunk already written
+    bool alive = true;
+};
+
+// ============================================================================
+// Transfers
+// ============================================================================
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Move `size` bytes from pipe `in` to `out`; returns how many were moved
+static size_t splice_all(int in, int out, size_t size) {
+    size_t moved = 0;
+    while (moved < size) {
+        ssize_t n = splice(in, nullptr, out, nullptr, size - moved, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        moved += static_cast<size_t>(n);
+    }
+    return moved;
+}
+
+// Duplicate up to `size` bytes of pipe `in` into pipe `out`; -1 on error
+static ssize_t tee_some(int in, int out, size_t size) {
+    while (true) {
+        ssize_t n = tee(in, out, size, 0);
+        if (n != -1 || errno != EINTR) {
+            return n;
+        }
+    }
+}
+
+static TargetKind classify(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return TARGET_OTHER;
+    }
+    if (S_ISFIFO(st.st_mode)) {
+        return TARGET_PIPE;
+    }
+    if (S_ISREG(st.st_mode)) {
+        // splice(2) refuses O_APPEND files: seek to the end instead, which
+        // is the same unless someone else writes to the file
+        int flags = fcntl(fd, F_GETFL);
+        if (flags != -1 && (flags & O_APPEND) &&
+            (lseek(fd, 0, SEEK_END) == -1 || fcntl(fd, F_SETFL, flags & ~O_APPEND) == -1)) {
+            return TARGET_OTHER;
+        }
+        return TARGET_FILE;
+    }
+    return TARGET_OTHER;
+}
+
+// ============================================================================
+// Pump
+// ============================================================================
+
+// Bytes waiting in pipe `in` (0 at end of input)
+static size_t wait_for_input(int in) {
+    while (true) {
+        struct pollfd pfd = {in, POLLIN, 0};
+        if (poll(&pfd, 1, -1) == -1) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        int avail = 0;
+        if (ioctl(in, FIONREAD, &avail) == -1) {
+            return 0;
+        }
+        if (avail > 0) {
+            return static_cast<size_t>(avail);
+        }
+        if (pfd.revents & (POLLHUP | POLLERR)) {
+            return 0;
+        }
+    }
+}
+
+static void pump(int in, std::vector<Target>& targets) {
+    int spare[2];                        // For files other than the last
+    if (pipe2(spare, O_CLOEXEC) == -1) {
+        spare[0] = spare[1] = -1;
+    }
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    std::string buf;
+
+    while (true) {
+        // The last live file takes the chunk off the input pipe at the end
+        Target* sink = nullptr;
+        bool any_alive = false;
+        for (auto& t : targets) {
+            t.done = 0;
+            any_alive = any_alive || t.alive;
+            if (t.alive && t.kind == TARGET_FILE) {
+                sink = &t;
+            }
+        }
+        size_t size = any_alive ? wait_for_input(in) : 0;
+        if (size == 0) {
+            break;
+        }
+
+        bool copy = false;
+        for (auto& t : targets) {
+            if (!t.alive || &t == sink) {
+                continue;
+            }
+            if (t.kind == TARGET_PIPE) {
+                ssize_t n = tee_some(in, t.fd, size);
+                if (n == -1) {
+                    t.alive = false;         // Reader gone (EPIPE)
+                    continue;
+                }
+                t.done = static_cast<size_t>(n);
+            } else if (t.kind == TARGET_FILE && spare[1] != -1) {
+                ssize_t n = tee_some(in, spare[1], size);
+                size_t teed = n > 0 ? static_cast<size_t>(n) : 0;
+                size_t moved = splice_all(spare[0], t.fd, teed);
+                if (moved < teed) {
+                    splice_all(spare[0], null_fd, teed - moved);   // Leave it empty
+                    t.alive = false;
+                    continue;
+                }
+                t.done = teed;
+            }
+            copy = copy || t.done < size;
+        }
+
+        if (!copy) {
+            int out = sink != nullptr ? sink->fd : null_fd;
+            size_t moved = splice_all(in, out, size);
+            if (moved < size) {
+                if (sink == nullptr) {
+                    break;
+                }
+                // The file failed part way: the rest of the chunk is dropped
+                sink->alive = false;
+                if (splice_all(in, null_fd, size - moved) < size - moved) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // Someone was short: take the chunk off the pipe and write the rest
+        buf.resize(size);
+        size_t got = 0;
+        while (got < size) {
+            ssize_t n = read(in, &buf[got], size - got);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += static_cast<size_t>(n);
+        }
+        for (auto& t : targets) {
+            if (t.alive && t.done < got && !write_all(t.fd, buf.data() + t.done, got - t.done)) {
+                t.alive = false;
+            }
+        }
+        if (got < size) {
+            break;
+        }
+    }
+
+    if (spare[0] != -1) {
+        close(spare[0]);
+        close(spare[1]);
+    }
+    if (null_fd != -1) {
+        close(null_fd);
+    }
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+pid_t start_fanout(const std::vector<int>& outputs, int& write_fd) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        shell_perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        shell_perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        // === PUMP PROCESS ===
+        setup_child_signals();
+        signal(SIGPIPE, SIG_IGN);            // A consumer that quits is dropped
+        close(fds[1]);
+        close(STDIN_FILENO);                 // Hold nobody's pipe open
+        close(STDOUT_FILENO);
+
+        std::vector<Target> targets;
+        for (int fd : outputs) {
+            Target t;
+            t.fd = fd;
+            t.kind = classify(fd);
+            targets.push_back(t);
+        }
+        pump(fds[0], targets);
+        _exit(0);
+    }
+
+    close(fds[0]);
+    write_fd = fds[1];
+    return pid;
+}
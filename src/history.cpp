@@ -0,0 +1,369 @@
+#include "history.h"
+#include "env.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Record Encoding
+// ============================================================================
+// One record per line; backslash and newline are escaped so multi-line
+// commands stay a single record.
+
+static std::string encode_entry(const std::string& line) {
+    std::string out;
+    out.reserve(line.size() + 1);
+    for (char c : line) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static std::string decode_entry(const char* data, size_t len) {
+    std::string out;
+    out.reserve(len);
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\\' && i + 1 < len) {
+            i++;
+            out += (data[i] == 'n') ? '\n' : data[i];
+        } else {
+            out += data[i];
+        }
+    }
+    return out;
+}
+
+static uint64_t hash_bytes(const char* data, size_t len) {
+    uint64_t h = 1469598103934665603ULL;       // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint32_t trigram(const char* p) {
+    return (static_cast<unsigned char>(p[0]) << 16) |
+           (static_cast<unsigned char>(p[1]) << 8) |
+            static_cast<unsigned char>(p[2]);
+}
+
+// ============================================================================
+// History Store
+// ============================================================================
+
+class HistoryStore {
+public:
+    ~HistoryStore() {
+        unmap();
+        if (fd_ != -1) close(fd_);
+    }
+
+    void add(const std::string& line) {
+        if (!open_log()) {
+            return;
+        }
+        std::string record = encode_entry(line) + "\n";
+
+        // One locked write per record keeps concurrent appends whole
+        flock(fd_, LOCK_EX);
+        ssize_t n = write(fd_, record.data(), record.size());
+        flock(fd_, LOCK_UN);
+        (void)n;
+
+        sync();
+    }
+
+    void clear() {
+        if (!open_log()) {
+            return;
+        }
+        flock(fd_, LOCK_EX);
+        if (ftruncate(fd_, 0) == -1) {
+            // Nothing sensible to do; keep the in-memory reset below
+        }
+        flock(fd_, LOCK_UN);
+        reset();
+    }
+
+    size_t size() {
+        sync();
+        return live_count_;
+    }
+
+    bool get(size_t n, std::string& out) {
+        sync();
+        for (size_t i = entries_.size(); i-- > 0;) {
+            if (!entries_[i].alive) continue;
+            if (n == 0) {
+                out = text(i);
+                return true;
+            }
+            n--;
+        }
+        return false;
+    }
+
+    std::vector<std::string> list(size_t max) {
+        sync();
+        std::vector<std::string> out;
+        size_t start = entries_.size();
+        for (size_t taken = 0; start > 0 && taken < max; start--) {
+            if (entries_[start - 1].alive) taken++;
+        }
+        for (size_t i = start; i < entries_.size(); i++) {
+            if (entries_[i].alive) out.push_back(text(i));
+        }
+        return out;
+    }
+
+    bool search(const std::string& query, size_t& n, std::string& out) {
+        sync();
+        if (query.empty() || n >= entries_.size()) {
+            return false;
+        }
+        std::string needle = encode_entry(query);
+        long top = static_cast<long>(entries_.size()) - 1 - static_cast<long>(n);
+
+        long found = -1;
+        if (needle.size() < 3) {
+            for (long id = top; id >= 0; id--) {
+                if (entry_contains(id, needle)) {
+                    found = id;
+                    break;
+                }
+            }
+        } else {
+            found = indexed_search(needle, top);
+        }
+
+        if (found < 0) {
+            return false;
+        }
+        n = entries_.size() - 1 - static_cast<size_t>(found);
+        out = text(found);
+        return true;
+    }
+
+private:
+    struct Entry {
+        uint64_t offset;     // Byte offset of the record in the log
+        uint32_t length;     // Encoded length (without newline)
+        bool alive;          // False once a newer duplicate supersedes it
+    };
+
+    int fd_ = -1;
+    bool open_failed_ = false;
+    const char* map_ = nullptr;
+    size_t map_size_ = 0;
+    size_t scanned_ = 0;                 // Offset index: bytes parsed so far
+    std::vector<Entry> entries_;
+    size_t live_count_ = 0;
+    std::unordered_map<uint64_t, uint32_t> by_hash_;
+
+    // Trigram postings (ascending entry ids), built lazily on first search
+    std::unordered_map<uint32_t, std::vector<uint32_t>> grams_;
+    size_t grams_upto_ = 0;
+
+    bool open_log() {
+        if (fd_ != -1) return true;
+        if (open_failed_) return false;
+
+        std::string path = get_env("HISTFILE");
+        if (path.empty()) {
+            std::string home = get_env("HOME");
+            if (home.empty()) {
+                open_failed_ = true;
+                return false;
+            }
+            path = home + "/.myshell_history";
+        }
+
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (fd_ == -1) {
+            open_failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    void unmap() {
+        if (map_ != nullptr) {
+            munmap(const_cast<char*>(map_), map_size_);
+            map_ = nullptr;
+            map_size_ = 0;
+        }
+    }
+
+    void reset() {
+        unmap();
+        scanned_ = 0;
+        entries_.clear();
+        live_count_ = 0;
+        by_hash_.clear();
+        grams_.clear();
+        grams_upto_ = 0;
+    }
+
+    // Pick up records appended since the last call (by any session)
+    void sync() {
+        if (!open_log()) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd_, &st) == -1) {
+            return;
+        }
+        size_t file_size = static_cast<size_t>(st.st_size);
+
+        if (file_size < scanned_) {
+            reset();                     // Truncated by another shell
+        }
+        if (file_size == map_size_) {
+            return;
+        }
+
+        if (file_size == 0) {
+            unmap();                     // Nothing indexed: scanned_ is 0
+            return;
+        }
+        // The old mapping stays until the new one exists: the entries
+        // point into it
+        void* p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            return;
+        }
+        unmap();
+        map_ = static_cast<const char*>(p);
+        map_size_ = file_size;
+
+        // Index complete records only; a torn tail is picked up later
+        while (scanned_ < map_size_) {
+            const void* nl = memchr(map_ + scanned_, '\n', map_size_ - scanned_);
+            if (nl == nullptr) break;
+            size_t end = static_cast<const char*>(nl) - map_;
+            if (end > scanned_) {
+                append_entry(scanned_, end - scanned_);
+            }
+            scanned_ = end + 1;
+        }
+    }
+
+    void append_entry(size_t offset, size_t length) {
+        uint64_t h = hash_bytes(map_ + offset, length);
+        auto it = by_hash_.find(h);
+        if (it != by_hash_.end()) {
+            Entry& old = entries_[it->second];
+            if (old.alive && old.length == length &&
+                memcmp(map_ + old.offset, map_ + offset, length) == 0) {
+                old.alive = false;
+                live_count_--;
+            }
+        }
+        by_hash_[h] = static_cast<uint32_t>(entries_.size());
+        entries_.push_back({offset, static_cast<uint32_t>(length), true});
+        live_count_++;
+    }
+
+    std::string text(size_t id) const {
+        const Entry& e = entries_[id];
+        return decode_entry(map_ + e.offset, e.length);
+    }
+
+    bool entry_contains(size_t id, const std::string& needle) const {
+        const Entry& e = entries_[id];
+        return e.alive &&
+               memmem(map_ + e.offset, e.length, needle.data(), needle.size()) != nullptr;
+    }
+
+    void extend_index() {
+        std::vector<uint32_t> seen;
+        for (; grams_upto_ < entries_.size(); grams_upto_++) {
+            const Entry& e = entries_[grams_upto_];
+            if (e.length < 3) continue;
+            const char* p = map_ + e.offset;
+            seen.clear();
+            for (size_t i = 0; i + 3 <= e.length; i++) {
+                seen.push_back(trigram(p + i));
+            }
+            std::sort(seen.begin(), seen.end());
+            seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+            for (uint32_t g : seen) {
+                grams_[g].push_back(static_cast<uint32_t>(grams_upto_));
+            }
+        }
+    }
+
+    // Walk the rarest trigram's postings backwards, verifying each hit
+    long indexed_search(const std::string& needle, long top) {
+        extend_index();
+
+        const std::vector<uint32_t>* best = nullptr;
+        for (size_t i = 0; i + 3 <= needle.size(); i++) {
+            auto it = grams_.find(trigram(needle.data() + i));
+            if (it == grams_.end()) {
+                return -1;
+            }
+            if (best == nullptr || it->second.size() < best->size()) {
+                best = &it->second;
+            }
+        }
+
+        auto end = std::upper_bound(best->begin(), best->end(),
+                                    static_cast<uint32_t>(top));
+        while (end != best->begin()) {
+            --end;
+            if (entry_contains(*end, needle)) {
+                return *end;
+            }
+        }
+        return -1;
+    }
+};
+
+static HistoryStore g_history;
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+void history_add(const std::string& line) {
+    if (line.find_first_not_of(" \t\n") == std::string::npos) {
+        return;
+    }
+    g_history.add(line);
+}
+
+size_t history_size() {
+    return g_history.size();
+}
+
+bool history_get(size_t n, std::string& out) {
+    return g_history.get(n, out);
+}
+
+std::vector<std::string> history_list(size_t max) {
+    return g_history.list(max);
+}
+
+bool history_search(const std::string& query, size_t& n, std::string& out) {
+    return g_history.search(query, n, out);
+}
+
+void history_clear() {
+    g_history.clear();
+}
@@ -0,0 +1,198 @@
+#include "input.h"
+#include "signals.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+struct InputBuffer {
+    int owners = 0;
+    std::string data;                    // Bytes read but not yet consumed
+    size_t pos = 0;                      // from data[pos]
+};
+
+static const size_t CHUNK_SIZE = 65536;
+
+static std::unordered_map<int, InputBuffer> g_inputs;
+
+// ============================================================================
+// Low-Level Reads
+// ============================================================================
+
+static long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Wait until `fd` is readable or `deadline` (now_ms() time, < 0 for none)
+// passes
+static InputStatus wait_input(int fd, long long deadline) {
+    if (deadline < 0) {
+        return INPUT_OK;
+    }
+    while (true) {
+        long long left = deadline - now_ms();
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, left > 0 ? static_cast<int>(left) : 0);
+        if (ready > 0) {
+            return INPUT_OK;
+        }
+        if (ready == 0) {
+            return INPUT_TIMEOUT;
+        }
+        if (errno != EINTR || g_interrupted) {
+            return INPUT_ERROR;
+        }
+    }
+}
+
+// read(2), retried after a signal unless it was Ctrl+C
+static ssize_t read_some(int fd, char* buf, size_t size) {
+    while (true) {
+        ssize_t n = read(fd, buf, size);
+        if (n >= 0 || errno != EINTR || g_interrupted) {
+            return n;
+        }
+    }
+}
+
+static bool is_seekable(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Take bytes from [start, start + size) up to the delimiter or the limit.
+// Returns how many bytes were consumed; `done` is set if the record ended.
+static size_t take(const char* start, size_t size, char delim, size_t& limit,
+                   std::string& out, bool& done) {
+    size_t want = size < limit ? size : limit;
+    const char* hit = static_cast<const char*>(memchr(start, delim, want));
+    if (hit != nullptr) {
+        out.append(start, hit - start);
+        done = true;
+        return hit - start + 1;
+    }
+    out.append(start, want);
+    limit -= want;
+    done = limit == 0;
+    return want;
+}
+
+// ============================================================================
+// Read Strategies
+// ============================================================================
+
+// Owned descriptor: serve from the shared buffer, refilling it in chunks
+static InputStatus read_owned(InputBuffer& buf, int fd, char delim, size_t limit,
+                              long long deadline, std::string& out) {
+    while (true) {
+        if (buf.pos < buf.data.size()) {
+            bool done;
+            buf.pos += take(buf.data.data() + buf.pos, buf.data.size() - buf.pos,
+                            delim, limit, out, done);
+            if (done) {
+                return INPUT_OK;
+            }
+        }
+
+        InputStatus status = wait_input(fd, deadline);
+        if (status != INPUT_OK) {
+            return status;
+        }
+        buf.data.resize(CHUNK_SIZE);
+        buf.pos = 0;
+        ssize_t n = read_some(fd, &buf.data[0], CHUNK_SIZE);
+        buf.data.resize(n > 0 ? static_cast<size_t>(n) : 0);
+        if (n <= 0) {
+            return n == 0 ? INPUT_EOF : INPUT_ERROR;
+        }
+    }
+}
+
+// Regular file: read ahead, then seek back to just after the record
+static InputStatus read_seekable(int fd, char delim, size_t limit, std::string& out) {
+    static std::string chunk(CHUNK_SIZE, '\0');
+    while (true) {
+        ssize_t n = read_some(fd, &chunk[0], chunk.size());
+        if (n <= 0) {
+            return n == 0 ? INPUT_EOF : INPUT_ERROR;
+        }
+        bool done;
+        size_t used = take(chunk.data(), static_cast<size_t>(n), delim, limit, out, done);
+        if (done) {
+            if (used < static_cast<size_t>(n)) {
+                lseek(fd, -static_cast<off_t>(n - used), SEEK_CUR);
+            }
+            return INPUT_OK;
+        }
+    }
+}
+
+// Pipe or terminal shared with other readers: never read past the record
+static InputStatus read_bytes(int fd, char delim, size_t limit, long long deadline,
+                              std::string& out) {
+    while (limit > 0) {
+        InputStatus status = wait_input(fd, deadline);
+        if (status != INPUT_OK) {
+            return status;
+        }
+        char c;
+        ssize_t n = read_some(fd, &c, 1);
+        if (n <= 0) {
+            return n == 0 ? INPUT_EOF : INPUT_ERROR;
+        }
+        if (c == delim) {
+            break;
+        }
+        out += c;
+        limit--;
+    }
+    return INPUT_OK;
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+InputStatus input_read(int fd, char delim, size_t limit, int timeout_ms, std::string& out) {
+    long long deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : -1;
+
+    auto it = g_inputs.find(fd);
+    if (it != g_inputs.end()) {
+        return read_owned(it->second, fd, delim, limit, deadline, out);
+    }
+    if (is_seekable(fd)) {
+        return read_seekable(fd, delim, limit, out);
+    }
+    return read_bytes(fd, delim, limit, deadline, out);
+}
+
+bool input_ready(int fd) {
+    auto it = g_inputs.find(fd);
+    if (it != g_inputs.end() && it->second.pos < it->second.data.size()) {
+        return true;
+    }
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+void input_own(int fd) {
+    g_inputs[fd].owners++;
+}
+
+void input_release(int fd) {
+    auto it = g_inputs.find(fd);
+    if (it == g_inputs.end() || --it->second.owners > 0) {
+        return;
+    }
+    InputBuffer& buf = it->second;
+    if (buf.pos < buf.data.size() && is_seekable(fd)) {
+        lseek(fd, -static_cast<off_t>(buf.data.size() - buf.pos), SEEK_CUR);
+    }
+    g_inputs.erase(it);
+}
@@ -0,0 +1,702 @@
+#include "lineedit.h"
+
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// ============================================================================
+// Hooks
+// ============================================================================
+
+static HistoryLookup g_history_lookup;
+static HistorySearch g_history_search;
+static CompletionFunc g_complete;
+
+// Bytes read past the end of an accepted line (typed ahead)
+static std::string g_typeahead;
+
+void lineedit_set_history(HistoryLookup lookup, HistorySearch search) {
+    g_history_lookup = lookup;
+    g_history_search = search;
+}
+
+void lineedit_set_completion(CompletionFunc complete) {
+    g_complete = complete;
+}
+
+bool lineedit_available() {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
+        return false;
+    }
+    const char* term = getenv("TERM");
+    return term == nullptr || strcmp(term, "dumb") != 0;
+}
+
+// ============================================================================
+// Keymap
+// ============================================================================
+
+enum EditAction {
+    ACT_NONE,
+    ACT_INSERT,
+    ACT_ACCEPT,
+    ACT_BACKSPACE,
+    ACT_DELETE,
+    ACT_EOF_OR_DELETE,
+    ACT_LEFT,
+    ACT_RIGHT,
+    ACT_HOME,
+    ACT_END,
+    ACT_WORD_LEFT,
+    ACT_WORD_RIGHT,
+    ACT_KILL_END,
+    ACT_KILL_START,
+    ACT_KILL_WORD,
+    ACT_YANK,
+    ACT_TRANSPOSE,
+    ACT_CLEAR_SCREEN,
+    ACT_INTERRUPT,
+    ACT_HISTORY_PREV,
+    ACT_HISTORY_NEXT,
+    ACT_SEARCH,
+    ACT_COMPLETE,
+    ACT_PASTE_BEGIN
+};
+
+static EditAction key_action(unsigned char c) {
+    switch (c) {
+        case 0x01: return ACT_HOME;           // Ctrl+A
+        case 0x02: return ACT_LEFT;           // Ctrl+B
+        case 0x03: return ACT_INTERRUPT;      // Ctrl+C
+        case 0x04: return ACT_EOF_OR_DELETE;  // Ctrl+D
+        case 0x05: return ACT_END;            // Ctrl+E
+        case 0x06: return ACT_RIGHT;          // Ctrl+F
+        case 0x08: return ACT_BACKSPACE;      // Ctrl+H
+        case 0x09: return ACT_COMPLETE;       // Tab
+        case 0x0a: return ACT_ACCEPT;         // Ctrl+J
+        case 0x0b: return ACT_KILL_END;       // Ctrl+K
+        case 0x0c: return ACT_CLEAR_SCREEN;   // Ctrl+L
+        case 0x0d: return ACT_ACCEPT;         // Enter
+        case 0x0e: return ACT_HISTORY_NEXT;   // Ctrl+N
+        case 0x10: return ACT_HISTORY_PREV;   // Ctrl+P
+        case 0x12: return ACT_SEARCH;         // Ctrl+R
+        case 0x14: return ACT_TRANSPOSE;      // Ctrl+T
+        case 0x15: return ACT_KILL_START;     // Ctrl+U
+        case 0x17: return ACT_KILL_WORD;      // Ctrl+W
+        case 0x19: return ACT_YANK;           // Ctrl+Y
+        case 0x7f: return ACT_BACKSPACE;      // Backspace
+        default:
+            return c >= 0x20 ? ACT_INSERT : ACT_NONE;
+    }
+}
+
+struct EscapeBinding {
+    const char* seq;
+    EditAction action;
+};
+
+static const EscapeBinding g_escape_keys[] = {
+    {"\x1b[A", ACT_HISTORY_PREV},  {"\x1bOA", ACT_HISTORY_PREV},
+    {"\x1b[B", ACT_HISTORY_NEXT},  {"\x1bOB", ACT_HISTORY_NEXT},
+    {"\x1b[C", ACT_RIGHT},         {"\x1bOC", ACT_RIGHT},
+    {"\x1b[D", ACT_LEFT},          {"\x1bOD", ACT_LEFT},
+    {"\x1b[H", ACT_HOME},          {"\x1bOH", ACT_HOME},
+    {"\x1b[F", ACT_END},           {"\x1bOF", ACT_END},
+    {"\x1b[1~", ACT_HOME},         {"\x1b[7~", ACT_HOME},
+    {"\x1b[4~", ACT_END},          {"\x1b[8~", ACT_END},
+    {"\x1b[3~", ACT_DELETE},
+    {"\x1b[1;5C", ACT_WORD_RIGHT}, {"\x1b[1;5D", ACT_WORD_LEFT},
+    {"\x1b" "f", ACT_WORD_RIGHT},  {"\x1b" "b", ACT_WORD_LEFT},
+    {"\x1b\x7f", ACT_KILL_WORD},
+    {"\x1b[200~", ACT_PASTE_BEGIN},
+};
+
+static const char PASTE_END[] = "\x1b[201~";
+
+// ============================================================================
+// Raw Mode Editor
+// ============================================================================
+
+class LineEditor {
+public:
+    LineEditor(const std::string& prompt) : prompt_(prompt) {}
+
+    std::string run(bool& eof) {
+        eof = false;
+
+        struct termios orig;
+        if (tcgetattr(STDIN_FILENO, &orig) == -1) {
+            eof = true;
+            return "";
+        }
+        struct termios raw = orig;
+        raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+        raw.c_oflag &= ~(OPOST);
+        raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+        // Enable bracketed paste and draw the prompt in one write
+        pending_out_ = "\x1b[?2004h";
+        refresh();
+
+        std::string input;
+        input.swap(g_typeahead);
+        char buf[4096];
+
+        while (!done_) {
+            if (input.empty()) {
+                ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+                if (n < 0 && errno == EINTR) {
+                    refresh();           // e.g. terminal resized
+                    continue;
+                }
+                if (n <= 0) {
+                    eof_ = true;
+                    break;
+                }
+                input.assign(buf, n);
+            }
+
+            // Consume everything available before redrawing once
+            size_t i = 0;
+            while (i < input.size() && !done_) {
+                feed(static_cast<unsigned char>(input[i++]));
+            }
+            if (done_) {
+                g_typeahead = input.substr(i);
+            }
+            input.clear();
+
+            if (!done_) {
+                refresh();
+            }
+        }
+
+        if (!eof_) {
+            // Leave the cursor on a fresh line below the input
+            if (!interrupted_) {
+                search_active_ = false;
+                cursor_ = buffer_.size();
+                refresh(false);
+            }
+            pending_out_ += "\r\n";
+        }
+        pending_out_ += "\x1b[?2004l";
+        flush_output();
+
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig);
+
+        eof = eof_;
+        return eof_ ? "" : buffer_;
+    }
+
+private:
+    std::string prompt_;
+    std::string buffer_;
+    size_t cursor_ = 0;
+    bool done_ = false;
+    bool eof_ = false;
+    bool interrupted_ = false;
+
+    // Terminal model for differential redraw
+    std::string shown_;          // Rendered bytes currently on screen
+    size_t cursor_cell_ = 0;     // Cell the terminal cursor sits on
+    size_t cols_ = 0;
+    std::string pending_out_;    // Output batched into one write()
+
+    // Escape sequence and bracketed paste state
+    std::string escape_;
+    bool pasting_ = false;
+    std::string paste_;
+
+    // History and search state
+    long history_index_ = -1;
+    std::string saved_line_;
+    bool search_active_ = false;
+    std::string search_query_;
+    size_t search_pos_ = 0;
+    size_t search_match_ = 0;
+
+    std::string kill_buffer_;
+    EditAction last_action_ = ACT_NONE;
+    bool completion_ambiguous_ = false;  // Last Tab could not extend the word
+
+    // ------------------------------------------------------------------------
+    // Input dispatch
+    // ------------------------------------------------------------------------
+
+    void feed(unsigned char c) {
+        if (pasting_) {
+            paste_ += static_cast<char>(c);
+            size_t end_len = sizeof(PASTE_END) - 1;
+            if (paste_.size() >= end_len &&
+                paste_.compare(paste_.size() - end_len, end_len, PASTE_END) == 0) {
+                paste_.resize(paste_.size() - end_len);
+                std::replace(paste_.begin(), paste_.end(), '\r', '\n');
+                insert_text(paste_);
+                paste_.clear();
+                pasting_ = false;
+            }
+            return;
+        }
+
+        if (!escape_.empty() || c == 0x1b) {
+            escape_ += static_cast<char>(c);
+            resolve_escape();
+            return;
+        }
+
+        if (search_active_ && handle_search_key(c)) {
+            return;
+        }
+
+        dispatch(key_action(c), c);
+    }
+
+    void resolve_escape() {
+        bool prefix = false;
+        for (const auto& binding : g_escape_keys) {
+            if (escape_ == binding.seq) {
+                escape_.clear();
+                if (search_active_) {
+                    accept_search();
+                }
+                dispatch(binding.action, 0);
+                return;
+            }
+            if (strncmp(binding.seq, escape_.c_str(), escape_.size()) == 0) {
+                prefix = true;
+            }
+        }
+        if (prefix) {
+            return;
+        }
+        // Unknown CSI sequence: swallow bytes until its final character
+        if (escape_.size() >= 2 && escape_[1] == '[') {
+            unsigned char last = escape_.back();
+            if (escape_.size() == 2 || (last >= 0x20 && last <= 0x3f)) {
+                return;
+            }
+        }
+        escape_.clear();
+    }
+
+    void dispatch(EditAction action, unsigned char c) {
+        EditAction previous = last_action_;
+        last_action_ = action;
+
+        switch (action) {
+            case ACT_INSERT:
+                insert_text(std::string(1, static_cast<char>(c)));
+                break;
+            case ACT_ACCEPT:
+                done_ = true;
+                break;
+            case ACT_INTERRUPT:
+                cursor_ = buffer_.size();
+                refresh(false);
+                pending_out_ += "^C";
+                buffer_.clear();
+                interrupted_ = true;
+                done_ = true;
+                break;
+            case ACT_EOF_OR_DELETE:
+                if (buffer_.empty()) {
+                    eof_ = true;
+                    done_ = true;
+                } else {
+                    delete_forward();
+                }
+                break;
+            case ACT_BACKSPACE:
+                if (cursor_ > 0) {
+                    size_t start = prev_char(cursor_);
+                    buffer_.erase(start, cursor_ - start);
+                    cursor_ = start;
+                }
+                break;
+            case ACT_DELETE:
+                delete_forward();
+                break;
+            case ACT_LEFT:
+                cursor_ = prev_char(cursor_);
+                break;
+            case ACT_RIGHT:
+                cursor_ = next_char(cursor_);
+                break;
+            case ACT_HOME:
+                cursor_ = 0;
+                break;
+            case ACT_END:
+                cursor_ = buffer_.size();
+                break;
+            case ACT_WORD_LEFT:
+                cursor_ = word_left(cursor_);
+                break;
+            case ACT_WORD_RIGHT:
+                while (cursor_ < buffer_.size() && buffer_[cursor_] == ' ') cursor_++;
+                while (cursor_ < buffer_.size() && buffer_[cursor_] != ' ') cursor_++;
+                break;
+            case ACT_KILL_END:
+                kill_buffer_ = buffer_.substr(cursor_);
+                buffer_.erase(cursor_);
+                break;
+            case ACT_KILL_START:
+                kill_buffer_ = buffer_.substr(0, cursor_);
+                buffer_.erase(0, cursor_);
+                cursor_ = 0;
+                break;
+            case ACT_KILL_WORD: {
+                size_t start = word_left(cursor_);
+                kill_buffer_ = buffer_.substr(start, cursor_ - start);
+                buffer_.erase(start, cursor_ - start);
+                cursor_ = start;
+                break;
+            }
+            case ACT_YANK:
+                insert_text(kill_buffer_);
+                break;
+            case ACT_TRANSPOSE:
+                if (cursor_ > 0 && buffer_.size() >= 2) {
+                    if (cursor_ == buffer_.size()) cursor_--;
+                    std::swap(buffer_[cursor_ - 1], buffer_[cursor_]);
+                    cursor_++;
+                }
+                break;
+            case ACT_CLEAR_SCREEN:
+                pending_out_ += "\x1b[H\x1b[2J";
+                shown_.clear();
+                cursor_cell_ = 0;
+                break;
+            case ACT_HISTORY_PREV:
+                recall_history(history_index_ + 1);
+                break;
+            case ACT_HISTORY_NEXT:
+                recall_history(history_index_ - 1);
+                break;
+            case ACT_SEARCH:
+                if (g_history_search) {
+                    search_active_ = true;
+                    search_query_.clear();
+                    search_pos_ = 0;
+                    saved_line_ = buffer_;
+                }
+                break;
+            case ACT_COMPLETE:
+                complete(previous == ACT_COMPLETE && completion_ambiguous_);
+                break;
+            case ACT_PASTE_BEGIN:
+                pasting_ = true;
+                paste_.clear();
+                break;
+            case ACT_NONE:
+                break;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Editing primitives
+    // ------------------------------------------------------------------------
+
+    void insert_text(const std::string& text) {
+        buffer_.insert(cursor_, text);
+        cursor_ += text.size();
+    }
+
+    void delete_forward() {
+        if (cursor_ < buffer_.size()) {
+            buffer_.erase(cursor_, next_char(cursor_) - cursor_);
+        }
+    }
+
+    // UTF-8 aware cursor steps (skip continuation bytes)
+    size_t prev_char(size_t pos) const {
+        if (pos == 0) return 0;
+        pos--;
+        while (pos > 0 && (static_cast<unsigned char>(buffer_[pos]) & 0xC0) == 0x80) pos--;
+        return pos;
+    }
+
+    size_t next_char(size_t pos) const {
+        if (pos >= buffer_.size()) return buffer_.size();
+        pos++;
+        while (pos < buffer_.size() &&
+               (static_cast<unsigned char>(buffer_[pos]) & 0xC0) == 0x80) pos++;
+        return pos;
+    }
+
+    size_t word_left(size_t pos) const {
+        while (pos > 0 && buffer_[pos - 1] == ' ') pos--;
+        while (pos > 0 && buffer_[pos - 1] != ' ') pos--;
+        return pos;
+    }
+
+    // ------------------------------------------------------------------------
+    // History recall and reverse-incremental search
+    // ------------------------------------------------------------------------
+
+    void recall_history(long index) {
+        if (!g_history_lookup || index < -1) {
+            return;
+        }
+        if (index == -1) {
+            buffer_ = saved_line_;
+        } else {
+            std::string entry;
+            if (!g_history_lookup(static_cast<size_t>(index), entry)) {
+                return;
+            }
+            if (history_index_ == -1) {
+                saved_line_ = buffer_;
+            }
+            buffer_ = entry;
+        }
+        history_index_ = index;
+        cursor_ = buffer_.size();
+    }
+
+    // Returns true when the key was consumed by the search prompt
+    bool handle_search_key(unsigned char c) {
+        if (c == 0x12) {                      // Ctrl+R: next older match
+            run_search(search_pos_ + 1);
+            return true;
+        }
+        if (c == 0x07 || c == 0x03) {         // Ctrl+G / Ctrl+C: abort
+            search_active_ = false;
+            buffer_ = saved_line_;
+            cursor_ = buffer_.size();
+            return true;
+        }
+        if (c == 0x7f || c == 0x08) {
+            if (!search_query_.empty()) {
+                search_query_.pop_back();
+                run_search(0);
+            }
+            return true;
+        }
+        if (c >= 0x20) {
+            search_query_ += static_cast<char>(c);
+            run_search(search_pos_);
+            return true;
+        }
+        accept_search();
+        return false;
+    }
+
+    void run_search(size_t from) {
+        if (search_query_.empty()) {
+            return;
+        }
+        size_t pos = from;
+        std::string match;
+        if (g_history_search(search_query_, pos, match)) {
+            search_pos_ = pos;
+            buffer_ = match;
+            search_match_ = buffer_.find(search_query_);
+            cursor_ = search_match_ == std::string::npos ? 0 : search_match_;
+        }
+    }
+
+    void accept_search() {
+        search_active_ = false;
+        history_index_ = -1;
+    }
+
+    // ------------------------------------------------------------------------
+    // Completion
+    // ------------------------------------------------------------------------
+
+    void complete(bool list) {
+        completion_ambiguous_ = false;
+        if (!g_complete) {
+            return;
+        }
+        size_t start = cursor_;
+        std::vector<std::string> candidates = g_complete(buffer_, cursor_, start);
+        if (candidates.empty() || start > cursor_) {
+            pending_out_ += "\a";
+            return;
+        }
+
+        std::string common = candidates[0];
+        for (const auto& cand : candidates) {
+            size_t k = 0;
+            while (k < common.size() && k < cand.size() && common[k] == cand[k]) k++;
+            common.resize(k);
+        }
+
+        if (candidates.size() == 1 && !common.empty() && common.back() != '/') {
+            common += ' ';
+        }
+
+        std::string word = buffer_.substr(start, cursor_ - start);
+        if (common.size() > word.size()) {
+            buffer_.replace(start, cursor_ - start, common);
+            cursor_ = start + common.size();
+            return;
+        }
+
+        if (!list) {
+            completion_ambiguous_ = true;
+            pending_out_ += "\a";
+            return;
+        }
+
+        // Second Tab: list all candidates below the line, then redraw
+        size_t old_cursor = cursor_;
+        cursor_ = buffer_.size();
+        refresh(false);
+        cursor_ = old_cursor;
+
+        size_t width = 0;
+        for (const auto& cand : candidates) width = std::max(width, cand.size());
+        width += 2;
+        size_t per_row = std::max<size_t>(1, terminal_cols() / width);
+
+        pending_out_ += "\r\n";
+        for (size_t i = 0; i < candidates.size(); i++) {
+            pending_out_ += candidates[i];
+            if ((i + 1) % per_row == 0 || i + 1 == candidates.size()) {
+                pending_out_ += "\r\n";
+            } else {
+                pending_out_.append(width - candidates[i].size(), ' ');
+            }
+        }
+        shown_.clear();
+        cursor_cell_ = 0;
+    }
+
+    // ------------------------------------------------------------------------
+    // Rendering
+    // ------------------------------------------------------------------------
+
+    size_t terminal_cols() const {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+            return ws.ws_col;
+        }
+        return 80;
+    }
+
+    // Render raw bytes as printable text; control characters become ^X
+    static void render(const std::string& text, size_t mark, std::string& out,
+                       size_t& cells, size_t& mark_cell) {
+        for (size_t i = 0; i < text.size(); i++) {
+            if (i == mark) mark_cell = cells;
+            unsigned char c = text[i];
+            if (c < 0x20 || c == 0x7f) {
+                out += '^';
+                out += static_cast<char>(c ^ 0x40);
+                cells += 2;
+            } else {
+                out += static_cast<char>(c);
+                if ((c & 0xC0) != 0x80) cells++;
+            }
+        }
+        if (mark >= text.size()) mark_cell = cells;
+    }
+
+    static size_t count_cells(const std::string& rendered, size_t len) {
+        size_t cells = 0;
+        for (size_t i = 0; i < len; i++) {
+            if ((static_cast<unsigned char>(rendered[i]) & 0xC0) != 0x80) cells++;
+        }
+        return cells;
+    }
+
+    void move_cursor(size_t from, size_t to) {
+        size_t from_row = from / cols_, from_col = from % cols_;
+        size_t to_row = to / cols_, to_col = to % cols_;
+
+        if (to_row < from_row) {
+            pending_out_ += "\x1b[" + std::to_string(from_row - to_row) + "A";
+        } else if (to_row > from_row) {
+            pending_out_ += "\x1b[" + std::to_string(to_row - from_row) + "B";
+        }
+        if (to_col < from_col) {
+            pending_out_ += "\x1b[" + std::to_string(from_col - to_col) + "D";
+        } else if (to_col > from_col) {
+            pending_out_ += "\x1b[" + std::to_string(to_col - from_col) + "C";
+        }
+    }
+
+    // Redraw only what changed since the last frame, then write once
+    void refresh(bool flush = true) {
+        size_t cols = terminal_cols();
+        if (cols != cols_) {
+            if (cols_ != 0) {
+                move_cursor(cursor_cell_, 0);
+                pending_out_ += "\r\x1b[J";
+            }
+            cols_ = cols;
+            shown_.clear();
+            cursor_cell_ = 0;
+        }
+
+        std::string frame;
+        size_t cells = 0, target = 0, unused = 0;
+        if (search_active_) {
+            render("(reverse-i-search)`" + search_query_ + "': ", std::string::npos,
+                   frame, cells, unused);
+        } else {
+            render(prompt_, std::string::npos, frame, cells, unused);
+        }
+        render(buffer_, cursor_, frame, cells, target);
+
+        // First differing byte, backed up to a character boundary
+        size_t diff = 0;
+        size_t common = std::min(frame.size(), shown_.size());
+        while (diff < common && frame[diff] == shown_[diff]) diff++;
+        while (diff > 0 && diff < frame.size() &&
+               (static_cast<unsigned char>(frame[diff]) & 0xC0) == 0x80) diff--;
+
+        if (diff < frame.size() || diff < shown_.size()) {
+            move_cursor(cursor_cell_, count_cells(frame, diff));
+            pending_out_.append(frame, diff, std::string::npos);
+            if (diff < frame.size() && cells > 0 && cells % cols_ == 0) {
+                pending_out_ += "\r\n";   // Leave the pending-wrap column
+            }
+            if (count_cells(shown_, shown_.size()) > cells) {
+                pending_out_ += "\x1b[J";   // Old frame was longer
+            }
+            cursor_cell_ = cells;
+            shown_ = frame;
+        }
+
+        move_cursor(cursor_cell_, target);
+        cursor_cell_ = target;
+
+        if (flush) {
+            flush_output();
+        }
+    }
+
+    void flush_output() {
+        size_t off = 0;
+        while (off < pending_out_.size()) {
+            ssize_t n = write(STDOUT_FILENO, pending_out_.data() + off,
+                              pending_out_.size() - off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            off += n;
+        }
+        pending_out_.clear();
+    }
+};
+
+// ============================================================================
+// Public Entry Point
+// ============================================================================
+
+std::string lineedit_read(const std::string& prompt, bool& eof) {
+    LineEditor editor(prompt);
+    return editor.run(eof);
+}
@@ -1,48 +1,23 @@
 #include "shell.h"
-#include <cstring>   // for strerror
-#include <cerrno>    // for errno
+#include "context.h"
 #include "parser.h"
 #include "executor.h"
 #include "builtins.h"
 #include "signals.h"
 #include "env.h"
+#include "lineedit.h"
+#include "history.h"
+#include "completion.h"
+#include "syntax.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "server.h"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <cstdlib>
 
-// ============================================================================
-// Global Variables
-// ============================================================================
-int g_last_exit_status = 0;
-bool g_running = true;
-
-// ============================================================================
-// Error Handling Implementation
-// ============================================================================
-const char* shell_strerror(ShellError code) {
-    switch (code) {
-        case SHELL_OK:              return "Success";
-        case ERR_CMD_NOT_FOUND:     return "Command not found";
-        case ERR_PERMISSION_DENIED: return "Permission denied";
-        case ERR_FILE_NOT_FOUND:    return "No such file or directory";
-        case ERR_SYNTAX_ERROR:      return "Syntax error";
-        case ERR_FORK_FAILED:       return "Fork failed";
-        case ERR_EXEC_FAILED:       return "Execution failed";
-        case ERR_PIPE_FAILED:       return "Pipe creation failed";
-        case ERR_REDIRECT_FAILED:   return "Redirection failed";
-        case ERR_INVALID_ARGS:      return "Invalid arguments";
-        default:                    return "Unknown error";
-    }
-}
-
-void shell_error(ShellError code, const std::string& context) {
-    std::cerr << "myshell: " << context << ": " << shell_strerror(code) << std::endl;
-}
-
-void shell_perror(const std::string& prefix) {
-    std::cerr << "myshell: " << prefix << ": " << strerror(errno) << std::endl;
-}
-
 // ============================================================================
 // Shell Initialization and Cleanup
 // ============================================================================
@@ -58,22 +33,35 @@ void shell_init() {
 }
 
 void shell_cleanup() {
-    // Any cleanup needed
+    // Let a background completion scan finish before exit
+    completion_shutdown();
 }
 
 // ============================================================================
 // Read Input Line
 // ============================================================================
-std::string read_line() {
+std::string read_line(const std::string& prompt) {
     std::string line;
     
+    // Interactive terminal - use the raw-mode line editor
+    if (lineedit_available()) {
+        bool eof = false;
+        line = lineedit_read(prompt, eof);
+        if (eof) {
+            g_context->running = false;
+            std::cout << std::endl;
+            return "";
+        }
+        return line;
+    }
+    
     // Print prompt
-    std::cout << "myshell> " << std::flush;
+    std::cout << prompt << std::flush;
     
     // Read line
     if (!std::getline(std::cin, line)) {
         // EOF (Ctrl+D)
-        g_running = false;
+        g_context->running = false;
         std::cout << std::endl;
         return "";
     }
@@ -81,37 +69,37 @@ std::string read_line() {
     return line;
 }
 
-// ============================================================================
-// Execute a Line
-// ============================================================================
-void execute_line(const std::string& line) {
-    // Skip empty lines and comments
-    if (line.empty() || line[0] == '#') {
-        return;
-    }
-    
-    // Parse the line into a pipeline
-    Pipeline pipeline = parse(line);
-    
-    if (pipeline.empty()) {
-        return;
-    }
-    
-    // Execute the pipeline
-    g_last_exit_status = execute_pipeline(pipeline);
-}
-
 // ============================================================================
 // Main Shell Loop
 // ============================================================================
 void shell_loop() {
-    while (g_running) {
+    // Record history and enable recall only for terminal sessions
+    bool interactive = lineedit_available();
+    if (interactive) {
+        lineedit_set_history(history_get, history_search);
+        lineedit_set_completion(complete_line);
+        completion_init();
+    }
+    
+    while (g_context->running) {
         std::string line = read_line();
         
-        if (!g_running) {
+        // Keep reading while an if/loop/quote is still open
+        while (g_context->running && script_incomplete(line)) {
+            std::string more = read_line("> ");
+            if (!g_context->running) {
+                break;
+            }
+            line += "\n" + more;
+        }
+        
+        if (!g_context->running) {
             break;
         }
         
+        if (interactive) {
+            history_add(line);
+        }
         execute_line(line);
     }
 }
@@ -120,9 +108,31 @@ void shell_loop() {
 // Main Entry Point
 // ============================================================================
 int main(int argc, char* argv[]) {
+    // Client mode: a server initialized once runs the command
+    if (argc >= 4 && std::string(argv[1]) == "--client") {
+        std::string command;
+        for (int i = 3; i < argc; i++) {
+            if (i > 3) command += " ";
+            command += argv[i];
+        }
+        return run_client(argv[2], command);
+    }
+    
     // Initialize shell
     shell_init();
     
+    // Server mode: myshell --server SOCKET [WORKERS]
+    if (argc >= 3 && std::string(argv[1]) == "--server") {
+        int workers = argc >= 4 ? std::atoi(argv[3]) : 4;
+        if (argc > 4 || workers < 1 || workers > 256) {
+            std::cerr << "myshell: usage: myshell --server SOCKET [WORKERS (1-256)]" << std::endl;
+            return ERR_INVALID_ARGS;
+        }
+        int status = run_server(argv[2], workers);
+        shell_cleanup();
+        return status;
+    }
+    
     // Check for -c option (execute command and exit)
     if (argc >= 3 && std::string(argv[1]) == "-c") {
         std::string command;
@@ -132,7 +142,24 @@ int main(int argc, char* argv[]) {
         }
         execute_line(command);
         shell_cleanup();
-        return g_last_exit_status;
+        return g_context->last_exit_status;
+    }
+    
+    // Script mode: myshell FILE [ARGS...]
+    if (argc >= 2 && argv[1][0] != '-') {
+        std::ifstream file(argv[1]);
+        if (!file) {
+            shell_perror(argv[1]);
+            shell_cleanup();
+            return ERR_FILE_NOT_FOUND;
+        }
+        std::stringstream script;
+        script << file.rdbuf();
+        
+        set_positional_params(std::vector<std::string>(argv + 1, argv + argc));
+        execute_script(script.str());
+        shell_cleanup();
+        return g_context->last_exit_status;
     }
     
     // Interactive mode
@@ -141,5 +168,5 @@ int main(int argc, char* argv[]) {
     shell_loop();
     
     shell_cleanup();
-    return g_last_exit_status;
+    return g_context->last_exit_status;
 }
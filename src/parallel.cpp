@@ -0,0 +1,318 @@
+#include "parallel.h"
+#include "executor.h"
+#include "shell.h"
+#include "signals.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+static const int MAX_FAILED_STATUS = 101;
+static const size_t HELD_PER_JOB = 1 << 20;   // -k: output held back, per job slot
+
+struct Job {
+    std::vector<std::string> args;
+    pid_t pid = -1;
+    int out = -1;                        // Reads its standard output
+    int err = -1;                        // Reads its standard error
+    std::string output;
+    std::string errors;
+    int status = SHELL_OK;
+    bool done = false;
+};
+
+// ============================================================================
+// Command Lines
+// ============================================================================
+
+static std::string without_extension(const std::string& input) {
+    size_t slash = input.rfind('/');
+    size_t dot = input.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash) ||
+        dot == (slash == std::string::npos ? 0 : slash + 1)) {
+        return input;
+    }
+    return input.substr(0, dot);
+}
+
+static std::string basename_of(const std::string& input) {
+    size_t slash = input.rfind('/');
+    return slash == std::string::npos ? input : input.substr(slash + 1);
+}
+
+// Replace {}, {.} and {/} in every word; append the input if none had any
+static std::vector<std::string> job_args(const std::vector<std::string>& command,
+                                         const std::string& input) {
+    std::vector<std::string> args;
+    bool used = false;
+    for (const auto& word : command) {
+        std::string arg;
+        size_t pos = 0;
+        while (pos < word.size()) {
+            if (word.compare(pos, 2, "{}") == 0) {
+                arg += input;
+                pos += 2;
+            } else if (word.compare(pos, 3, "{.}") == 0) {
+                arg += without_extension(input);
+                pos += 3;
+            } else if (word.compare(pos, 3, "{/}") == 0) {
+                arg += basename_of(input);
+                pos += 3;
+            } else {
+                arg += word[pos++];
+                continue;
+            }
+            used = true;
+        }
+        args.push_back(std::move(arg));
+    }
+    if (!used) {
+        args.push_back(input);
+    }
+    return args;
+}
+
+static std::string command_line(const std::vector<std::string>& args) {
+    std::string line;
+    for (const auto& arg : args) {
+        if (!line.empty()) line += ' ';
+        line += arg;
+    }
+    return line;
+}
+
+static void close_fd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// ============================================================================
+// Job Control
+// ============================================================================
+
+class JobRunner {
+public:
+    JobRunner(std::vector<Job>& jobs, unsigned limit, bool keep_order)
+        : jobs_(jobs), limit_(limit), keep_order_(keep_order) {}
+
+    int run() {
+        while (written_ < jobs_.size()) {
+            while (running_ < limit_ && next_ < jobs_.size() && !g_interrupted && !held_full()) {
+                start(jobs_[next_++]);
+            }
+            write_finished();
+            if (running_ == 0 && (g_interrupted || written_ == jobs_.size())) {
+                break;
+            }
+            wait_for_output();
+        }
+        return summary();
+    }
+
+private:
+    std::vector<Job>& jobs_;
+    unsigned limit_;
+    bool keep_order_;
+    size_t next_ = 0;                    // Next job to start
+    size_t written_ = 0;                 // Jobs whose output is out
+    unsigned running_ = 0;
+    std::vector<size_t> finished_;       // Unordered: done, not yet written
+
+    // -k: output of jobs behind the oldest unwritten one has filled the
+    // space for it. Until that job finishes no new job starts and the
+    // others are not read, so they block on their output pipes.
+    bool held_full() const {
+        if (!keep_order_) {
+            return false;
+        }
+        size_t held = 0;
+        for (size_t i = written_ + 1; i < next_; i++) {
+            held += jobs_[i].output.size() + jobs_[i].errors.size();
+        }
+        return held >= limit_ * HELD_PER_JOB;
+    }
+
+    void start(Job& job) {
+        int out[2];
+        int err[2];
+        if (pipe2(out, O_CLOEXEC) == -1) {
+            return fail(job, "pipe", ERR_PIPE_FAILED);
+        }
+        if (pipe2(err, O_CLOEXEC) == -1) {
+            close(out[0]);
+            close(out[1]);
+            return fail(job, "pipe", ERR_PIPE_FAILED);
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == -1) {
+            for (int fd : {out[0], out[1], err[0], err[1]}) {
+                close(fd);
+            }
+            return fail(job, "fork", ERR_FORK_FAILED);
+        }
+
+        if (pid == 0) {
+            // === CHILD PROCESS ===
+            setup_child_signals();
+            for (auto& other : jobs_) {
+                close_fd(other.out);     // Would keep other jobs' pipes open
+                close_fd(other.err);
+            }
+            int null = open("/dev/null", O_RDONLY);
+            if (null != -1) {
+                dup2(null, STDIN_FILENO);
+                close(null);
+            }
+            dup2(out[1], STDOUT_FILENO);
+            dup2(err[1], STDERR_FILENO);
+            for (int fd : {out[0], out[1], err[0], err[1]}) {
+                close(fd);
+            }
+            Command cmd;
+            cmd.args = job.args;
+            run_in_child(cmd);
+        }
+
+        // === PARENT PROCESS ===
+        close(out[1]);
+        close(err[1]);
+        job.pid = pid;
+        job.out = out[0];
+        job.err = err[0];
+        running_++;
+    }
+
+    void fail(Job& job, const char* what, int status) {
+        shell_perror(what);
+        job.status = status;
+        job.done = true;
+        finished_.push_back(&job - jobs_.data());
+    }
+
+    void read_from(Job& job, int& fd, std::string& buffer) {
+        char buf[65536];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            buffer.append(buf, static_cast<size_t>(n));
+            return;
+        }
+        if (n == -1 && errno == EINTR) {
+            return;
+        }
+        close_fd(fd);
+        if (job.out == -1 && job.err == -1) {
+            job.status = wait_for_child(job.pid);
+            job.done = true;
+            running_--;
+            finished_.push_back(&job - jobs_.data());
+        }
+    }
+
+    void wait_for_output() {
+        std::vector<struct pollfd> fds;
+        std::vector<Job*> owners;
+        bool full = held_full();
+        for (size_t i = 0; i < next_; i++) {
+            if (full && i != written_) {
+                continue;
+            }
+            Job& job = jobs_[i];
+            for (int fd : {job.out, job.err}) {
+                if (fd != -1) {
+                    fds.push_back({fd, POLLIN, 0});
+                    owners.push_back(&job);
+                }
+            }
+        }
+        if (fds.empty() || poll(fds.data(), fds.size(), -1) <= 0) {
+            return;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Job& job = *owners[i];
+            if (fds[i].fd == job.out) {
+                read_from(job, job.out, job.output);
+            } else if (fds[i].fd == job.err) {
+                read_from(job, job.err, job.errors);
+            }
+        }
+    }
+
+    void write_job(Job& job) {
+        std::cout.write(job.output.data(), static_cast<std::streamsize>(job.output.size()));
+        std::cout.flush();
+        std::cerr.write(job.errors.data(), static_cast<std::streamsize>(job.errors.size()));
+        std::cerr.flush();
+        std::string().swap(job.output);
+        std::string().swap(job.errors);
+        written_++;
+    }
+
+    // Write out every job whose turn has come
+    void write_finished() {
+        if (keep_order_) {
+            while (written_ < jobs_.size() && jobs_[written_].done) {
+                write_job(jobs_[written_]);
+            }
+        } else {
+            for (size_t index : finished_) {
+                write_job(jobs_[index]);
+            }
+        }
+        finished_.clear();
+    }
+
+    int summary() {
+        size_t failed = 0;
+        for (const auto& job : jobs_) {
+            if (job.done && job.status != SHELL_OK) failed++;
+        }
+        if (failed > 0) {
+            std::cerr << "parallel: " << failed << " of " << jobs_.size() << " jobs failed"
+                      << std::endl;
+            for (const auto& job : jobs_) {
+                if (job.done && job.status != SHELL_OK) {
+                    std::cerr << "parallel: exit " << job.status << ": " << command_line(job.args)
+                              << std::endl;
+                }
+            }
+        }
+        if (g_interrupted) {
+            return 128 + SIGINT;
+        }
+        return static_cast<int>(std::min<size_t>(failed, MAX_FAILED_STATUS));
+    }
+};
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+int parallel_run(const std::vector<std::string>& command, const std::vector<std::string>& inputs,
+                 unsigned jobs, bool keep_order) {
+    std::vector<Job> list(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        list[i].args = job_args(command, inputs[i]);
+    }
+
+    // Jobs are reaped here, not by the SIGCHLD handler
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    JobRunner runner(list, jobs, keep_order);
+    int status = runner.run();
+    restore_sigmask(&old_mask);
+    return status;
+}
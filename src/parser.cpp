@@ -1,11 +1,128 @@
 #include "parser.h"
 #include "env.h"
 #include "wildcard.h"
+#include "arith.h"
+#include "subst.h"
+#include "context.h"
 #include <unistd.h>   // for getpid
+#include <iostream>
 
 #include <sstream>
 #include <cctype>
 
+bool g_expansion_error = false;
+
+// ============================================================================
+// Parenthesis Matching
+// ============================================================================
+
+size_t find_closing_paren(const std::string& text, size_t open) {
+    int depth = 0;
+    size_t i = open;
+    
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '\\') {
+            i += 2;
+            continue;
+        }
+        if (c == '\'') {
+            size_t close = text.find('\'', i + 1);
+            if (close == std::string::npos) return std::string::npos;
+            i = close + 1;
+            continue;
+        }
+        if (c == '"') {
+            i++;
+            while (i < text.size() && text[i] != '"') {
+                if (text[i] == '\\') i++;
+                i++;
+            }
+            if (i >= text.size()) return std::string::npos;
+            i++;
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (--depth == 0) return i;
+        }
+        i++;
+    }
+    return std::string::npos;
+}
+
+// Index of the '}' closing the "${" whose '{' is at `open` (quotes and
+// nested substitutions skipped), or std::string::npos if it is missing
+static size_t find_closing_brace(const std::string& text, size_t open) {
+    int depth = 0;
+    for (size_t i = open; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\\') {
+            i++;
+        } else if (c == '\'') {
+            i = text.find('\'', i + 1);
+            if (i == std::string::npos) return i;
+        } else if (c == '$' && i + 1 < text.size() && text[i + 1] == '(') {
+            i = find_closing_paren(text, i + 1);
+            if (i == std::string::npos) return i;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}') {
+            if (--depth == 0) return i;
+        }
+    }
+    return std::string::npos;
+}
+
+// Parse the NAME or NAME[subscript] at the start of an assignment word:
+// sets `name_end` past it and `eq` to its '=' (which may follow a '+');
+// false if `raw` is not an assignment
+static bool scan_assignment(const std::string& raw, size_t& name_end, size_t& eq) {
+    if (raw.empty() || (!std::isalpha(static_cast<unsigned char>(raw[0])) && raw[0] != '_')) {
+        return false;
+    }
+    size_t i = 1;
+    while (i < raw.size() && (std::isalnum(static_cast<unsigned char>(raw[i])) || raw[i] == '_')) {
+        i++;
+    }
+    if (i < raw.size() && raw[i] == '[') {
+        int depth = 0;
+        for (; i < raw.size(); i++) {
+            if (raw[i] == '[') {
+                depth++;
+            } else if (raw[i] == ']' && --depth == 0) {
+                break;
+            }
+        }
+        if (i == raw.size()) {
+            return false;
+        }
+        i++;
+    }
+    name_end = i;
+    if (i < raw.size() && raw[i] == '+') {
+        i++;
+    }
+    if (i >= raw.size() || raw[i] != '=') {
+        return false;
+    }
+    eq = i;
+    return true;
+}
+
+// Index of the backquote closing the one at `open` (npos if missing)
+static size_t find_backquote(const std::string& text, size_t open) {
+    for (size_t i = open + 1; i < text.size(); i++) {
+        if (text[i] == '\\') {
+            i++;
+        } else if (text[i] == '`') {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
 // ============================================================================
 // Tokenizer Implementation
 // ============================================================================
@@ -14,6 +131,8 @@ class Tokenizer {
 public:
     Tokenizer(const std::string& input) : input_(input), pos_(0) {}
     
+    bool incomplete() const { return incomplete_; }
+    
     std::vector<Token> tokenize() {
         std::vector<Token> tokens;
         
@@ -27,10 +146,40 @@ public:
             char c = input_[pos_];
             
             // Check for operators
-            if (c == '|') {
+            if (c != '\n' && after_regex_operator(tokens)) {
+                tokens.push_back(Token(TOKEN_WORD, parse_regex_word()));
+            }
+            else if (c == '\n') {
+                tokens.push_back(Token(TOKEN_NEWLINE, "\n"));
+                pos_++;
+                read_here_documents(tokens);
+            }
+            else if (c == ';') {
+                tokens.push_back(Token(TOKEN_SEMI, ";"));
+                pos_++;
+            }
+            else if (input_.compare(pos_, 2, "||") == 0) {
+                tokens.push_back(Token(TOKEN_OR_IF, "||"));
+                pos_ += 2;
+            }
+            else if (c == '|') {
                 tokens.push_back(Token(TOKEN_PIPE, "|"));
                 pos_++;
             }
+            else if (at_process_substitution()) {
+                tokens.push_back(Token(TOKEN_WORD, parse_word()));
+            }
+            else if (input_.compare(pos_, 3, "<<<") == 0) {
+                tokens.push_back(Token(TOKEN_HERESTRING, "<<<"));
+                pos_ += 3;
+            }
+            else if (input_.compare(pos_, 2, "<<") == 0) {
+                scan_here_document(tokens);
+            }
+            else if (input_.compare(pos_, 2, "<&") == 0) {
+                tokens.push_back(Token(TOKEN_DUP_IN, "<&"));
+                pos_ += 2;
+            }
             else if (c == '<') {
                 tokens.push_back(Token(TOKEN_REDIRECT_IN, "<"));
                 pos_++;
@@ -40,21 +189,57 @@ public:
                 if (pos_ < input_.size() && input_[pos_] == '>') {
                     tokens.push_back(Token(TOKEN_REDIRECT_APPEND, ">>"));
                     pos_++;
+                } else if (pos_ < input_.size() && input_[pos_] == '&') {
+                    tokens.push_back(Token(TOKEN_DUP_OUT, ">&"));
+                    pos_++;
                 } else {
                     tokens.push_back(Token(TOKEN_REDIRECT_OUT, ">"));
                 }
             }
+            else if (input_.compare(pos_, 3, "2>&") == 0) {
+                tokens.push_back(Token(TOKEN_DUP_ERR, "2>&"));
+                pos_ += 3;
+            }
             else if (c == '2' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '>') {
                 tokens.push_back(Token(TOKEN_REDIRECT_ERR, "2>"));
                 pos_ += 2;
             }
+            else if (input_.compare(pos_, 2, "&&") == 0) {
+                tokens.push_back(Token(TOKEN_AND_IF, "&&"));
+                pos_ += 2;
+            }
             else if (c == '&') {
                 tokens.push_back(Token(TOKEN_BACKGROUND, "&"));
                 pos_++;
             }
+            else if (c == '(' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '(') {
+                // (( expression )) arithmetic command
+                size_t close = find_closing_paren(input_, pos_);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size();
+                }
+                size_t end = std::min(close, input_.size());
+                std::string inner = input_.substr(pos_ + 2, end > pos_ + 2 ? end - pos_ - 2 : 0);
+                if (!inner.empty() && inner.back() == ')') {
+                    inner.pop_back();
+                }
+                tokens.push_back(Token(TOKEN_ARITH, inner));
+                pos_ = std::min(close + 1, input_.size());
+            }
+            else if (c == '(') {
+                tokens.push_back(Token(TOKEN_LPAREN, "("));
+                pos_++;
+            }
+            else if (c == ')') {
+                tokens.push_back(Token(TOKEN_RPAREN, ")"));
+                pos_++;
+            }
             else if (c == '#') {
                 // Comment - ignore rest of line
-                break;
+                while (pos_ < input_.size() && input_[pos_] != '\n') {
+                    pos_++;
+                }
             }
             else {
                 // Parse a word (possibly quoted)
@@ -65,70 +250,284 @@ public:
             }
         }
         
+        if (!pending_.empty()) {
+            incomplete_ = true;          // Body (or its delimiter) still to come
+        }
         tokens.push_back(Token(TOKEN_END, ""));
         return tokens;
     }
-    
+
 private:
+    // A here-document whose body starts after the next newline
+    struct PendingHereDoc {
+        size_t token;                    // Index of its TOKEN_HEREDOC
+        std::string delimiter;           // Quote-removed
+        bool strip_tabs;                 // <<-
+    };
+    
     std::string input_;
     size_t pos_;
+    bool incomplete_ = false;
+    std::vector<PendingHereDoc> pending_;
+    
+    // << WORD or <<- WORD: emit the redirection and its delimiter word now,
+    // and fill in the body when the end of the line is reached
+    void scan_here_document(std::vector<Token>& tokens) {
+        pos_ += 2;
+        bool strip_tabs = pos_ < input_.size() && input_[pos_] == '-';
+        if (strip_tabs) {
+            pos_++;
+        }
+        tokens.push_back(Token(TOKEN_HEREDOC, strip_tabs ? "<<-" : "<<"));
+        
+        skip_whitespace();
+        std::string word = parse_word();
+        if (word.empty()) {
+            return;                      // The parser reports the missing word
+        }
+        pending_.push_back({tokens.size() - 1, remove_quotes(word), strip_tabs});
+        tokens.push_back(Token(TOKEN_WORD, word));
+    }
+    
+    void read_here_documents(std::vector<Token>& tokens) {
+        for (const auto& doc : pending_) {
+            std::string body;
+            bool found = false;
+            
+            while (pos_ < input_.size()) {
+                size_t eol = input_.find('\n', pos_);
+                size_t end = eol == std::string::npos ? input_.size() : eol;
+                size_t start = pos_;
+                while (doc.strip_tabs && start < end && input_[start] == '\t') {
+                    start++;
+                }
+                pos_ = eol == std::string::npos ? input_.size() : eol + 1;
+                
+                if (input_.compare(start, end - start, doc.delimiter) == 0) {
+                    found = true;
+                    break;
+                }
+                body.append(input_, start, end - start);
+                body += '\n';
+            }
+            
+            if (!found) {
+                incomplete_ = true;
+            }
+            tokens[doc.token].value = std::move(body);
+        }
+        pending_.clear();
+    }
+    
+    static std::string remove_quotes(const std::string& word) {
+        std::string result;
+        char quote = 0;
+        for (size_t i = 0; i < word.size(); i++) {
+            char c = word[i];
+            if (c == quote) {
+                quote = 0;
+            } else if (quote) {
+                result += c;
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+            } else if (c == '\\' && i + 1 < word.size()) {
+                result += word[++i];
+            } else {
+                result += c;
+            }
+        }
+        return result;
+    }
     
     void skip_whitespace() {
-        while (pos_ < input_.size() && std::isspace(input_[pos_])) {
+        while (pos_ < input_.size()) {
+            char c = input_[pos_];
+            if (c == ' ' || c == '\t' || c == '\r') {
+                pos_++;
+            } else if (c == '\\' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '\n') {
+                pos_ += 2;   // Line continuation
+            } else {
+                break;
+            }
+        }
+    }
+    
+    // <(...) or >(...) -- part of a word, not a redirection
+    bool at_process_substitution() const {
+        return (input_[pos_] == '<' || input_[pos_] == '>') &&
+               pos_ + 1 < input_.size() && input_[pos_ + 1] == '(';
+    }
+    
+    // The last token is =~ inside [[ ]]
+    static bool after_regex_operator(const std::vector<Token>& tokens) {
+        if (tokens.empty() || tokens.back().type != TOKEN_WORD || tokens.back().value != "=~") {
+            return false;
+        }
+        for (size_t k = tokens.size() - 1; k-- > 0;) {
+            if (tokens[k].type == TOKEN_WORD && tokens[k].value == "]]") return false;
+            if (tokens[k].type == TOKEN_WORD && tokens[k].value == "[[") return true;
+        }
+        return false;
+    }
+    
+    // The regular expression right of =~: one word, as in bash, that ends
+    // at whitespace outside parentheses; ( ) | & < > are part of it, and
+    // quotes and escapes are kept for the evaluator
+    std::string parse_regex_word() {
+        size_t start = pos_;
+        int depth = 0;
+        while (pos_ < input_.size()) {
+            char c = input_[pos_];
+            if (c == '\\' && pos_ + 1 < input_.size()) {
+                pos_ += 2;
+                continue;
+            }
+            if (c == '\'' || c == '"') {
+                size_t close = pos_ + 1;
+                while (close < input_.size() && input_[close] != c) {
+                    close += (c == '"' && input_[close] == '\\') ? 2 : 1;
+                }
+                if (close >= input_.size()) {
+                    incomplete_ = true;
+                    pos_ = input_.size();
+                    break;
+                }
+                pos_ = close + 1;
+                continue;
+            }
+            if (c == '(') {
+                depth++;
+            } else if (c == ')' && --depth < 0) {
+                break;
+            } else if (depth == 0 && std::isspace(static_cast<unsigned char>(c))) {
+                break;
+            }
             pos_++;
         }
+        return input_.substr(start, pos_ - start);
     }
     
+    // Scan a word, keeping its quotes and escapes for the expansion phase
     std::string parse_word() {
         std::string result;
         
         while (pos_ < input_.size()) {
             char c = input_[pos_];
             
-            // Stop at whitespace or operators
-            if (std::isspace(c) || c == '|' || c == '<' || c == '>' || 
-                c == '&' || c == '#') {
-                break;
+            // <( ... ) and >( ... ) are one unit
+            if (at_process_substitution()) {
+                size_t close = find_closing_paren(input_, pos_ + 1);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size() - 1;
+                }
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = close + 1;
+                continue;
+            }
+            
+            // NAME=( ... ) and NAME+=( ... ) array literals are one unit
+            size_t name_end, eq;
+            if (c == '(' && !result.empty() && result.back() == '=' &&
+                scan_assignment(result, name_end, eq) && eq + 1 == result.size()) {
+                size_t close = find_closing_paren(input_, pos_);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size() - 1;
+                }
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = close + 1;
+                continue;
             }
             
-            // Handle 2> specially
-            if (c == '2' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '>') {
+            // Stop at whitespace or operators
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '|' ||
+                c == '<' || c == '>' || c == '&' || c == ';' || c == '(' || c == ')') {
                 break;
             }
             
             // Handle single quotes - preserve literally
             if (c == '\'') {
-                pos_++;
-                while (pos_ < input_.size() && input_[pos_] != '\'') {
-                    result += input_[pos_];
-                    pos_++;
+                size_t close = input_.find('\'', pos_ + 1);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size();
                 }
-                if (pos_ < input_.size()) pos_++; // Skip closing quote
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = std::min(close + 1, input_.size());
             }
-            // Handle double quotes - allow escapes
+            // Handle double quotes - escapes are resolved during expansion
             else if (c == '"') {
+                result += c;
                 pos_++;
                 while (pos_ < input_.size() && input_[pos_] != '"') {
+                    size_t close = std::string::npos;
                     if (input_[pos_] == '\\' && pos_ + 1 < input_.size()) {
-                        char next = input_[pos_ + 1];
-                        if (next == '"' || next == '\\' || next == '$' || next == '`') {
-                            result += next;
-                            pos_ += 2;
-                            continue;
-                        }
+                        result += input_[pos_++];
+                    } else if (input_[pos_] == '`') {
+                        close = find_backquote(input_, pos_);
+                    } else if (input_[pos_] == '$' && pos_ + 1 < input_.size() &&
+                               input_[pos_ + 1] == '(') {
+                        close = find_closing_paren(input_, pos_ + 1);
+                    } else if (input_[pos_] == '$' && pos_ + 1 < input_.size() &&
+                               input_[pos_ + 1] == '{') {
+                        close = find_closing_brace(input_, pos_ + 1);
                     }
-                    result += input_[pos_];
-                    pos_++;
+                    // A substitution may contain quotes of its own
+                    if (close != std::string::npos) {
+                        result.append(input_, pos_, close + 1 - pos_);
+                        pos_ = close + 1;
+                        continue;
+                    }
+                    result += input_[pos_++];
+                }
+                if (pos_ < input_.size()) {
+                    result += input_[pos_++];   // Closing quote
+                } else {
+                    incomplete_ = true;
                 }
-                if (pos_ < input_.size()) pos_++; // Skip closing quote
             }
             // Handle escape character
             else if (c == '\\') {
                 pos_++;
-                if (pos_ < input_.size()) {
-                    result += input_[pos_];
-                    pos_++;
+                if (pos_ >= input_.size()) {
+                    incomplete_ = true;
+                } else if (input_[pos_] == '\n') {
+                    pos_++;                      // Line continuation
+                } else {
+                    result += '\\';
+                    result += input_[pos_++];
+                }
+            }
+            // `command` is one unit
+            else if (c == '`') {
+                size_t close = find_backquote(input_, pos_);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size() - 1;
+                }
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = close + 1;
+            }
+            // $( ... ) and $(( ... )) are one unit, like ${...}
+            else if (c == '$' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '(') {
+                size_t close = find_closing_paren(input_, pos_ + 1);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size() - 1;
+                }
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = close + 1;
+            }
+            // ${...} is one unit even if it contains operator characters
+            else if (c == '$' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '{') {
+                size_t close = find_closing_brace(input_, pos_ + 1);
+                if (close == std::string::npos) {
+                    incomplete_ = true;
+                    close = input_.size() - 1;
                 }
+                result.append(input_, pos_, close + 1 - pos_);
+                pos_ = close + 1;
             }
             // Regular character
             else {
@@ -141,61 +540,1094 @@ private:
     }
 };
 
-std::vector<Token> tokenize(const std::string& line) {
+std::vector<Token> tokenize(const std::string& line, bool* incomplete) {
     Tokenizer tokenizer(line);
-    return tokenizer.tokenize();
+    std::vector<Token> tokens = tokenizer.tokenize();
+    if (incomplete != nullptr) {
+        *incomplete = tokenizer.incomplete();
+    }
+    return tokens;
+}
+
+// ============================================================================
+// Parameter Lookup
+// ============================================================================
+
+// Value of a single parameter: $?, $$, $#, $0-$9, $NAME
+static std::string expand_parameter(const std::string& name) {
+    if (name == "?") {
+        return std::to_string(g_context->last_exit_status);
+    }
+    if (name == "$") {
+        return std::to_string(getpid());
+    }
+    
+    const std::vector<std::string>& params = get_positional_params();
+    if (name == "#") {
+        return std::to_string(params.empty() ? 0 : params.size() - 1);
+    }
+    if (!name.empty() && std::isdigit(static_cast<unsigned char>(name[0]))) {
+        size_t index = std::stoul(name);
+        return index < params.size() ? params[index] : "";
+    }
+    
+    return get_env(name);
+}
+
+// True if `name` is a whole parameter name (as opposed to ${...} text
+// with an operator)
+static bool is_parameter_name(const std::string& name) {
+    if (name.size() == 1 && std::string("?$#@*").find(name[0]) != std::string::npos) {
+        return true;
+    }
+    if (!name.empty() && std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return name.find_first_not_of("0123456789") == std::string::npos;
+    }
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read the name after '$' at position i (advancing i); empty if none.
+// For ${...} this is everything between the braces, operators included.
+static std::string scan_parameter_name(const std::string& input, size_t& i, bool& braced) {
+    braced = false;
+    if (i >= input.size()) {
+        return "";
+    }
+    
+    if (input[i] == '{') {
+        size_t close = find_closing_brace(input, i);
+        if (close == std::string::npos) {
+            return "";
+        }
+        braced = true;
+        std::string name = input.substr(i + 1, close - i - 1);
+        i = close + 1;
+        return name;
+    }
+    
+    char c = input[i];
+    if (c == '?' || c == '$' || c == '#' || c == '@' || c == '*' ||
+        std::isdigit(static_cast<unsigned char>(c))) {
+        i++;
+        return std::string(1, c);
+    }
+    
+    std::string name;
+    while (i < input.size() &&
+           (std::isalnum(static_cast<unsigned char>(input[i])) || input[i] == '_')) {
+        name += input[i];
+        i++;
+    }
+    return name;
+}
+
+// ============================================================================
+// Array Subscripts
+// ============================================================================
+
+// Split NAME[subscript]; false if `ref` has no subscript
+static bool split_subscript(const std::string& ref, std::string& name, std::string& subscript) {
+    size_t open = ref.find('[');
+    if (open == std::string::npos || open == 0 || ref.back() != ']') {
+        return false;
+    }
+    name = ref.substr(0, open);
+    subscript = ref.substr(open + 1, ref.size() - open - 2);
+    return true;
+}
+
+// Key for `subscript` in array `name`: the expanded word for associative
+// arrays, otherwise the value of the arithmetic expression
+static bool array_key(const std::string& name, const std::string& subscript, std::string& key) {
+    if (array_kind(name) == ARRAY_ASSOCIATIVE) {
+        key = expand_word_single(subscript);
+        return true;
+    }
+    int64_t index;
+    std::string error;
+    if (!arith_eval(expand_variables(subscript), index, error)) {
+        std::cerr << "myshell: " << error << std::endl;
+        g_expansion_error = true;
+        return false;
+    }
+    key = std::to_string(index);
+    return true;
+}
+
+bool array_element_ref(const std::string& ref, std::string& name, std::string& key) {
+    std::string subscript;
+    return split_subscript(ref, name, subscript) && array_key(name, subscript, key);
+}
+
+// NAME[@] or NAME[*] (with `keys`, !NAME[@] or !NAME[*]): the elements or
+// keys as a list; `separate` is set for the @ form
+static bool array_list(const std::string& body, std::vector<std::string>& items, bool& separate) {
+    bool keys = !body.empty() && body[0] == '!';
+    std::string name, subscript;
+    if (!split_subscript(body.substr(keys ? 1 : 0), name, subscript) ||
+        (subscript != "@" && subscript != "*") || !is_parameter_name(name)) {
+        return false;
+    }
+    items = keys ? array_keys(name) : array_values(name);
+    separate = subscript == "@";
+    return true;
+}
+
+static std::string join_words(const std::vector<std::string>& words) {
+    std::string joined;
+    for (size_t k = 0; k < words.size(); k++) {
+        if (k > 0) joined += ' ';
+        joined += words[k];
+    }
+    return joined;
+}
+
+// Assign the words of an array literal: "( a b [key]=c ... )"
+static bool assign_array_literal(const std::string& name, const std::string& inner, bool append) {
+    if (!append || array_kind(name) == ARRAY_NONE) {
+        declare_array(name, false);
+    }
+    if (!append) {
+        clear_array(name);
+    }
+    bool associative = array_kind(name) == ARRAY_ASSOCIATIVE;
+    
+    for (const Token& token : tokenize(inner)) {
+        if (token.type != TOKEN_WORD) {
+            continue;
+        }
+        const std::string& word = token.value;
+        size_t close = word.find("]=");
+        if (!word.empty() && word[0] == '[' && close != std::string::npos) {
+            std::string key;
+            if (!array_key(name, word.substr(1, close - 1), key)) {
+                return false;
+            }
+            std::string value = expand_word_single(word.substr(close + 2));
+            if (!set_array_element(name, key, value)) {
+                std::cerr << "myshell: " << name << "[" << key << "]: bad array subscript" << std::endl;
+                return false;
+            }
+        } else if (associative) {
+            std::cerr << "myshell: " << name << ": " << word
+                      << ": must use subscript when assigning associative array" << std::endl;
+            return false;
+        } else {
+            for (const auto& field : expand_word(word)) {
+                append_array_element(name, field);
+            }
+        }
+    }
+    return !g_expansion_error;
+}
+
+bool assign_word(const std::string& raw) {
+    size_t name_end, eq;
+    if (!scan_assignment(raw, name_end, eq)) {
+        return false;
+    }
+    std::string ref = raw.substr(0, name_end);
+    std::string value_raw = raw.substr(eq + 1);
+    bool append = eq > name_end;
+    
+    // NAME[subscript]=value
+    std::string name, key;
+    std::string subscript;
+    if (split_subscript(ref, name, subscript)) {
+        if (!array_key(name, subscript, key)) {
+            return false;
+        }
+        std::string value = expand_word_single(value_raw);
+        std::string old;
+        if (append && get_array_element(name, key, old)) {
+            value = old + value;
+        }
+        if (!set_array_element(name, key, value)) {
+            std::cerr << "myshell: " << ref << ": bad array subscript" << std::endl;
+            return false;
+        }
+        return !g_expansion_error;
+    }
+    
+    // NAME=( ... )
+    if (value_raw.size() >= 2 && value_raw.front() == '(' && value_raw.back() == ')') {
+        return assign_array_literal(ref, value_raw.substr(1, value_raw.size() - 2), append);
+    }
+    
+    std::string value = expand_word_single(value_raw);
+    if (g_expansion_error) {
+        return false;
+    }
+    set_var(ref, append ? get_env(ref) + value : value);
+    return true;
+}
+
+// ============================================================================
+// Parameter Operators
+// ============================================================================
+// ${#v}, ${v:-w} ${v:=w} ${v:?w} ${v:+w} (and the forms without ':', which
+// only test for unset), ${v#p} ${v##p} ${v%p} ${v%%p}, ${v/p/r} ${v//p/r}
+// ${v/#p/r} ${v/%p/r}, ${v:off:len}, ${v^} ${v^^} ${v,} ${v,,}. Patterns use
+// the wildcard matcher; nothing here starts a process.
+
+// Outcome of ${...}: a value, or for ${v-w} / ${v+w} the word w, which the
+// caller expands in its own (quoted or unquoted) context
+struct BracedValue {
+    std::string value;
+    bool use_word = false;
+    std::string word;
+};
+
+static bool parameter_is_set(const std::string& name) {
+    std::string array, subscript, key, value;
+    if (split_subscript(name, array, subscript)) {
+        if (subscript == "@" || subscript == "*") {
+            return array_size(array) > 0;
+        }
+        return array_key(array, subscript, key) && get_array_element(array, key, value);
+    }
+    
+    const std::vector<std::string>& params = get_positional_params();
+    if (name == "@" || name == "*") {
+        return params.size() > 1;
+    }
+    if (std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return std::stoul(name) < params.size();
+    }
+    if (name.size() == 1 && (name[0] == '?' || name[0] == '$' || name[0] == '#')) {
+        return true;
+    }
+    return env_is_set(name);
+}
+
+static std::string parameter_value(const std::string& name) {
+    std::string array, subscript, key, value;
+    if (split_subscript(name, array, subscript)) {
+        if (subscript == "@" || subscript == "*") {
+            value = join_words(array_values(array));
+        } else if (array_key(array, subscript, key)) {
+            get_array_element(array, key, value);
+        }
+        return value;
+    }
+    
+    if (name != "@" && name != "*") {
+        return expand_parameter(name);
+    }
+    const std::vector<std::string>& params = get_positional_params();
+    return join_words(std::vector<std::string>(params.begin() + 1, params.end()));
+}
+
+static void bad_substitution(const std::string& body) {
+    std::cerr << "myshell: ${" << body << "}: bad substitution" << std::endl;
+    g_expansion_error = true;
+}
+
+// Offset or length of ${v:off:len}, an arithmetic expression
+static bool eval_index(const std::string& text, int64_t& value) {
+    std::string error;
+    if (!arith_eval(expand_variables(text), value, error)) {
+        std::cerr << "myshell: " << error << std::endl;
+        g_expansion_error = true;
+        return false;
+    }
+    return true;
+}
+
+static std::string substring(const std::string& value, const std::string& spec) {
+    size_t colon = spec.find(':');
+    int64_t size = static_cast<int64_t>(value.size());
+    int64_t offset;
+    if (!eval_index(spec.substr(0, colon), offset)) {
+        return "";
+    }
+    if (offset < 0) {
+        offset = std::max<int64_t>(0, size + offset);
+    }
+    offset = std::min(offset, size);
+    
+    int64_t end = size;
+    if (colon != std::string::npos) {
+        int64_t length;
+        if (!eval_index(spec.substr(colon + 1), length)) {
+            return "";
+        }
+        end = length < 0 ? size + length : offset + length;
+        if (end < offset) {
+            std::cerr << "myshell: " << spec.substr(colon + 1) << ": substring expression < 0" << std::endl;
+            g_expansion_error = true;
+            return "";
+        }
+        end = std::min(end, size);
+    }
+    return value.substr(static_cast<size_t>(offset), static_cast<size_t>(end - offset));
+}
+
+// ${v#p} ${v##p} ${v%p} ${v%%p}
+static std::string remove_affix(const std::string& value, const std::string& pattern,
+                                bool suffix, bool longest) {
+    size_t n = value.size();
+    for (size_t step = 0; step <= n; step++) {
+        size_t len = longest ? n - step : step;
+        if (suffix) {
+            if (match_pattern(pattern, value.data() + n - len, len)) {
+                return value.substr(0, n - len);
+            }
+        } else if (match_pattern(pattern, value.data(), len)) {
+            return value.substr(len);
+        }
+    }
+    return value;
+}
+
+// What a pattern matches, read one unit (a character, an escaped
+// character, ? or *) at a time
+struct PatternShape {
+    bool literal = true;                 // No ? or *: `text` is all it matches
+    std::string text;
+    size_t length = 0;                   // Length of every match, npos with *
+    int first = -1;                      // First and last unit if literal
+    int last = -1;                       // characters, else -1
+};
+
+static PatternShape pattern_shape(const std::string& pattern) {
+    PatternShape shape;
+    for (size_t p = 0; p < pattern.size(); p++) {
+        bool start = p == 0;
+        int unit = -1;
+        if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+            unit = static_cast<unsigned char>(pattern[++p]);
+        } else if (pattern[p] == '*') {
+            shape.literal = false;
+            shape.length = std::string::npos;
+        } else if (pattern[p] == '?' || pattern[p] == '\\') {
+            shape.literal = false;       // A trailing backslash never matches
+        } else {
+            unit = static_cast<unsigned char>(pattern[p]);
+        }
+        if (unit != -1) shape.text += static_cast<char>(unit);
+        if (shape.length != std::string::npos) shape.length++;
+        if (start) shape.first = unit;
+        shape.last = unit;
+    }
+    return shape;
+}
+
+// Length of the longest match of `pattern` at `start`, or only of one
+// reaching the end of the value if `to_end` (npos if none). Only ends
+// that can match are tried, and none of them is copied.
+static size_t longest_match(const std::string& value, size_t start, const std::string& pattern,
+                            const PatternShape& shape, bool to_end) {
+    size_t size = value.size();
+    if (shape.first != -1 && (start == size || value[start] != static_cast<char>(shape.first))) {
+        return std::string::npos;
+    }
+    if (shape.length != std::string::npos) {
+        size_t end = start + shape.length;
+        bool found = end <= size && (!to_end || end == size) &&
+                     match_pattern(pattern, value.data() + start, shape.length);
+        return found ? shape.length : std::string::npos;
+    }
+    for (size_t end = size; end >= start; end--) {
+        if ((shape.last == -1 || (end > start && value[end - 1] == static_cast<char>(shape.last))) &&
+            match_pattern(pattern, value.data() + start, end - start)) {
+            return end - start;
+        }
+        if (to_end || end == start) {
+            break;
+        }
+    }
+    return std::string::npos;
+}
+
+// ${v/p/r} (op "/"), ${v//p/r} ("//"), ${v/#p/r} ("/#"), ${v/%p/r} ("/%")
+static std::string replace_pattern(const std::string& value, const std::string& op,
+                                   const std::string& pattern, const std::string& replacement) {
+    if (pattern.empty()) {
+        return value;
+    }
+    PatternShape shape = pattern_shape(pattern);
+    if (op == "/#") {
+        size_t len = longest_match(value, 0, pattern, shape, false);
+        return len == std::string::npos ? value : replacement + value.substr(len);
+    }
+    if (op == "/%") {
+        size_t first = shape.length == std::string::npos
+                           ? 0 : value.size() - std::min(value.size(), shape.length);
+        for (size_t start = first; start <= value.size(); start++) {
+            if (longest_match(value, start, pattern, shape, true) != std::string::npos) {
+                return value.substr(0, start) + replacement;
+            }
+        }
+        return value;
+    }
+    
+    // A literal is found with find(), and with any other pattern that
+    // starts with a literal character only the places holding it are tried
+    std::string result;
+    size_t i = 0;
+    while (i < value.size()) {
+        size_t at = i;
+        size_t len = std::string::npos;
+        if (shape.literal) {
+            at = value.find(shape.text, i);
+            len = shape.text.size();
+        } else {
+            for (at = i; at < value.size(); at++) {
+                if (shape.first != -1) {
+                    at = value.find(static_cast<char>(shape.first), at);
+                    if (at == std::string::npos) break;
+                }
+                len = longest_match(value, at, pattern, shape, false);
+                if (len != std::string::npos && len > 0) break;
+            }
+        }
+        if (at == std::string::npos || at >= value.size()) {
+            break;
+        }
+        result.append(value, i, at - i);
+        result += replacement;
+        i = at + len;
+        if (op == "/") {
+            break;
+        }
+    }
+    result.append(value, std::min(i, value.size()), std::string::npos);
+    return result;
+}
+
+// ${v^} ${v^^} ${v,} ${v,,}: characters matching the pattern (any, if it
+// is empty) change case
+static std::string convert_case(const std::string& value, bool upper, bool all,
+                                const std::string& pattern) {
+    std::string result = value;
+    for (size_t i = 0; i < result.size() && (all || i == 0); i++) {
+        if (!pattern.empty() && !match_pattern(pattern, std::string(1, result[i]))) {
+            continue;
+        }
+        unsigned char c = static_cast<unsigned char>(result[i]);
+        result[i] = static_cast<char>(upper ? std::toupper(c) : std::tolower(c));
+    }
+    return result;
+}
+
+// Split "pattern/replacement" at the first '/' outside quotes
+static void split_replacement(const std::string& text, std::string& pattern, std::string& replacement) {
+    char quote = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\\' && quote != '\'') {
+            i++;
+        } else if (c == quote) {
+            quote = 0;
+        } else if (!quote && (c == '\'' || c == '"')) {
+            quote = c;
+        } else if (!quote && c == '/') {
+            pattern = text.substr(0, i);
+            replacement = text.substr(i + 1);
+            return;
+        }
+    }
+    pattern = text;
+    replacement.clear();
+}
+
+// Evaluate ${body} where body is a name followed by an operator
+static BracedValue expand_braced(const std::string& body) {
+    BracedValue result;
+    
+    // ${!name[@]}, ${name[@]}: keys or elements, joined
+    std::vector<std::string> items;
+    bool separate;
+    if (array_list(body, items, separate)) {
+        result.value = join_words(items);
+        return result;
+    }
+    
+    // ${#name}, ${#name[i]}: length; ${#name[@]}: number of elements
+    std::string array, subscript;
+    if (body.size() > 1 && body[0] == '#' && is_parameter_name(body.substr(1))) {
+        std::string name = body.substr(1);
+        if (name == "@" || name == "*") {
+            size_t count = get_positional_params().size();
+            result.value = std::to_string(count > 0 ? count - 1 : 0);
+        } else {
+            result.value = std::to_string(expand_parameter(name).size());
+        }
+        return result;
+    }
+    if (body.size() > 1 && body[0] == '#' && split_subscript(body.substr(1), array, subscript) &&
+        is_parameter_name(array)) {
+        if (subscript == "@" || subscript == "*") {
+            result.value = std::to_string(array_size(array));
+        } else {
+            result.value = std::to_string(parameter_value(body.substr(1)).size());
+        }
+        return result;
+    }
+    
+    // The name: digits, one special character, or an identifier
+    size_t i = 0;
+    if (i < body.size() && std::isdigit(static_cast<unsigned char>(body[i]))) {
+        while (i < body.size() && std::isdigit(static_cast<unsigned char>(body[i]))) {
+            i++;
+        }
+    } else if (i < body.size() && std::string("?$#@*").find(body[i]) != std::string::npos) {
+        i++;
+    } else {
+        while (i < body.size() &&
+               (std::isalnum(static_cast<unsigned char>(body[i])) || body[i] == '_')) {
+            i++;
+        }
+        // NAME[subscript]
+        if (i > 0 && i < body.size() && body[i] == '[') {
+            size_t close = body.find(']', i);
+            i = close == std::string::npos ? 0 : close + 1;
+        }
+    }
+    if (i == 0) {
+        bad_substitution(body);
+        return result;
+    }
+    
+    std::string name = body.substr(0, i);
+    if (i == body.size()) {
+        result.value = parameter_value(name);
+        return result;
+    }
+    std::string value = parameter_value(name);
+    bool set = parameter_is_set(name);
+    
+    // ${v:-w} ${v-w} and friends
+    bool colon = body[i] == ':' && i + 1 < body.size() &&
+                 std::string("-=?+").find(body[i + 1]) != std::string::npos;
+    size_t op_pos = colon ? i + 1 : i;
+    char op = body[op_pos];
+    if (std::string("-=?+").find(op) != std::string::npos) {
+        std::string word = body.substr(op_pos + 1);
+        bool present = colon ? !value.empty() : set;
+        if (op == '+') {
+            result.use_word = present;
+            result.word = word;
+        } else if (present) {
+            result.value = value;
+        } else if (op == '-') {
+            result.use_word = true;
+            result.word = word;
+        } else if (op == '=') {
+            if (!std::isalpha(static_cast<unsigned char>(name[0])) && name[0] != '_') {
+                std::cerr << "myshell: $" << name << ": cannot assign in this way" << std::endl;
+                g_expansion_error = true;
+                return result;
+            }
+            result.value = expand_word_single(word);
+            set_var(name, result.value);
+        } else {
+            std::string message = expand_word_single(word);
+            std::cerr << "myshell: " << name << ": "
+                      << (message.empty() ? "parameter null or not set" : message) << std::endl;
+            g_expansion_error = true;
+        }
+        return result;
+    }
+    
+    std::string rest = body.substr(i);
+    if (rest[0] == ':') {
+        result.value = substring(value, rest.substr(1));
+    } else if (rest[0] == '#' || rest[0] == '%') {
+        bool longest = rest.size() > 1 && rest[1] == rest[0];
+        result.value = remove_affix(value, expand_pattern(rest.substr(longest ? 2 : 1)),
+                                    rest[0] == '%', longest);
+    } else if (rest[0] == '/') {
+        std::string op_text = "/";
+        if (rest.size() > 1 && (rest[1] == '/' || rest[1] == '#' || rest[1] == '%')) {
+            op_text += rest[1];
+        }
+        std::string pattern, replacement;
+        split_replacement(rest.substr(op_text.size()), pattern, replacement);
+        result.value = replace_pattern(value, op_text, expand_pattern(pattern),
+                                       expand_word_single(replacement));
+    } else if (rest[0] == '^' || rest[0] == ',') {
+        bool all = rest.size() > 1 && rest[1] == rest[0];
+        result.value = convert_case(value, rest[0] == '^', all,
+                                    expand_pattern(rest.substr(all ? 2 : 1)));
+    } else {
+        bad_substitution(body);
+    }
+    return result;
+}
+
+// ============================================================================
+// Arithmetic Expansion
+// ============================================================================
+
+// If a $(( ... )) starts at i (just past '$'), evaluate it into `value`
+// and advance i past the closing parentheses
+static bool expand_arithmetic(const std::string& input, size_t& i, std::string& value) {
+    if (i + 1 >= input.size() || input[i] != '(' || input[i + 1] != '(') {
+        return false;
+    }
+    size_t close = find_closing_paren(input, i);
+    if (close == std::string::npos || input[close - 1] != ')' || close < i + 3) {
+        return false;
+    }
+    
+    // Parameters and command substitutions inside the expression are
+    // expanded first
+    std::string expr = expand_variables(input.substr(i + 2, close - i - 3));
+    i = close + 1;
+    
+    int64_t result;
+    std::string error;
+    if (!arith_eval(expr, result, error)) {
+        std::cerr << "myshell: " << error << std::endl;
+        g_expansion_error = true;
+        value.clear();
+        return true;
+    }
+    value = std::to_string(result);
+    return true;
 }
 
 // ============================================================================
 // Variable Expansion
 // ============================================================================
 
+// The script of the `command` from open to close: a backslash is literal
+// unless it escapes $, ` or another backslash
+static std::string backquoted_script(const std::string& text, size_t open, size_t close) {
+    std::string script;
+    for (size_t k = open + 1; k < close; k++) {
+        if (text[k] == '\\' && k + 1 < close &&
+            (text[k + 1] == '$' || text[k + 1] == '`' || text[k + 1] == '\\')) {
+            k++;
+        }
+        script += text[k];
+    }
+    return script;
+}
+
 std::string expand_variables(const std::string& input) {
     std::string result;
     size_t i = 0;
     
     while (i < input.size()) {
-        if (input[i] == '$' && i + 1 < input.size()) {
+        if (input[i] == '`') {
+            size_t close = find_backquote(input, i);
+            if (close == std::string::npos) close = input.size();
+            std::string output;
+            command_substitution(backquoted_script(input, i, close), output);
+            result += output;
+            i = std::min(close + 1, input.size());
+        }
+        else if (input[i] == '$' && i + 1 < input.size()) {
+            size_t start = ++i;
+            bool braced;
+            std::string arith;
+            if (expand_arithmetic(input, i, arith)) {
+                result += arith;
+                continue;
+            }
+            if (input[i] == '(') {
+                size_t close = find_closing_paren(input, i);
+                if (close == std::string::npos) close = input.size();
+                std::string output;
+                command_substitution(input.substr(i + 1, close - i - 1), output);
+                result += output;
+                i = std::min(close + 1, input.size());
+                continue;
+            }
+            std::string name = scan_parameter_name(input, i, braced);
+            
+            if (name.empty()) {
+                i = start;
+                result += '$';
+            } else if (braced && !is_parameter_name(name)) {
+                BracedValue braced_value = expand_braced(name);
+                result += braced_value.use_word ? expand_word_single(braced_value.word)
+                                                : braced_value.value;
+            } else if (name == "@" || name == "*") {
+                const std::vector<std::string>& params = get_positional_params();
+                for (size_t k = 1; k < params.size(); k++) {
+                    if (k > 1) result += ' ';
+                    result += params[k];
+                }
+            } else {
+                result += expand_parameter(name);
+            }
+        }
+        else {
+            result += input[i];
             i++;
+        }
+    }
+    
+    return result;
+}
+
+// ============================================================================
+// Word Expansion
+// ============================================================================
+
+class WordExpander {
+public:
+    WordExpander(const std::string& raw, bool split) : raw_(raw), split_(split) {
+        ifs_ = get_env("IFS");
+        if (ifs_.empty() && !env_is_set("IFS")) {
+            ifs_ = " \t\n";
+        }
+    }
+    
+    std::string run_here_document() {
+        expand_double_quoted(0, true);
+        return text_;
+    }
+    
+    // Expand as a pattern: quoted characters are escaped and
+    // unquoted ones (including those from unquoted expansions) are kept
+    std::string run_pattern() {
+        pattern_mode_ = true;
+        scan();
+        return pattern_;
+    }
+    
+    std::vector<std::string> run() {
+        scan();
+        finish_field();
+        return fields_;
+    }
+
+private:
+    void scan() {
+        size_t i = 0;
+        
+        // Tilde expansion at the start of an unquoted word
+        if (!raw_.empty() && raw_[0] == '~' &&
+            (raw_.size() == 1 || raw_[1] == '/')) {
+            add_quoted(get_env("HOME"));
+            i = 1;
+        }
+        
+        while (i < raw_.size()) {
+            char c = raw_[i];
             
-            // $? - last exit status
-            if (input[i] == '?') {
-                result += std::to_string(g_last_exit_status);
+            if (c == '\'') {
+                size_t close = raw_.find('\'', i + 1);
+                if (close == std::string::npos) close = raw_.size();
+                active_ = true;
+                add_quoted(raw_.substr(i + 1, close - i - 1));
+                i = close + 1;
+            }
+            else if (c == '"') {
+                active_ = true;
+                i = expand_double_quoted(i + 1);
+            }
+            else if (c == '\\' && i + 1 < raw_.size()) {
+                add_quoted(std::string(1, raw_[i + 1]));
+                i += 2;
+            }
+            else if (c == '$' && i + 1 < raw_.size()) {
+                i = expand_dollar(i + 1, false);
+            }
+            else if (c == '`') {
+                i = expand_backquote(i, false);
+            }
+            else if ((c == '<' || c == '>') && i + 1 < raw_.size() && raw_[i + 1] == '(') {
+                // <( command ) or >( command ): a /dev/fd path to a pipe
+                size_t close = find_closing_paren(raw_, i + 1);
+                if (close == std::string::npos) close = raw_.size();
+                add_quoted(process_substitution(raw_.substr(i + 2, close - i - 2), c == '>'));
+                i = std::min(close + 1, raw_.size());
+            }
+            else if (split_literals_ && ifs_.find(c) != std::string::npos) {
+                finish_field();
                 i++;
             }
-            // $$ - shell PID
-            else if (input[i] == '$') {
-                result += std::to_string(getpid());
+            else {
+                add_literal(c);
                 i++;
             }
-            // $VAR or ${VAR}
-            else if (std::isalpha(input[i]) || input[i] == '_' || input[i] == '{') {
-                bool braced = (input[i] == '{');
-                if (braced) i++;
-                
-                std::string var_name;
-                while (i < input.size() && (std::isalnum(input[i]) || input[i] == '_')) {
-                    var_name += input[i];
-                    i++;
-                }
-                
-                if (braced && i < input.size() && input[i] == '}') {
-                    i++;
+        }
+    }
+    
+    std::string raw_;
+    bool split_;
+    bool pattern_mode_ = false;
+    bool split_literals_ = false;  // Unquoted blanks separate fields (${v:-a b})
+    std::string ifs_;
+    
+    std::vector<std::string> fields_;
+    std::string text_;        // Current field, quotes removed
+    std::string pattern_;     // Same field with quoted glob characters escaped
+    bool glob_ = false;       // Field has an unquoted glob character
+    bool active_ = false;     // Field exists even if empty ("" or '')
+    bool empty_list_ = false; // Field holds an empty "$@" / "${a[@]}"
+    
+    static bool is_glob_char(char c) {
+        return c == '*' || c == '?' || c == '\\';
+    }
+    
+    void add_literal(char c) {
+        text_ += c;
+        pattern_ += c;
+        if (c == '*' || c == '?') glob_ = true;
+        active_ = true;
+    }
+    
+    void add_quoted(const std::string& s) {
+        for (char c : s) {
+            text_ += c;
+            if (pattern_mode_ || is_glob_char(c)) pattern_ += '\\';
+            pattern_ += c;
+        }
+        if (!s.empty()) active_ = true;
+    }
+    
+    // Unquoted expansion result: subject to field splitting and globbing
+    void add_unquoted(const std::string& s) {
+        if (pattern_mode_) {
+            for (char c : s) add_literal(c);
+            return;
+        }
+        if (!split_) {
+            add_quoted(s);
+            return;
+        }
+        for (char c : s) {
+            if (ifs_.find(c) != std::string::npos) {
+                finish_field();
+            } else {
+                add_literal(c);
+            }
+        }
+    }
+    
+    void finish_field() {
+        if (!active_ || (empty_list_ && text_.empty())) {
+            active_ = false;
+            empty_list_ = false;
+            return;
+        }
+        if (split_ && glob_) {
+            std::vector<std::string> matches = expand_glob(pattern_);
+            if (matches.size() == 1 && matches[0] == pattern_) {
+                fields_.push_back(text_);      // No match: keep the word
+            } else {
+                fields_.insert(fields_.end(), matches.begin(), matches.end());
+            }
+        } else {
+            fields_.push_back(text_);
+        }
+        text_.clear();
+        pattern_.clear();
+        glob_ = false;
+        active_ = false;
+        empty_list_ = false;
+    }
+    
+    // A here-document body has double-quote rules, except that " is an
+    // ordinary character and backslash-newline joins lines
+    size_t expand_double_quoted(size_t i, bool here_doc = false) {
+        while (i < raw_.size() && (here_doc || raw_[i] != '"')) {
+            char c = raw_[i];
+            if (c == '\\' && i + 1 < raw_.size()) {
+                char next = raw_[i + 1];
+                if (next == '\\' || next == '$' || next == '`' || (next == '"' && !here_doc)) {
+                    add_quoted(std::string(1, next));
+                } else if (next == '\n' && here_doc) {
+                    // Line continuation
+                } else {
+                    add_quoted(std::string(1, c) + next);
                 }
-                
-                result += get_env(var_name);
+                i += 2;
+            }
+            else if (c == '$' && i + 1 < raw_.size()) {
+                i = expand_dollar(i + 1, true);
+            }
+            else if (c == '`') {
+                i = expand_backquote(i, true);
             }
             else {
-                result += '$';
+                add_quoted(std::string(1, c));
+                i++;
             }
         }
-        else {
-            result += input[i];
-            i++;
+        return i + 1;   // Skip closing quote
+    }
+    
+    // Expand the parameter whose name starts at i (just past '$')
+    size_t expand_dollar(size_t i, bool quoted) {
+        size_t start = i;
+        bool braced;
+        
+        std::string arith;
+        if (expand_arithmetic(raw_, i, arith)) {
+            if (quoted) add_quoted(arith); else add_unquoted(arith);
+            return i;
+        }
+        
+        // $( command )
+        if (raw_[i] == '(') {
+            size_t close = find_closing_paren(raw_, i);
+            if (close == std::string::npos) close = raw_.size();
+            substitute(raw_.substr(i + 1, close - i - 1), quoted);
+            return std::min(close + 1, raw_.size());
+        }
+        
+        std::string name = scan_parameter_name(raw_, i, braced);
+        
+        if (name.empty()) {
+            i = start;
+            if (quoted) add_quoted("$"); else add_literal('$');
+            return i;
         }
+        
+        if (braced && !is_parameter_name(name)) {
+            expand_operator(name, quoted);
+        } else if (name == "@" || name == "*") {
+            expand_positional(name == "@", quoted);
+        } else if (quoted) {
+            add_quoted(expand_parameter(name));
+        } else {
+            add_unquoted(expand_parameter(name));
+        }
+        return i;
     }
     
-    return result;
+    // ${name<op>...}; an unquoted default word is split like the rest of the word
+    void expand_operator(const std::string& body, bool quoted) {
+        std::vector<std::string> items;
+        bool separate;
+        if (array_list(body, items, separate)) {
+            expand_list(items, separate, quoted);
+            return;
+        }
+        
+        BracedValue braced = expand_braced(body);
+        if (!braced.use_word) {
+            if (quoted) add_quoted(braced.value); else add_unquoted(braced.value);
+        } else if (quoted || !split_) {
+            add_quoted(expand_word_single(braced.word));
+        } else {
+            WordExpander word(braced.word, true);
+            word.split_literals_ = true;
+            std::vector<std::string> fields = word.run();
+            for (size_t k = 0; k < fields.size(); k++) {
+                if (k > 0) finish_field();
+                add_quoted(fields[k]);
+                active_ = true;
+            }
+        }
+    }
+    
+    // `command`
+    size_t expand_backquote(size_t i, bool quoted) {
+        size_t close = find_backquote(raw_, i);
+        if (close == std::string::npos) close = raw_.size();
+        substitute(backquoted_script(raw_, i, close), quoted);
+        return std::min(close + 1, raw_.size());
+    }
+    
+    void substitute(const std::string& script, bool quoted) {
+        std::string output;
+        command_substitution(script, output);
+        if (quoted) {
+            add_quoted(output);
+            active_ = true;
+        } else {
+            add_unquoted(output);
+        }
+    }
+    
+    // "$@" yields one field per parameter; "$*" joins them with spaces
+    void expand_positional(bool separate, bool quoted) {
+        const std::vector<std::string>& params = get_positional_params();
+        expand_list(std::vector<std::string>(params.begin() + 1, params.end()), separate, quoted);
+    }
+    
+    // "$@" / "${a[@]}" yield one field per item; "$*" joins them with spaces
+    void expand_list(const std::vector<std::string>& items, bool separate, bool quoted) {
+        if (items.empty() && separate && quoted && split_) {
+            empty_list_ = true;          // "$@" with nothing in it is no field at all
+        }
+        for (size_t k = 0; k < items.size(); k++) {
+            if (k > 0) {
+                if (quoted && separate && split_) {
+                    active_ = true;
+                    finish_field();
+                } else if (quoted) {
+                    add_quoted(" ");
+                } else {
+                    add_unquoted(" ");
+                }
+            }
+            if (quoted) {
+                add_quoted(items[k]);
+                active_ = true;
+            } else {
+                add_unquoted(items[k]);
+            }
+        }
+    }
+};
+
+// Words without quotes, substitutions, ~ or glob characters expand to themselves
+static bool is_literal_word(const std::string& raw) {
+    return !raw.empty() && raw.find_first_of("$'\"\\`~*?[(") == std::string::npos;
+}
+
+std::vector<std::string> expand_word(const std::string& raw) {
+    if (is_literal_word(raw)) {
+        return {raw};
+    }
+    
+    // NAME=( ... ) as an argument (declare -a NAME=( ... )) is left for
+    // the command to assign, element by element
+    size_t name_end, eq;
+    if (raw.back() == ')' && scan_assignment(raw, name_end, eq) &&
+        raw.compare(eq + 1, 1, "(") == 0) {
+        return {raw};
+    }
+    WordExpander expander(raw, true);
+    return expander.run();
+}
+
+std::string expand_word_single(const std::string& raw) {
+    if (is_literal_word(raw)) {
+        return raw;
+    }
+    WordExpander expander(raw, false);
+    std::vector<std::string> fields = expander.run();
+    return fields.empty() ? "" : fields[0];
+}
+
+std::string expand_pattern(const std::string& raw) {
+    if (is_literal_word(raw)) {
+        return raw;
+    }
+    WordExpander expander(raw, false);
+    return expander.run_pattern();
+}
+
+std::string expand_here_document(const std::string& body) {
+    if (body.find_first_of("$`\\") == std::string::npos) {
+        return body;
+    }
+    WordExpander expander(body, false);
+    return expander.run_here_document();
+}
+
+bool is_assignment_word(const std::string& raw) {
+    size_t name_end, eq;
+    return scan_assignment(raw, name_end, eq);
 }
 
 // ============================================================================
@@ -214,17 +1646,9 @@ Pipeline parse(const std::string& line) {
         
         switch (tok.type) {
             case TOKEN_WORD: {
-                // Expand variables
-                std::string expanded = expand_variables(tok.value);
-                
-                // Expand wildcards
-                if (has_wildcards(expanded)) {
-                    std::vector<std::string> matches = expand_glob(expanded);
-                    for (const auto& match : matches) {
-                        current_cmd.args.push_back(match);
-                    }
-                } else {
-                    current_cmd.args.push_back(expanded);
+                // Expand variables and wildcards, removing quotes
+                for (const auto& field : expand_word(tok.value)) {
+                    current_cmd.args.push_back(field);
                 }
                 break;
             }
@@ -232,45 +1656,45 @@ Pipeline parse(const std::string& line) {
             case TOKEN_REDIRECT_IN:
                 i++;
                 if (i < tokens.size() && tokens[i].type == TOKEN_WORD) {
-                    current_cmd.input_file = expand_variables(tokens[i].value);
+                    current_cmd.input_file = expand_word_single(tokens[i].value);
                 }
                 break;
-                
+            
             case TOKEN_REDIRECT_OUT:
                 i++;
                 if (i < tokens.size() && tokens[i].type == TOKEN_WORD) {
-                    current_cmd.output_file = expand_variables(tokens[i].value);
+                    current_cmd.output_file = expand_word_single(tokens[i].value);
                     current_cmd.append_output = false;
                 }
                 break;
-                
+            
             case TOKEN_REDIRECT_APPEND:
                 i++;
                 if (i < tokens.size() && tokens[i].type == TOKEN_WORD) {
-                    current_cmd.output_file = expand_variables(tokens[i].value);
+                    current_cmd.output_file = expand_word_single(tokens[i].value);
                     current_cmd.append_output = true;
                 }
                 break;
-                
+            
             case TOKEN_REDIRECT_ERR:
                 i++;
                 if (i < tokens.size() && tokens[i].type == TOKEN_WORD) {
-                    current_cmd.error_file = expand_variables(tokens[i].value);
+                    current_cmd.error_file = expand_word_single(tokens[i].value);
                 }
                 break;
-                
+            
             case TOKEN_PIPE:
                 if (!current_cmd.empty()) {
                     pipeline.commands.push_back(current_cmd);
                     current_cmd = Command();
                 }
                 break;
-                
+            
             case TOKEN_BACKGROUND:
                 current_cmd.background = true;
                 pipeline.background = true;
                 break;
-                
+            
             default:
                 break;
         }
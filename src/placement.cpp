@@ -0,0 +1,226 @@
+#include "placement.h"
+#include "shell.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const int IOPRIO_WHO_PROCESS = 1;
+static const int IOPRIO_CLASS_SHIFT = 13;
+
+// ============================================================================
+// Resource Limits
+// ============================================================================
+
+const std::vector<ResourceLimit>& resource_limits() {
+    static const std::vector<ResourceLimit> LIMITS = {
+        {'c', RLIMIT_CORE,    1024, "core file size",      "kbytes"},
+        {'d', RLIMIT_DATA,    1024, "data seg size",       "kbytes"},
+        {'f', RLIMIT_FSIZE,   1024, "file size",           "kbytes"},
+        {'l', RLIMIT_MEMLOCK, 1024, "max locked memory",   "kbytes"},
+        {'m', RLIMIT_RSS,     1024, "max memory size",     "kbytes"},
+        {'n', RLIMIT_NOFILE,  1,    "open files",          "count"},
+        {'s', RLIMIT_STACK,   1024, "stack size",          "kbytes"},
+        {'t', RLIMIT_CPU,     1,    "cpu time",            "seconds"},
+        {'u', RLIMIT_NPROC,   1,    "max user processes",  "count"},
+        {'v', RLIMIT_AS,      1024, "virtual memory",      "kbytes"},
+    };
+    return LIMITS;
+}
+
+const ResourceLimit* find_resource_limit(char option) {
+    for (const auto& limit : resource_limits()) {
+        if (limit.option == option) return &limit;
+    }
+    return nullptr;
+}
+
+bool parse_limit(const std::string& text, const ResourceLimit& limit, rlim_t& value) {
+    if (text == "unlimited") {
+        value = RLIM_INFINITY;
+        return true;
+    }
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    unsigned long long n = strtoull(text.c_str(), nullptr, 10);
+    if (errno != 0 || n > RLIM_INFINITY / limit.unit) {
+        return false;
+    }
+    value = static_cast<rlim_t>(n) * limit.unit;
+    return true;
+}
+
+std::string format_limit(rlim_t value, const ResourceLimit& limit) {
+    if (value == RLIM_INFINITY) {
+        return "unlimited";
+    }
+    return std::to_string(static_cast<unsigned long long>(value / limit.unit));
+}
+
+// ============================================================================
+// Option Parsing
+// ============================================================================
+
+static bool parse_int(const std::string& text, long& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    value = strtol(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+// "0-3,6" -> 0 1 2 3 6
+static bool parse_cpu_list(const std::string& text, std::vector<int>& cpus) {
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos
+                                                                          : comma - start);
+        size_t dash = item.find('-');
+        long first;
+        long last;
+        if (!parse_int(item.substr(0, dash), first) ||
+            !parse_int(dash == std::string::npos ? item : item.substr(dash + 1), last) ||
+            first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return !cpus.empty();
+}
+
+// CLASS[:LEVEL], CLASS being a name or 1-3
+static bool parse_io_class(const std::string& text, int& priority) {
+    size_t colon = text.find(':');
+    std::string name = text.substr(0, colon);
+    long io_class;
+    if (name == "realtime") {
+        io_class = 1;
+    } else if (name == "best-effort") {
+        io_class = 2;
+    } else if (name == "idle") {
+        io_class = 3;
+    } else if (!parse_int(name, io_class) || io_class < 1 || io_class > 3) {
+        return false;
+    }
+    long level = 4;
+    if (colon != std::string::npos &&
+        (!parse_int(text.substr(colon + 1), level) || level < 0 || level > 7)) {
+        return false;
+    }
+    priority = static_cast<int>(io_class << IOPRIO_CLASS_SHIFT | (io_class == 3 ? 0 : level));
+    return true;
+}
+
+static bool placement_error(const std::string& message) {
+    std::cerr << "myshell: confine: " << message << std::endl;
+    return false;
+}
+
+bool parse_placement(const std::vector<std::string>& words, Placement& placement) {
+    for (size_t i = 0; i < words.size(); i++) {
+        const std::string& option = words[i];
+        if (option.size() != 2 || option[0] != '-') {
+            return placement_error(option + ": invalid option");
+        }
+        char letter = option[1];
+        if (letter == 'P') {
+            placement.spread = true;
+            continue;
+        }
+        if (i + 1 == words.size()) {
+            return placement_error(option + ": option requires an argument");
+        }
+        const std::string& value = words[++i];
+
+        long number;
+        rlim_t limit;
+        const ResourceLimit* resource = find_resource_limit(letter);
+        if (letter == 'C') {
+            placement.cpus.clear();
+            if (!parse_cpu_list(value, placement.cpus)) {
+                return placement_error(value + ": invalid CPU list");
+            }
+        } else if (letter == 'N') {
+            if (!parse_int(value, number) || number < -40 || number > 40) {
+                return placement_error(value + ": invalid nice increment");
+            }
+            placement.nice = static_cast<int>(number);
+        } else if (letter == 'I') {
+            if (!parse_io_class(value, placement.io_priority)) {
+                return placement_error(value + ": invalid I/O class");
+            }
+        } else if (resource != nullptr) {
+            if (!parse_limit(value, *resource, limit)) {
+                return placement_error(value + ": invalid limit");
+            }
+            placement.limits.push_back({resource->resource, limit});
+        } else {
+            return placement_error(option + ": invalid option");
+        }
+    }
+    placement.active = !words.empty();
+    return true;
+}
+
+// ============================================================================
+// Applying a Placement
+// ============================================================================
+
+bool apply_placement(const Placement& placement, size_t stage) {
+    if (!placement.cpus.empty() || placement.spread) {
+        std::vector<int> cpus = placement.cpus;
+        cpu_set_t set;
+        if (cpus.empty() && sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+        }
+        CPU_ZERO(&set);
+        if (placement.spread && !cpus.empty()) {
+            CPU_SET(cpus[stage % cpus.size()], &set);
+        } else {
+            for (int cpu : cpus) CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+            shell_perror("confine: sched_setaffinity");
+            return false;
+        }
+    }
+
+    if (placement.nice != 0) {
+        errno = 0;
+        if (nice(placement.nice) == -1 && errno != 0) {
+            shell_perror("confine: nice");
+            return false;
+        }
+    }
+
+    if (placement.io_priority >= 0 &&
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, placement.io_priority) == -1) {
+        shell_perror("confine: ioprio_set");
+        return false;
+    }
+
+    for (const auto& limit : placement.limits) {
+        struct rlimit value = {limit.second, limit.second};
+        if (setrlimit(limit.first, &value) == -1) {
+            shell_perror("confine: setrlimit");
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#include "plugin.h"
+#include "env.h"
+#include "myshell_plugin.h"
+
+#include <cctype>
+#include <cstdio>
+#include <dlfcn.h>
+#include <iostream>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Plugins already opened, by the path given to enable -f
+static std::unordered_map<std::string, const myshell_plugin*> g_plugins;
+
+// ============================================================================
+// Variable Access for Plugins
+// ============================================================================
+
+static bool is_name(const char* name) {
+    if (name == nullptr || !(std::isalpha(static_cast<unsigned char>(*name)) || *name == '_')) {
+        return false;
+    }
+    for (const char* p = name; *p != '\0'; p++) {
+        if (!std::isalnum(static_cast<unsigned char>(*p)) && *p != '_') return false;
+    }
+    return true;
+}
+
+static const char* api_get_var(const char* name) {
+    static std::string value;
+    if (!is_name(name) || !env_is_set(name)) {
+        return nullptr;
+    }
+    value = get_env(name);
+    return value.c_str();
+}
+
+static int api_set_var(const char* name, const char* value) {
+    if (!is_name(name)) {
+        return -1;
+    }
+    set_var(name, value != nullptr ? value : "");
+    return 0;
+}
+
+static int api_unset_var(const char* name) {
+    if (!is_name(name)) {
+        return -1;
+    }
+    unset_env(name);
+    return 0;
+}
+
+static const myshell_api g_api = {MYSHELL_PLUGIN_ABI, api_get_var, api_set_var, api_unset_var};
+
+// ============================================================================
+// Calling a Plugin Builtin
+// ============================================================================
+
+static int call_plugin(myshell_builtin_fn run, const std::vector<std::string>& args) {
+    std::vector<std::string> copies(args);   // The plugin may modify its argv
+    std::vector<char*> argv;
+    for (auto& arg : copies) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    // The plugin writes to the descriptor itself, after anything buffered
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    return run(static_cast<int>(copies.size()), argv.data(), STDIN_FILENO, STDOUT_FILENO, &g_api);
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+static const myshell_plugin* open_plugin(const std::string& path, std::string& error) {
+    auto it = g_plugins.find(path);
+    if (it != g_plugins.end()) {
+        return it->second;
+    }
+
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        error = dlerror();
+        return nullptr;
+    }
+    auto plugin = static_cast<const myshell_plugin*>(dlsym(handle, MYSHELL_PLUGIN_SYMBOL));
+    if (plugin == nullptr) {
+        error = path + ": not a plugin (no " MYSHELL_PLUGIN_SYMBOL ")";
+        dlclose(handle);
+        return nullptr;
+    }
+    if (plugin->abi_version != MYSHELL_PLUGIN_ABI) {
+        error = path + ": built for plugin ABI " + std::to_string(plugin->abi_version) +
+                ", this shell has " + std::to_string(MYSHELL_PLUGIN_ABI);
+        dlclose(handle);
+        return nullptr;
+    }
+
+    g_plugins[path] = plugin;
+    return plugin;
+}
+
+bool load_plugin_builtin(const std::string& path, const std::string& name,
+                         BuiltinFunc& func, std::string& error) {
+    const myshell_plugin* plugin = open_plugin(path, error);
+    if (plugin == nullptr) {
+        return false;
+    }
+
+    for (const myshell_builtin* entry = plugin->builtins; entry != nullptr && entry->name != nullptr;
+         entry++) {
+        if (name == entry->name && entry->run != nullptr) {
+            myshell_builtin_fn run = entry->run;
+            func = [run](const std::vector<std::string>& args) { return call_plugin(run, args); };
+            return true;
+        }
+    }
+    error = "cannot find " + name + " in " + path;
+    return false;
+}
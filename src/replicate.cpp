@@ -0,0 +1,419 @@
+#include "replicate.h"
+#include "env.h"
+#include "executor.h"
+#include "signals.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static const size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+static const size_t READ_SIZE = 65536;
+
+// One running copy of the stage, with the replicator's ends of its pipes
+struct Copy {
+    pid_t pid = -1;                      // -1 once reaped
+    int in = -1;                         // Writes its input (-1 once closed)
+    int out = -1;                        // Reads its output (-1 at end of file)
+    std::string input;                   // Chunk being written to it
+    size_t written = 0;
+    std::string output;                  // Output not yet passed on
+
+    bool idle() const { return in != -1 && written == input.size(); }
+};
+
+// $MYSHELL_CHUNK_SIZE, with an optional K/M/G suffix
+static size_t chunk_size() {
+    std::string text = get_env("MYSHELL_CHUNK_SIZE");
+    if (text.empty()) {
+        return DEFAULT_CHUNK_SIZE;
+    }
+    char* end;
+    unsigned long long size = strtoull(text.c_str(), &end, 10);
+    switch (*end) {
+        case 'G': case 'g': size <<= 10; // Fall through
+        case 'M': case 'm': size <<= 10; // Fall through
+        case 'K': case 'k': size <<= 10; break;
+        default: break;
+    }
+    return size > 0 ? static_cast<size_t>(size) : DEFAULT_CHUNK_SIZE;
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void close_fd(int& fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// ============================================================================
+// Replicator
+// ============================================================================
+
+class Replicator {
+public:
+    explicit Replicator(const Command& cmd)
+        : limit_(cmd.replicas), ordered_(!cmd.unordered), chunk_size_(chunk_size()),
+          hold_limit_(limit_ * chunk_size_) {
+        // The copies run the bare command: its redirections are already
+        // in place around this process
+        job_.args = cmd.args;
+        job_.assignments = cmd.assignments;
+        job_.body = cmd.body;
+        job_.body_entry = cmd.body_entry;
+        job_.alias_expanded = cmd.alias_expanded;
+    }
+
+    int run() {
+        while (true) {
+            dispatch();
+            if (eof_ && pending_.empty()) {
+                if (!started_ && !failed_) {
+                    start_copy(std::string());
+                }
+                for (auto& copy : copies_) {
+                    if (copy.idle()) close_fd(copy.in);
+                }
+            }
+            if (!emit()) {
+                return stop(128 + SIGPIPE);
+            }
+            if (eof_ && pending_.empty() && copies_.empty()) {
+                break;
+            }
+            wait_for_io();
+        }
+        if (failed_) {
+            return ERR_FORK_FAILED;
+        }
+        return any_ok_ ? SHELL_OK : status_;
+    }
+
+private:
+    Command job_;
+    size_t limit_;
+    bool ordered_;
+    size_t chunk_size_;
+    size_t hold_limit_;                  // Ordered: most output held back
+    std::deque<Copy> copies_;            // Ordered: oldest chunk first
+    std::string pending_;                // Input not yet handed out
+    bool eof_ = false;
+    bool started_ = false;
+    bool failed_ = false;
+    bool any_ok_ = false;
+    int status_ = SHELL_OK;
+
+    // A complete chunk is buffered (or whatever is left at end of input)
+    bool have_chunk() const {
+        if (pending_.empty()) {
+            return false;
+        }
+        return eof_ || (pending_.size() >= chunk_size_ &&
+                        pending_.find('\n', chunk_size_ - 1) != std::string::npos);
+    }
+
+    std::string take_chunk() {
+        size_t end = eof_ ? std::string::npos : pending_.find('\n', chunk_size_ - 1);
+        if (end == std::string::npos) {
+            std::string chunk;
+            chunk.swap(pending_);
+            return chunk;
+        }
+        std::string chunk = pending_.substr(0, end + 1);
+        pending_.erase(0, end + 1);
+        return chunk;
+    }
+
+    // Copies still producing output (finished ones waiting for their turn
+    // to be written do not count against the limit)
+    size_t running() const {
+        size_t count = 0;
+        for (const auto& copy : copies_) {
+            if (copy.out != -1) count++;
+        }
+        return count;
+    }
+
+    // Ordered: the output of copies behind the oldest one has filled the
+    // space for it. Until that copy finishes no new copy starts and the
+    // others are not read, so they block on their output pipes and the
+    // input stops being read.
+    bool held_full() const {
+        if (!ordered_) {
+            return false;
+        }
+        size_t held = 0;
+        for (size_t i = 1; i < copies_.size(); i++) {
+            held += copies_[i].output.size();
+        }
+        return held >= hold_limit_;
+    }
+
+    Copy* idle_copy() {
+        for (auto& copy : copies_) {
+            if (copy.idle()) return &copy;
+        }
+        return nullptr;
+    }
+
+    // Hand out every complete chunk there is a copy for
+    void dispatch() {
+        while (have_chunk()) {
+            Copy* idle = ordered_ ? nullptr : idle_copy();
+            if (idle != nullptr) {
+                idle->input = take_chunk();
+                idle->written = 0;
+            } else if (ordered_ ? running() < limit_ && !held_full() : copies_.size() < limit_) {
+                if (!start_copy(take_chunk())) {
+                    return;
+                }
+            } else {
+                return;
+            }
+        }
+    }
+
+    bool start_copy(std::string chunk) {
+        started_ = true;
+        int in[2];
+        int out[2];
+        if (pipe2(in, O_CLOEXEC) == -1) {
+            return fail("pipe");
+        }
+        if (pipe2(out, O_CLOEXEC) == -1) {
+            close(in[0]);
+            close(in[1]);
+            return fail("pipe");
+        }
+
+        pid_t pid = fork();
+        if (pid == -1) {
+            close(in[0]);
+            close(in[1]);
+            close(out[0]);
+            close(out[1]);
+            return fail("fork");
+        }
+
+        if (pid == 0) {
+            // === CHILD PROCESS ===
+            setup_child_signals();
+            signal(SIGPIPE, SIG_DFL);
+            for (auto& copy : copies_) {
+                close_fd(copy.in);       // Would keep other copies' pipes open
+                close_fd(copy.out);
+            }
+            dup2(in[0], STDIN_FILENO);
+            dup2(out[1], STDOUT_FILENO);
+            close(in[0]);
+            close(in[1]);
+            close(out[0]);
+            close(out[1]);
+            Command job = job_;
+            run_in_child(job);
+        }
+
+        // === PARENT PROCESS ===
+        close(in[0]);
+        close(out[1]);
+        fcntl(in[1], F_SETFL, fcntl(in[1], F_GETFL) | O_NONBLOCK);
+        fcntl(out[0], F_SETFL, fcntl(out[0], F_GETFL) | O_NONBLOCK);
+
+        Copy copy;
+        copy.pid = pid;
+        copy.in = in[1];
+        copy.out = out[0];
+        copy.input = std::move(chunk);
+        copies_.push_back(std::move(copy));
+        return true;
+    }
+
+    // No more copies can start: drop the rest of the input and let the
+    // running ones finish
+    bool fail(const char* what) {
+        shell_perror(what);
+        failed_ = true;
+        eof_ = true;
+        pending_.clear();
+        return false;
+    }
+
+    void reap(Copy& copy) {
+        int status = wait_for_child(copy.pid);
+        copy.pid = -1;
+        if (status == SHELL_OK) {
+            any_ok_ = true;
+        } else {
+            status_ = status;
+        }
+    }
+
+    void read_input() {
+        size_t used = pending_.size();
+        pending_.resize(used + READ_SIZE);
+        ssize_t n = read(STDIN_FILENO, &pending_[used], READ_SIZE);
+        pending_.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+        if (n == 0 || (n == -1 && errno != EINTR && errno != EAGAIN)) {
+            eof_ = true;
+        }
+    }
+
+    void write_input(Copy& copy) {
+        ssize_t n = write(copy.in, copy.input.data() + copy.written, copy.input.size() - copy.written);
+        if (n > 0) {
+            copy.written += static_cast<size_t>(n);
+        } else if (n == -1 && errno != EINTR && errno != EAGAIN) {
+            copy.written = copy.input.size();    // It stopped reading (EPIPE)
+            close_fd(copy.in);
+        }
+        if (ordered_ && copy.written == copy.input.size()) {
+            close_fd(copy.in);                   // One chunk per copy
+        }
+        if (copy.written == copy.input.size()) {
+            copy.input.clear();
+            copy.written = 0;
+        }
+    }
+
+    void read_output(Copy& copy) {
+        char buf[READ_SIZE];
+        ssize_t n = read(copy.out, buf, sizeof(buf));
+        if (n > 0) {
+            copy.output.append(buf, static_cast<size_t>(n));
+        } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+            // Its output is finished, so nothing more of its input matters
+            close_fd(copy.out);
+            close_fd(copy.in);
+            reap(copy);
+        }
+    }
+
+    // Pass on whatever output may go out now; false if stdout is gone
+    bool emit() {
+        if (ordered_) {
+            while (!copies_.empty()) {
+                Copy& head = copies_.front();
+                if (!head.output.empty()) {
+                    if (!write_all(STDOUT_FILENO, head.output.data(), head.output.size())) {
+                        return false;
+                    }
+                    head.output.clear();
+                }
+                if (head.pid != -1) {
+                    break;
+                }
+                copies_.pop_front();
+            }
+            return true;
+        }
+
+        for (auto it = copies_.begin(); it != copies_.end();) {
+            // Whole lines only, until the copy has finished
+            size_t end = it->output.size();
+            if (it->pid != -1) {
+                size_t newline = it->output.rfind('\n');
+                end = newline == std::string::npos ? 0 : newline + 1;
+            }
+            if (end > 0) {
+                if (!write_all(STDOUT_FILENO, it->output.data(), end)) {
+                    return false;
+                }
+                it->output.erase(0, end);
+            }
+            it = it->pid == -1 ? copies_.erase(it) : it + 1;
+        }
+        return true;
+    }
+
+    void wait_for_io() {
+        std::vector<struct pollfd> fds;
+        std::vector<Copy*> owners;       // Copy of each entry (null: stdin)
+        bool full = held_full();
+        if (!eof_ && !have_chunk()) {
+            fds.push_back({STDIN_FILENO, POLLIN, 0});
+            owners.push_back(nullptr);
+        }
+        for (auto& copy : copies_) {
+            if (copy.in != -1 && copy.written < copy.input.size()) {
+                fds.push_back({copy.in, POLLOUT, 0});
+                owners.push_back(&copy);
+            }
+            if (copy.out != -1 && (!full || &copy == &copies_.front())) {
+                fds.push_back({copy.out, POLLIN, 0});
+                owners.push_back(&copy);
+            }
+        }
+        if (fds.empty()) {
+            return;
+        }
+        if (poll(fds.data(), fds.size(), -1) <= 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Copy* copy = owners[i];
+            if (copy == nullptr) {
+                read_input();
+            } else if (fds[i].events == POLLOUT) {
+                if (copy->in == fds[i].fd) write_input(*copy);
+            } else if (copy->out == fds[i].fd) {
+                read_output(*copy);
+            }
+        }
+    }
+
+    // Standard output went away: stop the copies as a pipe would
+    int stop(int status) {
+        for (auto& copy : copies_) {
+            close_fd(copy.in);
+            close_fd(copy.out);
+        }
+        for (auto& copy : copies_) {
+            if (copy.pid != -1) {
+                kill(copy.pid, SIGPIPE);
+                wait_for_child(copy.pid);
+            }
+        }
+        return status;
+    }
+};
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+int run_replicated(const Command& cmd) {
+    // This process reaps its own copies, and sees EPIPE rather than dying
+    // when one of them stops reading early
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    signal(SIGPIPE, SIG_IGN);
+
+    Replicator replicator(cmd);
+    return replicator.run();
+}
@@ -0,0 +1,907 @@
+#include "result_cache.h"
+#include "env.h"
+#include "executor.h"
+#include "script_cache.h"
+#include "shell.h"
+#include "signals.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char ENTRY_MAGIC[] = "MYSHRES1";
+static const uint64_t DEFAULT_LIMIT = 256ULL << 20;
+static const size_t CHUNK_SIZE = 65536;
+static const size_t MAX_TREE_ENTRIES = 20000;
+static const unsigned MAX_COLLISIONS = 16;
+static const off_t INDEX_COMPACT_SIZE = 1 << 20;
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+// 64-bit FNV-1a, fed in pieces
+class Hasher {
+public:
+    void add(const char* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            h_ ^= static_cast<unsigned char>(data[i]);
+            h_ *= 1099511628211ULL;
+        }
+    }
+
+    uint64_t value() const { return h_; }
+
+private:
+    uint64_t h_ = 1469598103934665603ULL;
+};
+
+static std::string hex(uint64_t hash) {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+// ============================================================================
+// Store Layout
+// ============================================================================
+//
+//   results/objects/HASH     output, named after a hash of its content
+//                            (HASH.N for other content with that hash)
+//   results/entries/HASH     per key: magic, status, stdout and stderr
+//                            object names (one per line), then the key
+//   results/index            sizes, references and use order (see below)
+//   results/lock             taken while the index is rewritten
+//   results/stats            hit, miss and eviction counters
+//
+// Files are written under a temporary name and renamed into place.
+
+struct Store {
+    std::string root;
+    std::string objects;
+    std::string entries;
+};
+
+static bool open_store(Store& store) {
+    std::string dir = cache_dir();
+    if (dir.empty()) {
+        return false;
+    }
+    store.root = dir + "/results";
+    store.objects = store.root + "/objects";
+    store.entries = store.root + "/entries";
+    return make_dirs(store.objects) && make_dirs(store.entries);
+}
+
+// A fresh file for this process to fill; -1 on failure
+static int create_temp(const std::string& dir, std::string& path) {
+    static unsigned counter = 0;
+    path = dir + "/.tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+    return open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+
+static std::vector<std::string> list_dir(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return names;
+    }
+    while (struct dirent* ent = readdir(d)) {
+        if (ent->d_name[0] != '.') {
+            names.push_back(ent->d_name);
+        }
+    }
+    closedir(d);
+    return names;
+}
+
+// ============================================================================
+// File I/O
+// ============================================================================
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Copy `from` to `to` until end of file, hashing what passes if asked
+static bool copy_fd(int from, int to, Hasher* hasher) {
+    static std::string chunk(CHUNK_SIZE, '\0');
+    while (true) {
+        ssize_t n = read(from, &chunk[0], chunk.size());
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n == 0;
+        }
+        if (hasher != nullptr) {
+            hasher->add(chunk.data(), static_cast<size_t>(n));
+        }
+        if (to != -1 && !write_all(to, chunk.data(), static_cast<size_t>(n))) {
+            return false;
+        }
+    }
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    out.clear();
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0 || (n == -1 && errno == EINTR)) {
+        if (n > 0) {
+            out.append(buf, static_cast<size_t>(n));
+        }
+    }
+    close(fd);
+    return n == 0;
+}
+
+static void write_file(const Store& store, const std::string& path, const std::string& data) {
+    std::string tmp;
+    int fd = create_temp(store.root, tmp);
+    if (fd == -1) {
+        return;
+    }
+    bool ok = write_all(fd, data.data(), data.size());
+    if (close(fd) == 0 && ok) {
+        rename(tmp.c_str(), path.c_str());
+    } else {
+        unlink(tmp.c_str());
+    }
+}
+
+// ============================================================================
+// Statistics
+// ============================================================================
+// Updated without locking: concurrent runs may lose a count, never an entry
+
+struct Stats {
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+};
+
+static Stats load_stats(const Store& store) {
+    Stats stats;
+    std::string text;
+    if (read_file(store.root + "/stats", text)) {
+        sscanf(text.c_str(), "hits %llu misses %llu evictions %llu",
+               &stats.hits, &stats.misses, &stats.evictions);
+    }
+    return stats;
+}
+
+static void save_stats(const Store& store, const Stats& stats) {
+    write_file(store, store.root + "/stats",
+               "hits " + std::to_string(stats.hits) + "\nmisses " + std::to_string(stats.misses) +
+               "\nevictions " + std::to_string(stats.evictions) + "\n");
+}
+
+// ============================================================================
+// Keys
+// ============================================================================
+
+static void add_field(std::string& key, const char* tag, const std::string& value) {
+    key += tag;
+    key += '\0';
+    key += value;
+    key += '\0';
+}
+
+static std::string identity(const struct stat& st) {
+    return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+           std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + "." +
+           std::to_string(st.st_mtim.tv_nsec);
+}
+
+// Hash the path and identity of everything below `dir`, in name order.
+// Symbolic links are not followed into, but what they point at counts.
+// False once the tree has more than MAX_TREE_ENTRIES entries.
+static bool hash_tree(const std::string& dir, const std::string& relative, Hasher& hasher,
+                      size_t& count) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return true;
+    }
+    while (struct dirent* ent = readdir(d)) {
+        if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0) {
+            names.push_back(ent->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (const auto& name : names) {
+        if (++count > MAX_TREE_ENTRIES) {
+            return false;
+        }
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) {
+            continue;
+        }
+        std::string record = relative + name + '\0' + identity(st) + '\0';
+        struct stat target;
+        if (S_ISLNK(st.st_mode) && stat(path.c_str(), &target) == 0) {
+            record += identity(target) + '\0';
+        }
+        hasher.add(record.data(), record.size());
+        if (S_ISDIR(st.st_mode) && !hash_tree(path, relative + name + "/", hasher, count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An existing file contributes its identity, a directory that of every
+// entry below it. `complete` is cleared if a directory was too large to
+// take in.
+static void add_path(std::string& key, const std::string& path, bool& complete) {
+    struct stat st;
+    if (path.empty() || stat(path.c_str(), &st) != 0 ||
+        !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))) {
+        return;
+    }
+    add_field(key, "file", path);
+    add_field(key, "", identity(st));
+    if (S_ISDIR(st.st_mode)) {
+        Hasher hasher;
+        size_t count = 0;
+        if (!hash_tree(path, "", hasher, count)) {
+            complete = false;
+        }
+        add_field(key, "tree", hex(hasher.value()) + ":" + std::to_string(count));
+    }
+}
+
+// The argument itself, and each word inside it that could be a path
+static void add_argument_paths(std::string& key, const std::string& arg, bool& complete) {
+    add_path(key, arg, complete);
+    static const char* SEPARATORS = " \t\n=<>|;&()'\",";
+    if (arg.find_first_of(SEPARATORS) == std::string::npos) {
+        return;
+    }
+    size_t start = 0;
+    while (start < arg.size()) {
+        size_t end = arg.find_first_of(SEPARATORS, start);
+        if (end == std::string::npos) {
+            end = arg.size();
+        }
+        if (end > start) {
+            add_path(key, arg.substr(start, end - start), complete);
+        }
+        start = end + 1;
+    }
+}
+
+static std::string find_in_path(const std::string& name) {
+    if (name.find('/') != std::string::npos) {
+        return name;
+    }
+    std::string path = get_env("PATH");
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find(':', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        std::string dir = end > start ? path.substr(start, end - start) : ".";
+        std::string candidate = dir + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+// Standard input's part of the key. A pipe is drained into a file in the
+// store first, which `stdin_fd` is left open on for the command to read:
+// whether the command reads it cannot be told from its arguments (awk -f
+// prog.awk does), so a command that must leave it alone needs -n.
+static bool add_stdin(std::string& key, const Store& store, int& stdin_fd,
+                      std::string& stdin_path) {
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) == -1) {
+        add_field(key, "stdin", "closed");
+        return true;
+    }
+    if (S_ISREG(st.st_mode)) {
+        add_field(key, "stdin", identity(st) + "@" +
+                  std::to_string(lseek(STDIN_FILENO, 0, SEEK_CUR)));
+        return true;
+    }
+    if (!S_ISFIFO(st.st_mode) && !S_ISSOCK(st.st_mode)) {
+        add_field(key, "stdin", "device " + std::to_string(st.st_rdev));
+        return true;
+    }
+    stdin_fd = create_temp(store.root, stdin_path);
+    Hasher hasher;
+    if (stdin_fd == -1 || !copy_fd(STDIN_FILENO, stdin_fd, &hasher)) {
+        shell_perror("cached: standard input");
+        return false;
+    }
+    lseek(stdin_fd, 0, SEEK_SET);
+    add_field(key, "stdin", "data " + hex(hasher.value()) + ":" +
+              std::to_string(lseek(stdin_fd, 0, SEEK_END)));
+    lseek(stdin_fd, 0, SEEK_SET);
+    return true;
+}
+
+// The key without standard input; false if an input is a directory too
+// large to key on
+static bool build_key(const std::vector<std::string>& argv,
+                      const std::vector<std::string>& env_names,
+                      const std::vector<std::string>& files, std::string& key) {
+    bool complete = true;
+    for (const auto& arg : argv) {
+        add_field(key, "arg", arg);
+    }
+
+    char cwd[4096];
+    add_field(key, "cwd", getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "");
+    add_field(key, "exe", find_in_path(argv[0]));
+    add_path(key, find_in_path(argv[0]), complete);
+
+    for (const auto& var : get_all_env()) {
+        if (var.first == "PATH" || var.first == "LANG" || var.first.compare(0, 3, "LC_") == 0) {
+            add_field(key, "env", var.first + "=" + var.second);
+        }
+    }
+    for (const auto& name : env_names) {
+        add_field(key, "var", name + (env_is_set(name) ? "=" + get_env(name) : ""));
+    }
+
+    for (size_t i = 1; i < argv.size(); i++) {
+        add_argument_paths(key, argv[i], complete);
+    }
+    for (const auto& file : files) {
+        add_field(key, "input", file);
+        add_path(key, file, complete);
+    }
+    return complete;
+}
+
+// ============================================================================
+// Entries
+// ============================================================================
+
+struct Entry {
+    int status = 0;
+    std::string out;                     // Object names
+    std::string err;
+    std::string key;
+};
+
+static std::string encode_entry(const Entry& entry) {
+    return std::string(ENTRY_MAGIC) + "\n" + std::to_string(entry.status) + "\n" +
+           entry.out + "\n" + entry.err + "\n" + entry.key;
+}
+
+static bool decode_entry(const std::string& data, Entry& entry) {
+    size_t pos = 0;
+    std::string lines[4];
+    for (auto& line : lines) {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            return false;
+        }
+        line = data.substr(pos, end - pos);
+        pos = end + 1;
+    }
+    if (lines[0] != ENTRY_MAGIC) {
+        return false;
+    }
+    entry.status = atoi(lines[1].c_str());
+    entry.out = lines[2];
+    entry.err = lines[3];
+    entry.key = data.substr(pos);
+    return true;
+}
+
+// Write the stored output of a matching entry; false if there is none
+static bool replay(const Store& store, const std::string& entry_path, const std::string& key,
+                   int& status) {
+    std::string data;
+    Entry entry;
+    if (!read_file(entry_path, data) || !decode_entry(data, entry) || entry.key != key) {
+        return false;
+    }
+    int out = open((store.objects + "/" + entry.out).c_str(), O_RDONLY | O_CLOEXEC);
+    int err = open((store.objects + "/" + entry.err).c_str(), O_RDONLY | O_CLOEXEC);
+    bool found = out != -1 && err != -1;
+    if (found) {
+        copy_fd(out, STDOUT_FILENO, nullptr);
+        copy_fd(err, STDERR_FILENO, nullptr);
+        status = entry.status;
+    }
+    if (out != -1) close(out);
+    if (err != -1) close(err);
+    return found;
+}
+
+// Read up to `size` bytes, fewer only at end of file; -1 on error
+static ssize_t read_full(int fd, char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+// True if `path` holds exactly the bytes of the open file `fd`
+static bool same_content(int fd, const std::string& path) {
+    int other = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat mine_st, theirs_st;
+    bool same = other != -1 && fstat(fd, &mine_st) == 0 && fstat(other, &theirs_st) == 0 &&
+                mine_st.st_size == theirs_st.st_size;
+    static std::string mine(CHUNK_SIZE, '\0');
+    static std::string theirs(CHUNK_SIZE, '\0');
+    lseek(fd, 0, SEEK_SET);
+    while (same) {
+        ssize_t n = read_full(fd, &mine[0], mine.size());
+        ssize_t m = read_full(other, &theirs[0], theirs.size());
+        same = n >= 0 && n == m && memcmp(mine.data(), theirs.data(), static_cast<size_t>(n)) == 0;
+        if (n <= 0) {
+            break;
+        }
+    }
+    if (other != -1) close(other);
+    return same;
+}
+
+// Move a finished output file into the store under its content hash. An
+// existing object is only reused if its bytes match; other content with
+// the same hash goes under HASH.1, HASH.2 and so on. False if it could not
+// be stored.
+static bool store_object(const Store& store, int fd, const std::string& tmp, std::string& name) {
+    Hasher hasher;
+    lseek(fd, 0, SEEK_SET);
+    copy_fd(fd, -1, &hasher);
+    std::string hash = hex(hasher.value());
+    bool stored = false;
+    for (unsigned n = 0; n < MAX_COLLISIONS && !stored; n++) {
+        name = n == 0 ? hash : hash + "." + std::to_string(n);
+        std::string path = store.objects + "/" + name;
+        if (link(tmp.c_str(), path.c_str()) == 0) {
+            stored = true;
+        } else if (errno != EEXIST) {
+            break;
+        } else {
+            stored = same_content(fd, path);
+        }
+    }
+    unlink(tmp.c_str());
+    return stored;
+}
+
+static uint64_t size_limit() {
+    const char* text = getenv("MYSHELL_RESULT_CACHE_SIZE");
+    if (text == nullptr || text[0] == '\0') {
+        return DEFAULT_LIMIT;
+    }
+    char* end;
+    uint64_t limit = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': limit <<= 10; // Fall through
+        case 'M': case 'm': limit <<= 10; // Fall through
+        case 'K': case 'k': limit <<= 10; break;
+        default: break;
+    }
+    return limit;
+}
+
+static off_t file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// ============================================================================
+// Index
+// ============================================================================
+// One line per record, so that no run has to read the entries themselves:
+//
+//   object NAME BYTES
+//   entry NAME BYTES OUT ERR     least recently used first
+//   use NAME                     appended by a hit; the entry is now newest
+//
+// A miss (or a hit that finds the index grown too long) takes the lock,
+// loads the index, records its entry, evicts and writes it back whole.
+// A store without an index is scanned once to rebuild it.
+
+struct IndexEntry {
+    uint64_t bytes = 0;
+    std::string out;                     // Object names
+    std::string err;
+    uint64_t used = 0;                   // Higher is more recent
+};
+
+struct Index {
+    std::map<std::string, IndexEntry> entries;
+    std::map<std::string, uint64_t> objects;   // Name -> size
+    uint64_t clock = 0;
+};
+
+static bool load_index(const Store& store, Index& index) {
+    std::string text;
+    if (!read_file(store.root + "/index", text)) {
+        return false;
+    }
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::string kind, name;
+        fields >> kind >> name;
+        if (kind == "object") {
+            fields >> index.objects[name];
+        } else if (kind == "entry") {
+            IndexEntry& entry = index.entries[name];
+            fields >> entry.bytes >> entry.out >> entry.err;
+            entry.used = ++index.clock;
+        } else if (kind == "use") {
+            auto it = index.entries.find(name);
+            if (it != index.entries.end()) it->second.used = ++index.clock;
+        }
+    }
+    return true;
+}
+
+// Rebuild the index from the store's contents, entries ordered by mtime
+static void scan_store(const Store& store, Index& index) {
+    std::vector<std::pair<struct timespec, std::string>> written;
+    for (const auto& name : list_dir(store.entries)) {
+        std::string path = store.entries + "/" + name;
+        struct stat st;
+        std::string data;
+        Entry entry;
+        if (stat(path.c_str(), &st) == 0 && read_file(path, data) && decode_entry(data, entry)) {
+            IndexEntry& item = index.entries[name];
+            item.bytes = static_cast<uint64_t>(st.st_size);
+            item.out = entry.out;
+            item.err = entry.err;
+            written.push_back({st.st_mtim, name});
+        } else {
+            unlink(path.c_str());
+        }
+    }
+    std::sort(written.begin(), written.end(), [](const auto& a, const auto& b) {
+        return a.first.tv_sec != b.first.tv_sec ? a.first.tv_sec < b.first.tv_sec
+                                                : a.first.tv_nsec < b.first.tv_nsec;
+    });
+    for (const auto& item : written) {
+        index.entries[item.second].used = ++index.clock;
+    }
+    for (const auto& name : list_dir(store.objects)) {
+        index.objects[name] = static_cast<uint64_t>(file_size(store.objects + "/" + name));
+    }
+}
+
+static void save_index(const Store& store, const Index& index) {
+    std::vector<std::pair<uint64_t, std::string>> order;
+    std::string text;
+    for (const auto& object : index.objects) {
+        text += "object " + object.first + " " + std::to_string(object.second) + "\n";
+    }
+    for (const auto& entry : index.entries) {
+        order.push_back({entry.second.used, entry.first});
+    }
+    std::sort(order.begin(), order.end());
+    for (const auto& item : order) {
+        const IndexEntry& entry = index.entries.at(item.second);
+        text += "entry " + item.second + " " + std::to_string(entry.bytes) + " " + entry.out +
+                " " + entry.err + "\n";
+    }
+    write_file(store, store.root + "/index", text);
+}
+
+// Record a hit; returns the index's size afterwards (0 if there is none)
+static off_t note_use(const Store& store, const std::string& name) {
+    int fd = open((store.root + "/index").c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+    std::string line = "use " + name + "\n";
+    write_all(fd, line.data(), line.size());
+    struct stat st;
+    off_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    close(fd);
+    return size;
+}
+
+// Drop least recently used entries, and objects no entry refers to, until
+// the store fits its limit; returns how many entries were dropped
+static unsigned evict(const Store& store, Index& index, uint64_t limit) {
+    uint64_t total = 0;
+    std::map<std::string, int> refs;     // Object -> entries using it
+    for (const auto& object : index.objects) {
+        refs[object.first] = 0;
+        total += object.second;
+    }
+    for (const auto& entry : index.entries) {
+        refs[entry.second.out]++;
+        refs[entry.second.err]++;
+        total += entry.second.bytes;
+    }
+
+    auto release = [&](const std::string& object) {
+        auto it = refs.find(object);
+        if (it != refs.end() && --it->second <= 0) {
+            auto known = index.objects.find(object);
+            if (known != index.objects.end()) {
+                total -= std::min(total, known->second);
+                index.objects.erase(known);
+            }
+            unlink((store.objects + "/" + object).c_str());
+            refs.erase(it);
+        }
+    };
+
+    // Orphans left behind by interrupted runs go first
+    std::vector<std::string> orphans;
+    for (const auto& ref : refs) {
+        if (ref.second == 0) orphans.push_back(ref.first);
+    }
+    for (const auto& object : orphans) {
+        refs[object] = 1;
+        release(object);
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> order;
+    for (const auto& entry : index.entries) {
+        order.push_back({entry.second.used, entry.first});
+    }
+    std::sort(order.begin(), order.end());
+    unsigned evicted = 0;
+    for (const auto& item : order) {
+        if (total <= limit) {
+            break;
+        }
+        IndexEntry entry = index.entries.at(item.second);
+        index.entries.erase(item.second);
+        total -= std::min(total, entry.bytes);
+        unlink((store.entries + "/" + item.second).c_str());
+        release(entry.out);
+        release(entry.err);
+        evicted++;
+    }
+    return evicted;
+}
+
+// Under the store lock: record the entry `name` (if given), evict down to
+// `limit` and write the index back; returns how many entries were evicted
+static unsigned update_index(const Store& store, const std::string& name,
+                             const IndexEntry* added, uint64_t limit) {
+    int lock = open((store.root + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock != -1) {
+        flock(lock, LOCK_EX);
+    }
+    Index index;
+    if (!load_index(store, index)) {
+        scan_store(store, index);
+    }
+    if (added != nullptr) {
+        IndexEntry& entry = index.entries[name];
+        entry = *added;
+        entry.used = ++index.clock;
+        for (const auto& object : {entry.out, entry.err}) {
+            index.objects[object] = static_cast<uint64_t>(file_size(store.objects + "/" + object));
+        }
+    }
+    unsigned evicted = evict(store, index, limit);
+    save_index(store, index);
+    if (lock != -1) {
+        close(lock);                     // Releases the lock
+    }
+    return evicted;
+}
+
+// ============================================================================
+// Running
+// ============================================================================
+
+// Run the command in a child with the given descriptors (-1: inherited)
+static int run_command(const std::vector<std::string>& argv, int in, int out, int err) {
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        shell_perror("fork");
+        restore_sigmask(&old_mask);
+        return ERR_FORK_FAILED;
+    }
+
+    if (pid == 0) {
+        // === CHILD PROCESS ===
+        setup_child_signals();
+        if (in != -1) dup2(in, STDIN_FILENO);
+        if (out != -1) dup2(out, STDOUT_FILENO);
+        if (err != -1) dup2(err, STDERR_FILENO);
+        Command cmd;
+        cmd.args = argv;
+        run_in_child(cmd);
+    }
+
+    // === PARENT PROCESS ===
+    int status = wait_for_child(pid);
+    restore_sigmask(&old_mask);
+    return status;
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+int cached_run(const std::vector<std::string>& argv, const std::vector<std::string>& env_names,
+               const std::vector<std::string>& files, bool no_stdin) {
+    int stdin_fd = no_stdin ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+    Store store;
+    std::string key;
+    if (!open_store(store) || !build_key(argv, env_names, files, key)) {
+        int status = run_command(argv, stdin_fd, -1, -1);
+        if (stdin_fd != -1) close(stdin_fd);
+        return status;
+    }
+
+    std::string stdin_path;
+    if (no_stdin) {
+        add_field(key, "stdin", "null");
+    } else if (!add_stdin(key, store, stdin_fd, stdin_path)) {
+        if (stdin_fd != -1) {
+            close(stdin_fd);
+            unlink(stdin_path.c_str());
+        }
+        return 1;
+    }
+    if (!stdin_path.empty()) {
+        unlink(stdin_path.c_str());      // Kept open until the command is done
+    }
+
+    Hasher hasher;
+    hasher.add(key.data(), key.size());
+    std::string entry_name = hex(hasher.value());
+    std::string entry_path = store.entries + "/" + entry_name;
+    Stats stats = load_stats(store);
+
+    int status;
+    if (replay(store, entry_path, key, status)) {
+        if (stdin_fd != -1) close(stdin_fd);
+        if (note_use(store, entry_name) > INDEX_COMPACT_SIZE) {
+            stats.evictions += update_index(store, "", nullptr, size_limit());
+        }
+        stats.hits++;
+        save_stats(store, stats);
+        return status;
+    }
+
+    std::string out_path, err_path;
+    int out = create_temp(store.objects, out_path);
+    int err = create_temp(store.objects, err_path);
+    if (out == -1 || err == -1) {
+        if (out != -1) { close(out); unlink(out_path.c_str()); }
+        if (err != -1) { close(err); unlink(err_path.c_str()); }
+        status = run_command(argv, stdin_fd, -1, -1);
+        if (stdin_fd != -1) close(stdin_fd);
+        return status;
+    }
+
+    status = run_command(argv, stdin_fd, out, err);
+    if (stdin_fd != -1) close(stdin_fd);
+
+    lseek(out, 0, SEEK_SET);
+    lseek(err, 0, SEEK_SET);
+    copy_fd(out, STDOUT_FILENO, nullptr);
+    copy_fd(err, STDERR_FILENO, nullptr);
+
+    if (status < 128 && !g_interrupted) {
+        Entry entry;
+        entry.status = status;
+        bool stored = store_object(store, out, out_path, entry.out);
+        stored = store_object(store, err, err_path, entry.err) && stored;
+        entry.key = key;
+        if (stored) {
+            std::string data = encode_entry(entry);
+            write_file(store, entry_path, data);
+            IndexEntry record;
+            record.bytes = data.size();
+            record.out = entry.out;
+            record.err = entry.err;
+            stats.evictions += update_index(store, entry_name, &record, size_limit());
+        }
+    } else {
+        unlink(out_path.c_str());
+        unlink(err_path.c_str());
+    }
+    close(out);
+    close(err);
+
+    stats.misses++;
+    save_stats(store, stats);
+    return status;
+}
+
+int result_cache_stats() {
+    Store store;
+    if (!open_store(store)) {
+        std::cerr << "myshell: cached: the cache is disabled" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> entries = list_dir(store.entries);
+    std::vector<std::string> objects = list_dir(store.objects);
+    uint64_t size = 0;
+    for (const auto& name : entries) {
+        size += static_cast<uint64_t>(file_size(store.entries + "/" + name));
+    }
+    for (const auto& name : objects) {
+        size += static_cast<uint64_t>(file_size(store.objects + "/" + name));
+    }
+    Stats stats = load_stats(store);
+
+    std::cout << "directory  " << store.root << "\n"
+              << "entries    " << entries.size() << "\n"
+              << "objects    " << objects.size() << "\n"
+              << "size       " << size << " of " << size_limit() << " bytes\n"
+              << "hits       " << stats.hits << "\n"
+              << "misses     " << stats.misses << "\n"
+              << "evictions  " << stats.evictions << std::endl;
+    return 0;
+}
+
+int result_cache_clear() {
+    Store store;
+    if (!open_store(store)) {
+        return 0;
+    }
+    for (const auto& name : list_dir(store.entries)) {
+        unlink((store.entries + "/" + name).c_str());
+    }
+    for (const auto& name : list_dir(store.objects)) {
+        unlink((store.objects + "/" + name).c_str());
+    }
+    unlink((store.root + "/index").c_str());
+    unlink((store.root + "/stats").c_str());
+    return 0;
+}
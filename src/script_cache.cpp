@@ -0,0 +1,441 @@
+#include "script_cache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ============================================================================
+// File Format
+// ============================================================================
+//
+//   CacheHeader
+//   payload:  program, text
+//   program:  code, strings, word lists, redirect lists, pipelines,
+//             functions (each a nested program)
+//
+// Every value in the payload is a 32-bit integer or a length-prefixed byte
+// string, and tables refer to each other by index, so a file can be mapped
+// at any address. The script text is kept at the end to rule out hash
+// collisions.
+
+static const char CACHE_MAGIC[8] = {'M', 'Y', 'S', 'H', 'B', 'C', '\0', '\0'};
+static const uint32_t CACHE_VERSION = 14;       // Bump when Program changes
+static const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;                        // Written in host order
+    uint64_t text_hash;
+    uint64_t text_size;
+    uint64_t payload_size;
+    uint64_t payload_hash;
+};
+
+static uint64_t fnv1a(const char* data, size_t size) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// ============================================================================
+// Cache Location
+// ============================================================================
+
+std::string cache_dir() {
+    const char* dir = getenv("MYSHELL_CACHE_DIR");
+    if (dir != nullptr) {
+        return dir;
+    }
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg != nullptr && xdg[0] != '\0') {
+        return std::string(xdg) + "/myshell";
+    }
+    const char* home = getenv("HOME");
+    if (home != nullptr && home[0] != '\0') {
+        return std::string(home) + "/.cache/myshell";
+    }
+    return "";
+}
+
+static std::string cache_path(const std::string& dir, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.msc", static_cast<unsigned long long>(hash));
+    return dir + name;
+}
+
+bool make_dirs(const std::string& dir) {
+    for (size_t pos = 1; pos <= dir.size(); pos++) {
+        if (pos == dir.size() || dir[pos] == '/') {
+            std::string part = dir.substr(0, pos);
+            if (mkdir(part.c_str(), 0700) == -1 && errno != EEXIST) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+class Writer {
+public:
+    void u32(uint32_t v) {
+        out_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    void str(const std::string& s) {
+        u32(static_cast<uint32_t>(s.size()));
+        out_ += s;
+    }
+
+    void strings(const std::vector<std::string>& list) {
+        u32(static_cast<uint32_t>(list.size()));
+        for (const auto& s : list) str(s);
+    }
+
+    void redirects(const std::vector<Redirect>& list) {
+        u32(static_cast<uint32_t>(list.size()));
+        for (const auto& r : list) {
+            u32(r.type);
+            str(r.target);
+        }
+    }
+
+    const std::string& data() const { return out_; }
+
+private:
+    std::string out_;
+};
+
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool ok() const { return ok_; }
+    bool at_end() const { return p_ == end_; }
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        if (static_cast<size_t>(end_ - p_) < sizeof(v)) {
+            ok_ = false;
+            return 0;
+        }
+        memcpy(&v, p_, sizeof(v));
+        p_ += sizeof(v);
+        return v;
+    }
+
+    // Element count, rejecting counts the remaining bytes cannot hold
+    uint32_t count() {
+        uint32_t n = u32();
+        if (n > static_cast<size_t>(end_ - p_) / sizeof(uint32_t)) {
+            ok_ = false;
+            return 0;
+        }
+        return n;
+    }
+
+    std::string str() {
+        uint32_t n = u32();
+        if (!ok_ || n > static_cast<size_t>(end_ - p_)) {
+            ok_ = false;
+            return "";
+        }
+        std::string s(p_, n);
+        p_ += n;
+        return s;
+    }
+
+    std::vector<std::string> strings() {
+        std::vector<std::string> list(count());
+        for (auto& s : list) s = str();
+        return list;
+    }
+
+    std::vector<Redirect> redirects() {
+        std::vector<Redirect> list(count());
+        for (auto& r : list) {
+            uint32_t type = u32();
+            if (type > REDIR_DUP_ERR) ok_ = false;
+            r.type = static_cast<RedirType>(type);
+            r.target = str();
+        }
+        return list;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+static void encode_program(Writer& w, const Program& prog) {
+    w.u32(static_cast<uint32_t>(prog.code.size()));
+    for (const auto& in : prog.code) {
+        w.u32(in.op);
+        w.u32(in.a);
+        w.u32(in.b);
+    }
+
+    w.strings(prog.strings);
+
+    w.u32(static_cast<uint32_t>(prog.word_lists.size()));
+    for (const auto& list : prog.word_lists) w.strings(list);
+
+    w.u32(static_cast<uint32_t>(prog.redirect_lists.size()));
+    for (const auto& list : prog.redirect_lists) w.redirects(list);
+
+    w.u32(static_cast<uint32_t>(prog.pipelines.size()));
+    for (const auto& pipeline : prog.pipelines) {
+        w.u32(pipeline.background ? 1 : 0);
+        w.strings(pipeline.placement);
+        w.u32(static_cast<uint32_t>(pipeline.stages.size()));
+        for (const auto& stage : pipeline.stages) {
+            w.u32(static_cast<uint32_t>(stage.entry));
+            w.u32(stage.replicas);
+            w.u32(stage.unordered ? 1 : 0);
+            w.strings(stage.command.assigns);
+            w.strings(stage.command.words);
+            w.redirects(stage.command.redirects);
+        }
+    }
+
+    // Function bodies are complete programs of their own
+    w.u32(static_cast<uint32_t>(prog.functions.size()));
+    for (const auto& function : prog.functions) encode_program(w, function);
+}
+
+static std::string encode(const std::string& text, const Program& prog) {
+    Writer w;
+    encode_program(w, prog);
+    w.str(text);
+    return w.data();
+}
+
+// Check that every index in the program points inside its table, so a
+// damaged file can never send the VM out of bounds
+static bool validate(const Program& prog) {
+    size_t code_size = prog.code.size();
+    if (code_size == 0 || prog.code.back().op != OP_RETURN) {
+        return false;
+    }
+
+    for (const auto& in : prog.code) {
+        switch (in.op) {
+            case OP_RUN:
+            case OP_ASSIGN:
+                if (in.a >= prog.pipelines.size()) return false;
+                break;
+            case OP_JUMP:
+            case OP_JUMP_IF_FAIL:
+            case OP_JUMP_IF_OK:
+                if (in.a >= code_size) return false;
+                break;
+            case OP_JUMP_IF_SHADOWED:
+                if (in.a >= code_size || in.b >= prog.word_lists.size()) return false;
+                break;
+            case OP_LOOP_ENTER:
+                if (in.a != 0 && in.b >= prog.word_lists.size()) return false;
+                break;
+            case OP_EXPAND:
+            case OP_COND:
+                if (in.a >= prog.word_lists.size()) return false;
+                break;
+            case OP_NEXT:
+                if (in.a >= code_size || in.b >= prog.strings.size()) return false;
+                break;
+            case OP_REDIRECT:
+                if (in.a >= prog.redirect_lists.size() || in.b >= code_size) return false;
+                break;
+            case OP_ARITH:
+                if (in.a >= prog.strings.size()) return false;
+                break;
+            case OP_DEFINE:
+                if (in.a >= prog.functions.size() || in.b >= prog.strings.size()) return false;
+                break;
+            case OP_COPROC:
+                if (in.a >= prog.pipelines.size() || in.b >= prog.strings.size()) return false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (const auto& pipeline : prog.pipelines) {
+        if (pipeline.stages.empty()) return false;
+        for (const auto& stage : pipeline.stages) {
+            if (stage.entry >= static_cast<int32_t>(code_size)) return false;
+        }
+    }
+
+    for (const auto& function : prog.functions) {
+        if (!validate(function)) return false;
+    }
+    return true;
+}
+
+// Functions nest no deeper than this in a cache file
+static const int MAX_FUNCTION_NESTING = 64;
+
+static bool decode_program(Reader& r, Program& prog, int depth) {
+    prog.code.resize(r.count());
+    for (auto& in : prog.code) {
+        uint32_t op = r.u32();
+        if (op > OP_RETURN) return false;
+        in.op = static_cast<OpCode>(op);
+        in.a = r.u32();
+        in.b = r.u32();
+    }
+
+    prog.strings = r.strings();
+
+    prog.word_lists.resize(r.count());
+    for (auto& list : prog.word_lists) list = r.strings();
+
+    prog.redirect_lists.resize(r.count());
+    for (auto& list : prog.redirect_lists) list = r.redirects();
+
+    prog.pipelines.resize(r.count());
+    for (auto& pipeline : prog.pipelines) {
+        pipeline.background = r.u32() != 0;
+        pipeline.placement = r.strings();
+        pipeline.stages.resize(r.count());
+        for (auto& stage : pipeline.stages) {
+            stage.entry = static_cast<int32_t>(r.u32());
+            stage.replicas = r.u32();
+            stage.unordered = r.u32() != 0;
+            stage.command.assigns = r.strings();
+            stage.command.words = r.strings();
+            stage.command.redirects = r.redirects();
+        }
+    }
+
+    prog.functions.resize(r.count());
+    if (!prog.functions.empty() && depth >= MAX_FUNCTION_NESTING) {
+        return false;
+    }
+    for (auto& function : prog.functions) {
+        if (!r.ok() || !decode_program(r, function, depth + 1)) return false;
+    }
+    return r.ok();
+}
+
+static bool decode(const char* data, size_t size, const std::string& text, Program& prog) {
+    Reader r(data, size);
+    if (!decode_program(r, prog, 0)) {
+        return false;
+    }
+    std::string cached_text = r.str();
+    return r.ok() && r.at_end() && cached_text == text && validate(prog);
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+bool script_cache_load(const std::string& text, Program& prog) {
+    std::string dir = cache_dir();
+    if (dir.empty()) {
+        return false;
+    }
+
+    uint64_t hash = fnv1a(text.data(), text.size());
+    int fd = open(cache_path(dir, hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(map);
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    bool loaded = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                  header.version == CACHE_VERSION &&
+                  header.byte_order == CACHE_BYTE_ORDER &&
+                  header.text_hash == hash &&
+                  header.text_size == text.size() &&
+                  header.payload_size == size - sizeof(header);
+    if (loaded) {
+        const char* payload = data + sizeof(header);
+        loaded = fnv1a(payload, header.payload_size) == header.payload_hash &&
+                 decode(payload, header.payload_size, text, prog);
+    }
+
+    munmap(map, size);
+    if (!loaded) {
+        prog = Program();
+    }
+    return loaded;
+}
+
+void script_cache_store(const std::string& text, const Program& prog) {
+    std::string dir = cache_dir();
+    if (dir.empty() || !make_dirs(dir)) {
+        return;
+    }
+
+    std::string payload = encode(text, prog);
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.text_hash = fnv1a(text.data(), text.size());
+    header.text_size = text.size();
+    header.payload_size = payload.size();
+    header.payload_hash = fnv1a(payload.data(), payload.size());
+
+    // Write a private temp file and rename it, so concurrent runs of the
+    // same script never see a half-written entry
+    std::string path = cache_path(dir, header.text_hash);
+    std::string tmp = path + "." + std::to_string(getpid()) + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return;
+    }
+
+    std::string file(reinterpret_cast<const char*>(&header), sizeof(header));
+    file += payload;
+
+    const char* p = file.data();
+    size_t left = file.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+
+    if (close(fd) == 0 && left == 0) {
+        rename(tmp.c_str(), path.c_str());
+    } else {
+        unlink(tmp.c_str());
+    }
+}
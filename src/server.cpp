@@ -0,0 +1,422 @@
+#include "server.h"
+#include "context.h"
+#include "env.h"
+#include "shell.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+static const uint32_t MAX_REQUEST = 16 << 20;
+static const int PASSED_FDS = 3;         // Standard input, output and error
+
+// ============================================================================
+// Socket I/O
+// ============================================================================
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool socket_address(const std::string& path, struct sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "myshell: " << path << ": socket path too long" << std::endl;
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// ============================================================================
+// Frames
+// ============================================================================
+
+// Send the length with the descriptors attached, then the payload
+static bool send_request(int sock, const std::string& payload, const int* fds, int nfds) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    struct iovec iov = {&length, sizeof(length)};
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int) * PASSED_FDS)];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    if (n < 1) {
+        return false;
+    }
+    // The descriptors went with the first byte; the rest is plain data
+    const char* rest = reinterpret_cast<const char*>(&length) + n;
+    return write_all(sock, rest, sizeof(length) - n) &&
+           write_all(sock, payload.data(), payload.size());
+}
+
+// Receive one frame; `fds` gets the passed descriptors (close-on-exec)
+static bool receive_request(int sock, std::string& payload, std::vector<int>& fds) {
+    uint32_t length = 0;
+    struct iovec iov = {&length, sizeof(length)};
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int) * PASSED_FDS)];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+    if (n < 1) {
+        return false;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* passed = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            fds.insert(fds.end(), passed, passed + count);
+        }
+    }
+
+    char* rest = reinterpret_cast<char*>(&length) + n;
+    if (!read_all(sock, rest, sizeof(length) - n) || length > MAX_REQUEST) {
+        return false;
+    }
+    payload.resize(length);
+    return read_all(sock, &payload[0], length);
+}
+
+// ============================================================================
+// Worker
+// ============================================================================
+
+// Split the payload into its NUL-terminated strings
+static std::vector<std::string> split_payload(const std::string& payload) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (start < payload.size()) {
+        size_t end = payload.find('\0', start);
+        if (end == std::string::npos) {
+            end = payload.size();
+        }
+        fields.push_back(payload.substr(start, end - start));
+        start = end + 1;
+    }
+    return fields;
+}
+
+// Make the passed descriptors 0, 1 and 2
+static void install_fds(std::vector<int>& fds) {
+    while (fds.size() < PASSED_FDS) {
+        fds.push_back(open("/dev/null", O_RDWR | O_CLOEXEC));
+    }
+    for (size_t i = PASSED_FDS; i < fds.size(); i++) {
+        close(fds[i]);
+    }
+    for (int i = 0; i < PASSED_FDS; i++) {
+        if (fds[i] != i) {
+            dup2(fds[i], i);
+        } else {
+            fcntl(i, F_SETFD, 0);
+        }
+    }
+    for (int i = 0; i < PASSED_FDS; i++) {
+        if (fds[i] > STDERR_FILENO) {
+            close(fds[i]);
+        }
+    }
+}
+
+static int run_request(const std::vector<std::string>& fields) {
+    if (fields.size() < 2) {
+        std::cerr << "myshell: server: malformed request" << std::endl;
+        return ERR_INVALID_ARGS;
+    }
+    if (!fields[1].empty()) {
+        if (chdir(fields[1].c_str()) != 0) {
+            shell_perror("cd: " + fields[1]);
+            return ERR_FILE_NOT_FOUND;
+        }
+        set_env("PWD", fields[1]);
+    }
+    for (size_t i = 2; i < fields.size(); i++) {
+        size_t eq = fields[i].find('=');
+        if (eq == std::string::npos) {
+            unset_env(fields[i]);
+        } else if (eq > 0) {
+            set_env(fields[i].substr(0, eq), fields[i].substr(eq + 1));
+        }
+    }
+
+    execute_line(fields[0]);
+    return g_context->last_exit_status;
+}
+
+// Serve one connection; the exit status says whether one was accepted
+static int worker(int listen_fd) {
+    int conn;
+    do {
+        conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (conn == -1 && errno == EINTR);
+    if (conn == -1) {
+        shell_perror("server: accept");
+        return 1;
+    }
+    close(listen_fd);
+
+    // Only the server's own user may have commands run as it
+    struct ucred peer;
+    socklen_t size = sizeof(peer);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &size) != 0 || peer.uid != geteuid()) {
+        std::cerr << "myshell: server: refused a connection from another user" << std::endl;
+        close(conn);
+        return 0;
+    }
+
+    std::string payload;
+    std::vector<int> fds;
+    if (!receive_request(conn, payload, fds)) {
+        for (int fd : fds) {
+            close(fd);
+        }
+        return 0;                        // Client went away; nothing to answer
+    }
+    install_fds(fds);
+
+    int32_t status = run_request(split_payload(payload));
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    write_all(conn, reinterpret_cast<const char*>(&status), sizeof(status));
+    return 0;
+}
+
+// ============================================================================
+// Server
+// ============================================================================
+
+static int listen_on(const std::string& path) {
+    struct sockaddr_un addr;
+    if (!socket_address(path, addr)) {
+        return -1;
+    }
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode)) {
+        std::cerr << "myshell: " << path << ": exists and is not a socket" << std::endl;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        shell_perror("socket");
+        return -1;
+    }
+
+    // A socket nobody listens on is left over from an earlier server
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+        std::cerr << "myshell: " << path << ": a server is already running" << std::endl;
+        close(fd);
+        return -1;
+    }
+    if (errno == ECONNREFUSED && lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    close(fd);
+
+    // Created 0600: only its owner can connect
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t old_mask = umask(0177);
+    bool bound = fd != -1 && bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+    umask(old_mask);
+    if (!bound || listen(fd, SOMAXCONN) != 0) {
+        shell_perror(path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static pid_t start_worker(int listen_fd, const sigset_t* worker_mask) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // === WORKER PROCESS ===
+        sigprocmask(SIG_SETMASK, worker_mask, nullptr);
+        _exit(worker(listen_fd));
+    }
+    if (pid == -1) {
+        shell_perror("fork");
+    }
+    return pid;
+}
+
+int run_server(const std::string& path, int workers) {
+    int listen_fd = listen_on(path);
+    if (listen_fd == -1) {
+        return ERR_INVALID_ARGS;
+    }
+
+    // Workers' exits and the stop signals are taken synchronously
+    sigset_t wait_set, worker_mask;
+    sigemptyset(&wait_set);
+    sigaddset(&wait_set, SIGCHLD);
+    sigaddset(&wait_set, SIGTERM);
+    sigaddset(&wait_set, SIGINT);
+    sigaddset(&wait_set, SIGHUP);
+    sigprocmask(SIG_BLOCK, &wait_set, &worker_mask);
+
+    std::vector<pid_t> pool;
+    int status = 0;
+    while (true) {
+        while (static_cast<int>(pool.size()) < workers) {
+            pid_t pid = start_worker(listen_fd, &worker_mask);
+            if (pid == -1) {
+                break;
+            }
+            pool.push_back(pid);
+        }
+        if (pool.empty()) {
+            status = ERR_FORK_FAILED;
+            break;
+        }
+
+        int sig = sigwaitinfo(&wait_set, nullptr);
+        if (sig == -1) {
+            continue;
+        }
+        if (sig != SIGCHLD) {
+            break;
+        }
+
+        bool failed = false;
+        pid_t pid;
+        int wstatus;
+        while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+            for (size_t i = 0; i < pool.size(); i++) {
+                if (pool[i] == pid) {
+                    pool.erase(pool.begin() + i);
+                    break;
+                }
+            }
+            // A worker that could not accept would fail again if replaced
+            failed = failed || (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0);
+        }
+        if (failed) {
+            status = 1;
+            break;
+        }
+    }
+
+    for (pid_t pid : pool) {
+        kill(pid, SIGTERM);
+    }
+    for (pid_t pid : pool) {
+        waitpid(pid, nullptr, 0);
+    }
+    close(listen_fd);
+    unlink(path.c_str());
+    sigprocmask(SIG_SETMASK, &worker_mask, nullptr);
+    return status;
+}
+
+// ============================================================================
+// Client
+// ============================================================================
+
+int run_client(const std::string& path, const std::string& command) {
+    struct sockaddr_un addr;
+    if (!socket_address(path, addr)) {
+        return ERR_INVALID_ARGS;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1 || connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        shell_perror(path);
+        if (sock != -1) {
+            close(sock);
+        }
+        return ERR_EXEC_FAILED;
+    }
+
+    std::string payload = command;
+    payload += '\0';
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) != nullptr) {
+        payload += cwd;
+    }
+    payload += '\0';
+    for (char** env = environ; *env != nullptr; env++) {
+        payload += *env;
+        payload += '\0';
+    }
+
+    int fds[PASSED_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int32_t status;
+    if (!send_request(sock, payload, fds, PASSED_FDS) ||
+        !read_all(sock, reinterpret_cast<char*>(&status), sizeof(status))) {
+        std::cerr << "myshell: " << path << ": no reply from server" << std::endl;
+        close(sock);
+        return ERR_EXEC_FAILED;
+    }
+    close(sock);
+    return status;
+}
@@ -0,0 +1,90 @@
+#include "shell.h"
+#include "context.h"
+#include "signals.h"
+#include "syntax.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "script_cache.h"
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+// ============================================================================
+// Shell Context
+// ============================================================================
+// The standalone shell's state; an embedding program switches g_context to
+// a context of its own for each call
+static ShellContext g_default_context;
+ShellContext* g_context = &g_default_context;
+
+// ============================================================================
+// Error Handling Implementation
+// ============================================================================
+const char* shell_strerror(ShellError code) {
+    switch (code) {
+        case SHELL_OK:              return "Success";
+        case ERR_CMD_NOT_FOUND:     return "Command not found";
+        case ERR_PERMISSION_DENIED: return "Permission denied";
+        case ERR_FILE_NOT_FOUND:    return "No such file or directory";
+        case ERR_SYNTAX_ERROR:      return "Syntax error";
+        case ERR_FORK_FAILED:       return "Fork failed";
+        case ERR_EXEC_FAILED:       return "Execution failed";
+        case ERR_PIPE_FAILED:       return "Pipe creation failed";
+        case ERR_REDIRECT_FAILED:   return "Redirection failed";
+        case ERR_INVALID_ARGS:      return "Invalid arguments";
+        default:                    return "Unknown error";
+    }
+}
+
+void shell_error(ShellError code, const std::string& context) {
+    std::cerr << "myshell: " << context << ": " << shell_strerror(code) << std::endl;
+}
+
+void shell_perror(const std::string& prefix) {
+    std::cerr << "myshell: " << prefix << ": " << strerror(errno) << std::endl;
+}
+
+// ============================================================================
+// Execute a Line
+// ============================================================================
+void execute_line(const std::string& line) {
+    // Parse the whole line (or script) into a syntax tree
+    ParseResult parsed = parse_script(line);
+    
+    if (!parsed.error.empty()) {
+        std::cerr << "myshell: " << parsed.error << std::endl;
+        g_context->last_exit_status = ERR_SYNTAX_ERROR;
+        return;
+    }
+    
+    if (parsed.list.empty()) {
+        return;
+    }
+    
+    // Compile once, then run the bytecode
+    g_interrupted = 0;
+    Program program = compile_script(parsed.list);
+    g_context->last_exit_status = run_program(program);
+}
+
+// ============================================================================
+// Execute a Script File
+// ============================================================================
+void execute_script(const std::string& text) {
+    // A previously compiled copy skips tokenizing and parsing entirely
+    Program program;
+    if (!script_cache_load(text, program)) {
+        ParseResult parsed = parse_script(text);
+        if (!parsed.error.empty()) {
+            std::cerr << "myshell: " << parsed.error << std::endl;
+            g_context->last_exit_status = ERR_SYNTAX_ERROR;
+            return;
+        }
+        program = compile_script(parsed.list);
+        script_cache_store(text, program);
+    }
+    
+    g_interrupted = 0;
+    g_context->last_exit_status = run_program(program);
+}
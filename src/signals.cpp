@@ -11,6 +11,16 @@
 // ============================================================================
 
 volatile sig_atomic_t g_foreground_pid = 0;
+volatile sig_atomic_t g_interrupted = 0;
+
+// Tracked children: pid 0 is a free slot, status -1 means still running
+struct TrackedChild {
+    volatile sig_atomic_t pid;
+    volatile sig_atomic_t status;
+};
+
+static const int MAX_TRACKED_CHILDREN = 16;
+static TrackedChild g_tracked[MAX_TRACKED_CHILDREN];
 
 // ============================================================================
 // SIGCHLD Handler - Reap Zombie Processes
@@ -23,10 +33,15 @@ void sigchld_handler(int sig) {
     pid_t pid;
     int status;
     
-    // Reap all terminated children (non-blocking)
+    // Reap all terminated children (non-blocking), keeping the status of
+    // the tracked ones
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        // Could notify user about background job completion here
-        // For simplicity, we just reap silently
+        for (auto& child : g_tracked) {
+            if (child.pid == pid) {
+                child.status = WIFSIGNALED(status) ? 128 + WTERMSIG(status)
+                                                   : WEXITSTATUS(status);
+            }
+        }
     }
     
     errno = saved_errno;
@@ -38,6 +53,7 @@ void sigchld_handler(int sig) {
 
 void sigint_handler(int sig) {
     (void)sig;
+    g_interrupted = 1;
     // Shell ignores SIGINT - only children receive it
     // Print a newline for cleaner prompt
     std::cout << std::endl;
@@ -86,4 +102,53 @@ void setup_child_signals() {
     signal(SIGQUIT, SIG_DFL);
     signal(SIGTTOU, SIG_DFL);
     signal(SIGTTIN, SIG_DFL);
+    
+    // The parent blocked SIGCHLD around fork; don't pass that on
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+}
+
+// ============================================================================
+// SIGCHLD Blocking Around Foreground Waits
+// ============================================================================
+
+void block_sigchld(sigset_t* old_mask) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, old_mask);
+}
+
+void restore_sigmask(const sigset_t* old_mask) {
+    sigprocmask(SIG_SETMASK, old_mask, nullptr);
+}
+
+// ============================================================================
+// Tracked Background Children
+// ============================================================================
+
+bool track_child(pid_t pid) {
+    for (auto& child : g_tracked) {
+        if (child.pid == 0) {
+            child.status = -1;
+            child.pid = pid;
+            return true;
+        }
+    }
+    return false;
+}
+
+int tracked_child_status(pid_t pid) {
+    for (auto& child : g_tracked) {
+        if (child.pid == pid) {
+            int status = child.status;
+            if (status != -1) {
+                child.pid = 0;
+            }
+            return status;
+        }
+    }
+    return -1;
 }
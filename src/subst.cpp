@@ -0,0 +1,362 @@
+#include "subst.h"
+#include "builtins.h"
+#include "bytecode.h"
+#include "cond.h"
+#include "executor.h"
+#include "parser.h"
+#include "signals.h"
+#include "syntax.h"
+#include "vm.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+int g_substitution_status = -1;
+
+// ============================================================================
+// Compiled Substitution Cache
+// ============================================================================
+// A substitution inside a loop is parsed and compiled once per distinct text.
+
+enum SubstKind {
+    SUBST_PROGRAM,       // General script: run in a child
+    SUBST_BUILTIN,       // One simple command that may be a pure builtin
+    SUBST_READ_FILE      // $(< file)
+};
+
+struct CompiledSubst {
+    Program program;
+    SubstKind kind = SUBST_PROGRAM;
+    std::string error;                   // Syntax error, if any
+};
+
+static const size_t MAX_CACHED_SUBSTITUTIONS = 256;
+
+static std::unordered_map<std::string, std::shared_ptr<const CompiledSubst>> g_subst_cache;
+
+// Builtins that only write output, so running them in the shell cannot
+// leak state changes out of the "subshell"
+static bool is_pure_builtin(const std::string& name) {
+    return name == "echo" || name == "pwd" || name == "true" || name == "false" || name == ":";
+}
+
+static SubstKind classify(const Program& prog) {
+    if (prog.code.size() != 2 || prog.code[0].op != OP_RUN) {
+        return SUBST_PROGRAM;
+    }
+    const PipelineTemplate& tmpl = prog.pipelines[prog.code[0].a];
+    if (tmpl.background || tmpl.stages.size() != 1 || tmpl.stages[0].entry >= 0 ||
+        tmpl.stages[0].replicas > 0 || !tmpl.placement.empty()) {
+        return SUBST_PROGRAM;
+    }
+
+    const SimpleCommand& cmd = tmpl.stages[0].command;
+    if (!cmd.assigns.empty()) {
+        return SUBST_PROGRAM;
+    }
+    if (cmd.words.empty() && cmd.redirects.size() == 1 && cmd.redirects[0].type == REDIR_IN) {
+        return SUBST_READ_FILE;
+    }
+    if (!cmd.words.empty() && cmd.redirects.empty() && is_pure_builtin(cmd.words[0])) {
+        return SUBST_BUILTIN;
+    }
+    return SUBST_PROGRAM;
+}
+
+static std::shared_ptr<const CompiledSubst> compile_subst(const std::string& script) {
+    auto it = g_subst_cache.find(script);
+    if (it != g_subst_cache.end()) {
+        return it->second;
+    }
+
+    auto compiled = std::make_shared<CompiledSubst>();
+    ParseResult parsed = parse_script(script);
+    if (!parsed.error.empty()) {
+        compiled->error = parsed.error;
+    } else {
+        compiled->program = compile_script(parsed.list);
+        compiled->kind = classify(compiled->program);
+    }
+
+    if (g_subst_cache.size() >= MAX_CACHED_SUBSTITUTIONS) {
+        g_subst_cache.clear();
+    }
+    g_subst_cache.emplace(script, compiled);
+    return compiled;
+}
+
+// ============================================================================
+// Output Capture
+// ============================================================================
+
+// Read until EOF straight into the string's storage, doubling it as needed
+static void read_all(int fd, std::string& out) {
+    size_t used = out.size();
+    out.resize(used + 4096);
+
+    while (true) {
+        if (used == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        ssize_t n = read(fd, &out[used], out.size() - used);
+        if (n > 0) {
+            used += static_cast<size_t>(n);
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    out.resize(used);
+}
+
+// $(< file): the file's contents, without running anything
+static int read_file(const std::string& path, std::string& out) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        shell_perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        out.reserve(static_cast<size_t>(st.st_size) + 1);
+    }
+    read_all(fd, out);
+    close(fd);
+    return 0;
+}
+
+// Collects everything written to std::cout while installed
+class CaptureBuffer : public std::streambuf {
+public:
+    explicit CaptureBuffer(std::string& out) : out_(out) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            out_ += traits_type::to_char_type(c);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out_.append(s, static_cast<size_t>(n));
+        return n;
+    }
+
+private:
+    std::string& out_;
+};
+
+static int run_builtin(const CompiledSubst& subst, std::string& out) {
+    Pipeline pipeline = expand_pipeline(subst.program, subst.program.pipelines[0]);
+    Command& cmd = pipeline.commands[0];
+    if (cmd.args.empty()) {
+        return 0;
+    }
+
+    BuiltinFunc func = get_builtin(cmd.name());
+    CaptureBuffer capture(out);
+    std::cout.flush();
+    std::streambuf* saved = std::cout.rdbuf(&capture);
+    int status = func(cmd.args);
+    std::cout.rdbuf(saved);
+    return status;
+}
+
+static int capture_child(const Program& prog, std::string& out) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        shell_perror("pipe");
+        return ERR_PIPE_FAILED;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        shell_perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        restore_sigmask(&old_mask);
+        return ERR_FORK_FAILED;
+    }
+
+    if (pid == 0) {
+        // === CHILD PROCESS ===
+        setup_child_signals();
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+
+        int status = run_program(prog);
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(status);
+    }
+
+    // === PARENT PROCESS ===
+    close(fds[1]);
+    read_all(fds[0], out);
+    close(fds[0]);
+
+    int status = wait_for_child(pid);
+    restore_sigmask(&old_mask);
+    return status;
+}
+
+// ============================================================================
+// Process Substitution
+// ============================================================================
+
+struct ProcessSubst {
+    pid_t pid;
+    int fd;                              // The shell's end of the pipe
+};
+
+static std::vector<ProcessSubst> g_process_substs;
+static sigset_t g_process_subst_mask;   // Mask to restore once none remain
+
+std::string process_substitution(const std::string& script, bool feeds_script) {
+    std::shared_ptr<const CompiledSubst> subst = compile_subst(script);
+    if (!subst->error.empty()) {
+        std::cerr << "myshell: " << subst->error << std::endl;
+        g_expansion_error = true;
+        return "";
+    }
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+        shell_perror("pipe");
+        g_expansion_error = true;
+        return "";
+    }
+    int shell_end = feeds_script ? fds[1] : fds[0];
+    int child_end = feeds_script ? fds[0] : fds[1];
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    // Keep the reaper off these children until the pipeline waits for them
+    if (g_process_substs.empty()) {
+        block_sigchld(&g_process_subst_mask);
+    }
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        shell_perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        if (g_process_substs.empty()) {
+            restore_sigmask(&g_process_subst_mask);
+        }
+        g_expansion_error = true;
+        return "";
+    }
+
+    if (pid == 0) {
+        // === CHILD PROCESS ===
+        setup_child_signals();
+        for (const auto& other : g_process_substs) {
+            close(other.fd);             // Would hold other pipes open
+        }
+        close(shell_end);
+        dup2(child_end, feeds_script ? STDIN_FILENO : STDOUT_FILENO);
+        close(child_end);
+
+        int status = run_program(subst->program);
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(status);
+    }
+
+    // === PARENT PROCESS ===
+    close(child_end);
+    cond_forget_stats();
+    g_process_substs.push_back({pid, shell_end});
+    return "/dev/fd/" + std::to_string(shell_end);
+}
+
+size_t process_substitution_mark() {
+    return g_process_substs.size();
+}
+
+void finish_process_substitutions(size_t mark, bool wait) {
+    if (g_process_substs.size() <= mark) {
+        return;
+    }
+
+    // Closing our ends first lets a writer whose output was never read
+    // finish (SIGPIPE) and gives a >(...) reader its end of file
+    for (size_t i = mark; i < g_process_substs.size(); i++) {
+        close(g_process_substs[i].fd);
+    }
+    if (wait) {
+        for (size_t i = mark; i < g_process_substs.size(); i++) {
+            wait_for_child(g_process_substs[i].pid);
+        }
+    }
+    g_process_substs.resize(mark);
+
+    if (g_process_substs.empty()) {
+        restore_sigmask(&g_process_subst_mask);
+    }
+}
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+int command_substitution(const std::string& script, std::string& output) {
+    output.clear();
+    std::shared_ptr<const CompiledSubst> subst = compile_subst(script);
+
+    int status;
+    if (!subst->error.empty()) {
+        std::cerr << "myshell: " << subst->error << std::endl;
+        status = ERR_SYNTAX_ERROR;
+    } else if (subst->program.code.size() == 1) {
+        status = 0;                          // Empty script
+    } else if (subst->kind == SUBST_READ_FILE) {
+        const Redirect& redir = subst->program.pipelines[0].stages[0].command.redirects[0];
+        status = read_file(expand_word_single(redir.target), output);
+    } else if (subst->kind == SUBST_BUILTIN) {
+        // An alias, function or plugin of the same name must run as a script
+        const std::string& name = subst->program.pipelines[0].stages[0].command.words[0];
+        std::string alias;
+        if (find_alias(name, alias) || find_function(name) != nullptr || is_loaded_builtin(name)) {
+            status = capture_child(subst->program, output);
+        } else {
+            status = run_builtin(*subst, output);
+        }
+    } else {
+        status = capture_child(subst->program, output);
+    }
+
+    // Trailing newlines are removed
+    size_t end = output.find_last_not_of('\n');
+    output.resize(end == std::string::npos ? 0 : end + 1);
+
+    if (subst->kind != SUBST_BUILTIN) {
+        cond_forget_stats();             // The child may have changed files
+    }
+    g_substitution_status = status;
+    return status;
+}
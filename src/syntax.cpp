@@ -0,0 +1,590 @@
+#include "syntax.h"
+#include "parser.h"
+
+#include <initializer_list>
+
+// ============================================================================
+// Recursive Descent Parser
+// ============================================================================
+//
+//   list      := and_or ((';' | '&' | NEWLINE) and_or)*
+//   and_or    := pipeline (('&&' | '||') NEWLINE* pipeline)*
+//   pipeline  := ['confine' option*] ['!'] stage ('|' stage)*
+//   stage     := ['[' N ['u'] ']'] command      (N copies, see replicate.h)
+//   command   := simple | if | while | until | for   (compounds may redirect)
+//              | '{' list '}' | '(' list ')'
+//              | NAME '(' ')' '{' list '}' | '((' expr '))' | '[[' expr ']]'
+//
+
+class ScriptParser {
+public:
+    ScriptParser(const std::vector<Token>& tokens) : tokens_(tokens), pos_(0) {}
+
+    ParseResult parse() {
+        ParseResult result;
+        result.list = parse_list({});
+        if (error_.empty() && peek().type != TOKEN_END) {
+            fail();
+        }
+        result.error = error_;
+        result.incomplete = incomplete_;
+        return result;
+    }
+
+private:
+    const std::vector<Token>& tokens_;
+    size_t pos_;
+    std::string error_;
+    bool incomplete_ = false;
+
+    const Token& peek() const {
+        return tokens_[pos_];
+    }
+
+    const Token& peek_next() const {
+        return tokens_[pos_ + 1 < tokens_.size() ? pos_ + 1 : pos_];
+    }
+
+    void advance() {
+        if (tokens_[pos_].type != TOKEN_END) {
+            pos_++;
+        }
+    }
+
+    bool at_word(const char* word) const {
+        return peek().type == TOKEN_WORD && peek().value == word;
+    }
+
+    bool at_any(std::initializer_list<const char*> words) const {
+        for (const char* word : words) {
+            if (at_word(word)) return true;
+        }
+        return false;
+    }
+
+    void skip_newlines() {
+        while (peek().type == TOKEN_NEWLINE) {
+            advance();
+        }
+    }
+
+    // Record a syntax error at the current token (first error wins)
+    void fail() {
+        if (!error_.empty()) {
+            return;
+        }
+        if (peek().type == TOKEN_END) {
+            incomplete_ = true;
+            error_ = "syntax error: unexpected end of file";
+        } else {
+            std::string tok = peek().type == TOKEN_NEWLINE ? "newline" : peek().value;
+            error_ = "syntax error near unexpected token `" + tok + "'";
+        }
+    }
+
+    bool expect(const char* word) {
+        if (!at_word(word)) {
+            fail();
+            return false;
+        }
+        advance();
+        return true;
+    }
+
+    NodeList parse_list(std::initializer_list<const char*> terminators) {
+        NodeList list;
+
+        while (error_.empty()) {
+            skip_newlines();
+            if (peek().type == TOKEN_END || peek().type == TOKEN_RPAREN) {
+                break;
+            }
+            bool done = false;
+            for (const char* word : terminators) {
+                if (at_word(word)) done = true;
+            }
+            if (done) {
+                break;
+            }
+
+            NodePtr pipeline = parse_and_or();
+            if (!pipeline) {
+                break;
+            }
+
+            if (peek().type == TOKEN_SEMI || peek().type == TOKEN_NEWLINE) {
+                advance();
+            } else if (peek().type == TOKEN_BACKGROUND) {
+                pipeline->background = true;
+                advance();
+            }
+            list.push_back(std::move(pipeline));
+        }
+
+        return list;
+    }
+
+    // A list that must contain at least one command
+    NodeList parse_required_list(std::initializer_list<const char*> terminators) {
+        NodeList list = parse_list(terminators);
+        if (list.empty()) {
+            fail();
+        }
+        return list;
+    }
+
+    // A lone pipeline is returned as is. A chain becomes a pipeline whose
+    // only stage is a NODE_AND_OR, so `&` and the compiler treat it like
+    // any other compound command.
+    NodePtr parse_and_or() {
+        NodePtr first = parse_pipeline();
+        if (!first || (peek().type != TOKEN_AND_IF && peek().type != TOKEN_OR_IF)) {
+            return first;
+        }
+
+        NodePtr chain(new Node(NODE_AND_OR));
+        chain->body.push_back(std::move(first));
+        while (peek().type == TOKEN_AND_IF || peek().type == TOKEN_OR_IF) {
+            chain->items.push_back(peek().value);
+            advance();
+            skip_newlines();
+            NodePtr next = parse_pipeline();
+            if (!next) {
+                return nullptr;
+            }
+            chain->body.push_back(std::move(next));
+        }
+
+        NodePtr pipeline(new Node(NODE_PIPELINE));
+        pipeline->stages.push_back(std::move(chain));
+        return pipeline;
+    }
+
+    NodePtr parse_pipeline() {
+        NodePtr pipeline(new Node(NODE_PIPELINE));
+
+        if (at_word("confine") && peek_next().type == TOKEN_WORD) {
+            advance();
+            if (!parse_confine_options(pipeline->items)) {
+                return nullptr;
+            }
+        }
+        if (at_word("!")) {
+            pipeline->negate = true;
+            advance();
+        }
+
+        while (true) {
+            uint32_t replicas = 0;
+            bool unordered = false;
+            if (at_replicas(replicas, unordered)) {
+                advance();
+            }
+            NodePtr stage = parse_command();
+            if (!stage) {
+                return nullptr;
+            }
+            stage->replicas = replicas;
+            stage->unordered = unordered;
+            pipeline->stages.push_back(std::move(stage));
+
+            if (peek().type != TOKEN_PIPE) {
+                break;
+            }
+            advance();
+            skip_newlines();
+        }
+
+        return pipeline;
+    }
+
+    // confine's options are kept as raw words: -P alone, any other with a
+    // value. They end at the first word not starting with '-' (or --).
+    bool parse_confine_options(std::vector<std::string>& options) {
+        while (peek().type == TOKEN_WORD && peek().value.size() > 1 && peek().value[0] == '-') {
+            if (peek().value == "--") {
+                advance();
+                break;
+            }
+            bool takes_value = peek().value != "-P";
+            options.push_back(peek().value);
+            advance();
+            if (takes_value) {
+                if (peek().type != TOKEN_WORD) {
+                    fail();
+                    return false;
+                }
+                options.push_back(peek().value);
+                advance();
+            }
+        }
+        return true;
+    }
+
+    // [N] or [Nu] before a command: a word that would otherwise be a
+    // one-character glob, so any other use of it needs quoting
+    bool at_replicas(uint32_t& count, bool& unordered) const {
+        static const uint32_t MAX_REPLICAS = 1024;
+        const std::string& word = peek().value;
+        const Token& next = peek_next();
+        if (peek().type != TOKEN_WORD || word.size() < 3 || word[0] != '[' || word.back() != ']' ||
+            (next.type != TOKEN_WORD && next.type != TOKEN_LPAREN && next.type != TOKEN_ARITH)) {
+            return false;
+        }
+        size_t end = word.size() - 1;
+        unordered = word[end - 1] == 'u';
+        if (unordered) {
+            end--;
+        }
+        uint32_t n = 0;
+        for (size_t i = 1; i < end; i++) {
+            if (word[i] < '0' || word[i] > '9' || n > MAX_REPLICAS) {
+                return false;
+            }
+            n = n * 10 + static_cast<uint32_t>(word[i] - '0');
+        }
+        if (end == 1 || n == 0 || n > MAX_REPLICAS) {
+            return false;
+        }
+        count = n;
+        return true;
+    }
+
+    bool parse_redirect(std::vector<Redirect>& redirects) {
+        RedirType type;
+        switch (peek().type) {
+            case TOKEN_REDIRECT_IN:     type = REDIR_IN; break;
+            case TOKEN_REDIRECT_OUT:    type = REDIR_OUT; break;
+            case TOKEN_REDIRECT_APPEND: type = REDIR_APPEND; break;
+            case TOKEN_REDIRECT_ERR:    type = REDIR_ERR; break;
+            case TOKEN_DUP_IN:          type = REDIR_DUP_IN; break;
+            case TOKEN_DUP_OUT:         type = REDIR_DUP_OUT; break;
+            case TOKEN_DUP_ERR:         type = REDIR_DUP_ERR; break;
+            case TOKEN_HERESTRING:      type = REDIR_HERESTRING; break;
+            case TOKEN_HEREDOC:         type = REDIR_HEREDOC; break;
+            default:
+                return false;
+        }
+        std::string body = peek().value;
+        advance();
+        if (peek().type != TOKEN_WORD) {
+            fail();
+            return false;
+        }
+        if (type == REDIR_HEREDOC) {
+            // Any quoting in the delimiter turns off expansion of the body
+            if (peek().value.find_first_of("'\"\\") != std::string::npos) {
+                type = REDIR_HEREDOC_LITERAL;
+            }
+            redirects.push_back({type, body});
+        } else {
+            redirects.push_back({type, peek().value});
+        }
+        advance();
+        return true;
+    }
+
+    NodePtr parse_command() {
+        NodePtr node;
+
+        if (at_word("if")) {
+            node = parse_if();
+        } else if (at_word("while") || at_word("until")) {
+            node = parse_loop();
+        } else if (at_word("for")) {
+            node = parse_for();
+        } else if (peek().type == TOKEN_ARITH) {
+            node.reset(new Node(NODE_ARITH));
+            node->var = peek().value;
+            advance();
+        } else if (at_word("[[")) {
+            node = parse_cond();
+        } else if (at_word("coproc")) {
+            node = parse_coproc();
+        } else if (at_word("{")) {
+            node.reset(new Node(NODE_GROUP));
+            advance();
+            node->body = parse_required_list({"}"});
+            if (!expect("}")) {
+                return nullptr;
+            }
+        } else if (peek().type == TOKEN_LPAREN) {
+            node.reset(new Node(NODE_SUBSHELL));
+            advance();
+            node->body = parse_required_list({});
+            if (!error_.empty()) {
+                return nullptr;
+            }
+            if (peek().type != TOKEN_RPAREN) {
+                fail();
+                return nullptr;
+            }
+            advance();
+        } else if (at_any({"then", "elif", "else", "fi", "do", "done", "}"})) {
+            fail();
+            return nullptr;
+        } else if (peek().type == TOKEN_WORD && peek_next().type == TOKEN_LPAREN) {
+            return parse_function();
+        } else {
+            return parse_simple();
+        }
+
+        // Redirections after a compound command apply to all of it
+        while (node && error_.empty() && parse_redirect(node->redirects)) {
+        }
+        return error_.empty() ? std::move(node) : nullptr;
+    }
+
+    // coproc [NAME] command. A NAME is read before a compound command; before
+    // a simple command only an all-capitals word followed by more words
+    // counts as one, since it could also be the command's name.
+    NodePtr parse_coproc() {
+        NodePtr node(new Node(NODE_COPROC));
+        node->var = "COPROC";
+        advance();   // coproc
+
+        const Token& name = peek();
+        const Token& next = peek_next();
+        if (name.type == TOKEN_WORD && is_assignment_word(name.value + "=")) {
+            bool compound = next.type == TOKEN_LPAREN || next.type == TOKEN_ARITH ||
+                            (next.type == TOKEN_WORD &&
+                             (next.value == "{" || next.value == "if" || next.value == "while" ||
+                              next.value == "until" || next.value == "for" || next.value == "[["));
+            bool capitals = name.value.find_first_of("abcdefghijklmnopqrstuvwxyz") == std::string::npos;
+            if (compound || (capitals && next.type == TOKEN_WORD)) {
+                node->var = name.value;
+                advance();
+            }
+        }
+
+        NodePtr command = parse_command();
+        if (!command) {
+            return nullptr;
+        }
+        NodePtr pipeline(new Node(NODE_PIPELINE));
+        pipeline->stages.push_back(std::move(command));
+        node->body.push_back(std::move(pipeline));
+        return node;
+    }
+
+    // [[ ... ]]: the words are kept raw; && || ( ) < > arrive as operator
+    // tokens and are turned back into words for the evaluator
+    NodePtr parse_cond() {
+        NodePtr node(new Node(NODE_COND));
+        advance();
+
+        while (!at_word("]]")) {
+            const Token& tok = peek();
+            switch (tok.type) {
+                case TOKEN_WORD:
+                    node->items.push_back(tok.value);
+                    break;
+                case TOKEN_AND_IF:
+                case TOKEN_OR_IF:
+                    node->items.push_back(tok.value);
+                    break;
+                case TOKEN_LPAREN:      node->items.push_back("("); break;
+                case TOKEN_RPAREN:      node->items.push_back(")"); break;
+                case TOKEN_REDIRECT_IN: node->items.push_back("<"); break;
+                case TOKEN_REDIRECT_OUT: node->items.push_back(">"); break;
+                case TOKEN_NEWLINE:     break;
+                default:
+                    fail();
+                    return nullptr;
+            }
+            advance();
+        }
+        advance();
+
+        if (node->items.empty()) {
+            error_ = "syntax error near unexpected token `]]'";
+            return nullptr;
+        }
+        return node;
+    }
+
+    NodePtr parse_simple() {
+        NodePtr node(new Node(NODE_COMMAND));
+        SimpleCommand& cmd = node->command;
+
+        while (error_.empty()) {
+            if (peek().type == TOKEN_WORD) {
+                if (cmd.words.empty() && is_assignment_word(peek().value)) {
+                    cmd.assigns.push_back(peek().value);
+                } else {
+                    cmd.words.push_back(peek().value);
+                }
+                advance();
+            } else if (!parse_redirect(cmd.redirects)) {
+                break;
+            }
+        }
+
+        if (!error_.empty()) {
+            return nullptr;
+        }
+        if (cmd.words.empty() && cmd.assigns.empty() && cmd.redirects.empty()) {
+            fail();
+            return nullptr;
+        }
+        return node;
+    }
+
+    NodePtr parse_if() {
+        NodePtr node(new Node(NODE_IF));
+        advance();   // if
+
+        while (true) {
+            NodeList condition = parse_required_list({"then"});
+            if (!expect("then")) return nullptr;
+            NodeList body = parse_required_list({"elif", "else", "fi"});
+            if (!error_.empty()) return nullptr;
+            node->clauses.emplace_back(std::move(condition), std::move(body));
+
+            if (!at_word("elif")) break;
+            advance();
+        }
+
+        if (at_word("else")) {
+            advance();
+            node->body = parse_required_list({"fi"});
+        }
+        if (!expect("fi")) return nullptr;
+        return node;
+    }
+
+    NodePtr parse_loop() {
+        NodePtr node(new Node(at_word("while") ? NODE_WHILE : NODE_UNTIL));
+        advance();   // while / until
+
+        node->condition = parse_required_list({"do"});
+        if (!expect("do")) return nullptr;
+        node->body = parse_required_list({"done"});
+        if (!expect("done")) return nullptr;
+        return node;
+    }
+
+    // NAME() { list; } [redirects] -- the body is kept as a one-stage
+    // pipeline holding the group, so it compiles like any other list
+    // for (( init; cond; step )) [;] do list done
+    NodePtr parse_arith_for(NodePtr node) {
+        node->type = NODE_ARITH_FOR;
+        const std::string& header = peek().value;
+        size_t first = header.find(';');
+        size_t second = first == std::string::npos ? first : header.find(';', first + 1);
+        if (second == std::string::npos || header.find(';', second + 1) != std::string::npos) {
+            fail();
+            return nullptr;
+        }
+        node->items = {header.substr(0, first),
+                       header.substr(first + 1, second - first - 1),
+                       header.substr(second + 1)};
+        advance();
+
+        if (peek().type == TOKEN_SEMI) {
+            advance();
+        }
+        skip_newlines();
+        if (!expect("do")) return nullptr;
+        node->body = parse_required_list({"done"});
+        if (!expect("done")) return nullptr;
+        return node;
+    }
+
+    NodePtr parse_function() {
+        NodePtr node(new Node(NODE_FUNCTION));
+        node->var = peek().value;
+        if (!is_assignment_word(node->var + "=")) {
+            fail();
+            return nullptr;
+        }
+        advance();   // NAME
+        advance();   // (
+        if (peek().type != TOKEN_RPAREN) {
+            fail();
+            return nullptr;
+        }
+        advance();
+
+        skip_newlines();
+        if (!at_word("{")) {
+            fail();
+            return nullptr;
+        }
+        advance();
+        NodePtr group(new Node(NODE_GROUP));
+        group->body = parse_required_list({"}"});
+        if (!expect("}")) return nullptr;
+        while (error_.empty() && parse_redirect(group->redirects)) {
+        }
+        if (!error_.empty()) return nullptr;
+
+        NodePtr pipeline(new Node(NODE_PIPELINE));
+        pipeline->stages.push_back(std::move(group));
+        node->body.push_back(std::move(pipeline));
+        return node;
+    }
+
+    NodePtr parse_for() {
+        NodePtr node(new Node(NODE_FOR));
+        advance();   // for
+
+        if (peek().type == TOKEN_ARITH) {
+            return parse_arith_for(std::move(node));
+        }
+
+        if (peek().type != TOKEN_WORD || !is_assignment_word(peek().value + "=")) {
+            fail();
+            return nullptr;
+        }
+        node->var = peek().value;
+        advance();
+
+        skip_newlines();
+        if (at_word("in")) {
+            advance();
+            node->has_items = true;
+            while (peek().type == TOKEN_WORD) {
+                node->items.push_back(peek().value);
+                advance();
+            }
+            if (peek().type != TOKEN_SEMI && peek().type != TOKEN_NEWLINE) {
+                fail();
+                return nullptr;
+            }
+            advance();
+        } else if (peek().type == TOKEN_SEMI) {
+            advance();
+        }
+
+        skip_newlines();
+        if (!expect("do")) return nullptr;
+        node->body = parse_required_list({"done"});
+        if (!expect("done")) return nullptr;
+        return node;
+    }
+};
+
+// ============================================================================
+// Public Interface
+// ============================================================================
+
+ParseResult parse_script(const std::string& text) {
+    bool unterminated = false;
+    std::vector<Token> tokens = tokenize(text, &unterminated);
+
+    ScriptParser parser(tokens);
+    ParseResult result = parser.parse();
+
+    if (unterminated) {
+        result.incomplete = true;
+        if (result.error.empty()) {
+            result.error = "syntax error: unexpected end of file";
+        }
+    }
+    return result;
+}
+
+bool script_incomplete(const std::string& text) {
+    return parse_script(text).incomplete;
+}
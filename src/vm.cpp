@@ -0,0 +1,456 @@
+#include "vm.h"
+#include "builtins.h"
+#include "env.h"
+#include "executor.h"
+#include "parser.h"
+#include "signals.h"
+#include "arith.h"
+#include "subst.h"
+#include "cond.h"
+#include "input.h"
+#include "coproc.h"
+#include "context.h"
+
+#include <iostream>
+
+#include <memory>
+#include <utility>
+
+int g_function_depth = 0;
+bool g_returning = false;
+
+// ============================================================================
+// Pipeline Expansion
+// ============================================================================
+
+// Target of <&N, >&N or 2>&N; -1 (and an expansion error) if it is not a
+// descriptor number
+static int dup_target(const std::string& raw) {
+    std::string word = expand_word_single(raw);
+    if (word.empty() || word.size() > 9 || word.find_first_not_of("0123456789") != std::string::npos) {
+        std::cerr << "myshell: " << raw << ": ambiguous redirect" << std::endl;
+        g_expansion_error = true;
+        return -1;
+    }
+    return std::stoi(word);
+}
+
+// A later redirection of the same descriptor replaces an earlier one,
+// except that output sent to several files goes to all of them
+static void add_redirect(Command& cmd, const Redirect& redir) {
+    if ((redir.type == REDIR_OUT || redir.type == REDIR_APPEND) && !cmd.output_file.empty()) {
+        cmd.more_outputs.push_back({cmd.output_file, cmd.append_output});
+    }
+    switch (redir.type) {
+        case REDIR_IN:
+            cmd.input_file = expand_word_single(redir.target);
+            cmd.has_here_input = false;
+            cmd.input_dup = -1;
+            break;
+        case REDIR_OUT:
+            cmd.output_file = expand_word_single(redir.target);
+            cmd.append_output = false;
+            cmd.output_dup = -1;
+            cmd.error_dup_first = cmd.error_dup != -1;
+            break;
+        case REDIR_APPEND:
+            cmd.output_file = expand_word_single(redir.target);
+            cmd.append_output = true;
+            cmd.output_dup = -1;
+            cmd.error_dup_first = cmd.error_dup != -1;
+            break;
+        case REDIR_ERR:
+            cmd.error_file = expand_word_single(redir.target);
+            cmd.error_dup = -1;
+            break;
+        case REDIR_HEREDOC:
+            cmd.here_input = expand_here_document(redir.target);
+            cmd.has_here_input = true;
+            cmd.input_file.clear();
+            cmd.input_dup = -1;
+            break;
+        case REDIR_HEREDOC_LITERAL:
+            cmd.here_input = redir.target;
+            cmd.has_here_input = true;
+            cmd.input_file.clear();
+            cmd.input_dup = -1;
+            break;
+        case REDIR_HERESTRING:
+            cmd.here_input = expand_word_single(redir.target) + "\n";
+            cmd.has_here_input = true;
+            cmd.input_file.clear();
+            cmd.input_dup = -1;
+            break;
+        case REDIR_DUP_IN:
+            cmd.input_dup = dup_target(redir.target);
+            cmd.input_file.clear();
+            cmd.has_here_input = false;
+            break;
+        case REDIR_DUP_OUT:
+            cmd.output_dup = dup_target(redir.target);
+            cmd.output_file.clear();
+            cmd.more_outputs.clear();
+            cmd.error_dup_first = cmd.error_dup != -1;
+            break;
+        case REDIR_DUP_ERR:
+            cmd.error_dup = dup_target(redir.target);
+            cmd.error_dup_first = false;
+            cmd.error_file.clear();
+            break;
+    }
+}
+
+static std::pair<std::string, std::string> split_assignment(const std::string& raw) {
+    size_t eq = raw.find('=');
+    std::string name = raw.substr(0, eq);
+    std::string value = expand_word_single(raw.substr(eq + 1));
+    if (!name.empty() && name.back() == '+') {
+        name.pop_back();
+        value = get_env(name) + value;
+    }
+    return {name, value};
+}
+
+// NAME[i]=v or NAME=( ... ), which cannot be passed to a command
+static bool is_array_assignment(const std::string& raw) {
+    size_t eq = raw.find('=');
+    return raw.find('[') < eq || raw.compare(eq + 1, 1, "(") == 0;
+}
+
+Pipeline expand_pipeline(const Program& prog, const PipelineTemplate& tmpl) {
+    Pipeline pipeline;
+    pipeline.background = tmpl.background;
+
+    if (!tmpl.placement.empty()) {
+        std::vector<std::string> options;
+        for (const auto& word : tmpl.placement) {
+            for (auto& field : expand_word(word)) {
+                options.push_back(std::move(field));
+            }
+        }
+        if (!parse_placement(options, pipeline.placement)) {
+            g_expansion_error = true;
+        }
+    }
+
+    for (const auto& stage : tmpl.stages) {
+        Command cmd;
+        cmd.background = tmpl.background;
+
+        for (const auto& assign : stage.command.assigns) {
+            if (!is_array_assignment(assign)) {
+                cmd.assignments.push_back(split_assignment(assign));
+            } else if (stage.command.words.empty() && !assign_word(assign)) {
+                g_expansion_error = true;
+            }
+        }
+        for (const auto& word : stage.command.words) {
+            for (auto& field : expand_word(word)) {
+                cmd.args.push_back(std::move(field));
+            }
+        }
+        for (const auto& redir : stage.command.redirects) {
+            add_redirect(cmd, redir);
+        }
+        if (stage.entry >= 0) {
+            cmd.body = &prog;
+            cmd.body_entry = static_cast<uint32_t>(stage.entry);
+        }
+        cmd.replicas = stage.replicas;
+        cmd.unordered = stage.unordered;
+
+        pipeline.commands.push_back(std::move(cmd));
+    }
+
+    return pipeline;
+}
+
+// ============================================================================
+// Interpreter Loop
+// ============================================================================
+
+struct LoopFrame {
+    std::vector<std::string> items;      // for-loop values
+    size_t next = 0;
+    int status = 0;                      // Status of the last body run
+    bool owns_input = false;             // Holds stdin for `read` (input_own)
+};
+
+// True if a command name the compiler relied on now names a function, an
+// alias or a builtin loaded from a plugin, which could do anything
+static bool is_shadowed(const std::vector<std::string>& names) {
+    std::string alias;
+    for (const auto& name : names) {
+        if (find_function(name) != nullptr || find_alias(name, alias) || is_loaded_builtin(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void pop_loop(std::vector<LoopFrame>& loops) {
+    if (loops.back().owns_input) {
+        input_release(STDIN_FILENO);
+    }
+    loops.pop_back();
+}
+
+// `tail`: the last command of a subshell's child, which an external
+// command may replace
+static int run_pipeline(const Program& prog, const PipelineTemplate& tmpl, bool tail) {
+    reap_coprocs();                      // Before ${NAME[1]} of one that exited is used
+    g_expansion_error = false;
+    g_substitution_status = -1;
+    size_t substs = process_substitution_mark();
+    Pipeline pipeline = expand_pipeline(prog, tmpl);
+
+    int status;
+    if (g_expansion_error) {
+        g_expansion_error = false;
+        status = 1;
+    } else if (pipeline.commands.size() == 1 && pipeline.commands[0].args.empty() &&
+               pipeline.commands[0].body == nullptr) {
+        // Assignments on a command that expanded to nothing apply to the shell
+        for (const auto& assign : pipeline.commands[0].assignments) {
+            set_var(assign.first, assign.second);
+        }
+        // x=$(cmd) takes the status of the substitution
+        status = g_substitution_status >= 0 ? g_substitution_status : SHELL_OK;
+    } else {
+        if (tail && pipeline.commands.size() == 1 && pipeline.placement.empty() &&
+            process_substitution_mark() == substs) {
+            exec_external(pipeline.commands[0]);     // Returns only for builtins
+        }
+
+        // Anything but a lone test may change the files a test looks at
+        const Command& first = pipeline.commands[0];
+        if (pipeline.commands.size() != 1 || (first.name() != "test" && first.name() != "[") ||
+            !first.output_file.empty() || !first.error_file.empty()) {
+            cond_forget_stats();
+        }
+        status = execute_pipeline(pipeline);
+    }
+
+    // <(...) and >(...) processes are reaped along with the pipeline
+    finish_process_substitutions(substs, !pipeline.background);
+    return status;
+}
+
+static int run_coproc(const Program& prog, const PipelineTemplate& tmpl, const std::string& name) {
+    reap_coprocs();
+    g_expansion_error = false;
+    Pipeline pipeline = expand_pipeline(prog, tmpl);
+    if (g_expansion_error) {
+        g_expansion_error = false;
+        return 1;
+    }
+    cond_forget_stats();
+    return start_coproc(name, pipeline.commands[0]);
+}
+
+// (( expr )): status 0 if the value is non-zero, 1 if zero or on error
+static int run_arith(const std::string& text) {
+    g_expansion_error = false;
+    std::string expr = expand_variables(text);
+    if (g_expansion_error) {
+        g_expansion_error = false;
+        return 1;
+    }
+
+    int64_t value;
+    std::string error;
+    if (!arith_eval(expr, value, error)) {
+        std::cerr << "myshell: " << error << std::endl;
+        return 1;
+    }
+    return value != 0 ? 0 : 1;
+}
+
+int run_program(const Program& prog, uint32_t pc) {
+    cond_forget_stats();                 // Each script or line starts afresh
+    std::vector<LoopFrame> loops;
+    std::vector<std::vector<std::pair<int, int>>> saved_fds;
+    int& status = g_context->last_exit_status;
+    bool aborted = false;
+
+    while (g_context->running && !aborted && !g_returning) {
+        const Instr& in = prog.code[pc++];
+
+        switch (in.op) {
+            case OP_RUN:
+                status = run_pipeline(prog, prog.pipelines[in.a], in.b != 0);
+                break;
+
+            case OP_ASSIGN:
+                g_expansion_error = false;
+                g_substitution_status = -1;
+                status = SHELL_OK;
+                for (const auto& assign : prog.pipelines[in.a].stages[0].command.assigns) {
+                    if (!assign_word(assign)) {
+                        g_expansion_error = false;
+                        status = 1;
+                        break;
+                    }
+                }
+                if (status == SHELL_OK && g_substitution_status >= 0) {
+                    status = g_substitution_status;
+                }
+                break;
+
+            case OP_JUMP:
+                if (g_interrupted && in.a < pc) {
+                    status = 128 + SIGINT;   // Ctrl+C stops a running loop
+                    aborted = true;
+                    break;
+                }
+                if (in.a < pc) {
+                    cond_forget_stats();     // Each iteration sees the files afresh
+                }
+                pc = in.a;
+                break;
+
+            case OP_JUMP_IF_FAIL:
+                if (status != 0) pc = in.a;
+                break;
+
+            case OP_JUMP_IF_OK:
+                if (status == 0) pc = in.a;
+                break;
+
+            case OP_JUMP_IF_SHADOWED:
+                if (is_shadowed(prog.word_lists[in.b])) {
+                    pc = in.a;
+                }
+                break;
+
+            case OP_NOT:
+                status = (status == 0) ? 1 : 0;
+                break;
+
+            case OP_STATUS:
+                status = static_cast<int>(in.a);
+                break;
+
+            case OP_LOOP_ENTER:
+                loops.emplace_back();
+                if (in.a != 0 && !is_shadowed(prog.word_lists[in.b])) {
+                    input_own(STDIN_FILENO);
+                    loops.back().owns_input = true;
+                }
+                break;
+
+            case OP_EXPAND: {
+                LoopFrame frame;
+                for (const auto& word : prog.word_lists[in.a]) {
+                    for (auto& field : expand_word(word)) {
+                        frame.items.push_back(std::move(field));
+                    }
+                }
+                loops.push_back(std::move(frame));
+                break;
+            }
+
+            case OP_EXPAND_ARGS: {
+                LoopFrame frame;
+                const auto& params = get_positional_params();
+                frame.items.assign(params.begin() + 1, params.end());
+                loops.push_back(std::move(frame));
+                break;
+            }
+
+            case OP_NEXT: {
+                LoopFrame& frame = loops.back();
+                if (frame.next >= frame.items.size()) {
+                    pc = in.a;
+                } else {
+                    set_var(prog.strings[in.b], frame.items[frame.next++]);
+                }
+                break;
+            }
+
+            case OP_LOOP_SAVE:
+                loops.back().status = status;
+                break;
+
+            case OP_LOOP_EXIT:
+                status = loops.back().status;
+                pop_loop(loops);
+                break;
+
+            case OP_POP:
+                pop_loop(loops);
+                break;
+
+            case OP_REDIRECT: {
+                Command redirected;
+                g_expansion_error = false;
+                for (const auto& redir : prog.redirect_lists[in.a]) {
+                    add_redirect(redirected, redir);
+                }
+                saved_fds.emplace_back();
+                if (g_expansion_error || redirect_shell(redirected, saved_fds.back()) != SHELL_OK) {
+                    g_expansion_error = false;
+                    status = 1;
+                    pc = in.b;               // Skip the body, still restore
+                }
+                break;
+            }
+
+            case OP_RESTORE:
+                restore_shell_fds(saved_fds.back());
+                saved_fds.pop_back();
+                break;
+
+            case OP_ARITH:
+                status = run_arith(prog.strings[in.a]);
+                break;
+
+            case OP_COND:
+                status = cond_eval(prog.word_lists[in.a]);
+                break;
+
+            case OP_COPROC:
+                status = run_coproc(prog, prog.pipelines[in.a], prog.strings[in.b]);
+                break;
+
+            case OP_DEFINE:
+                define_function(prog.strings[in.b],
+                                std::make_shared<const Program>(prog.functions[in.a]));
+                status = SHELL_OK;
+                break;
+
+            case OP_RETURN:
+                return status;
+        }
+    }
+
+    // `exit`, `return` or Ctrl+C: undo redirections still applied to the shell
+    while (!loops.empty()) {
+        pop_loop(loops);
+    }
+    while (!saved_fds.empty()) {
+        restore_shell_fds(saved_fds.back());
+        saved_fds.pop_back();
+    }
+    return status;
+}
+
+// ============================================================================
+// Function Calls
+// ============================================================================
+
+int call_function(const Program& body, const std::vector<std::string>& args) {
+    // $0 stays the shell's; $1.. become the call's arguments
+    std::vector<std::string> saved = get_positional_params();
+    std::vector<std::string> params(args);
+    params[0] = saved.empty() ? "" : saved[0];
+    set_positional_params(params);
+
+    g_function_depth++;
+    int status = run_program(body);
+    g_function_depth--;
+    g_returning = false;
+
+    set_positional_params(saved);
+    return status;
+}
@@ -15,16 +15,26 @@ bool has_wildcards(const std::string& pattern) {
 }
 
 // ============================================================================
-// Pattern Matching (supports * and ?)
+// Pattern Matching (supports * and ?, backslash quotes the next char)
 // ============================================================================
 
 bool match_pattern(const std::string& pattern, const std::string& str) {
+    return match_pattern(pattern, str.data(), str.size());
+}
+
+bool match_pattern(const std::string& pattern, const char* str, size_t size) {
     size_t p = 0, s = 0;
     size_t star_p = std::string::npos;
     size_t star_s = std::string::npos;
     
-    while (s < str.size()) {
-        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s])) {
+    while (s < size) {
+        if (p + 1 < pattern.size() && pattern[p] == '\\' && pattern[p + 1] == str[s]) {
+            // Escaped character matches only itself
+            p += 2;
+            s++;
+        }
+        else if (p < pattern.size() && pattern[p] != '\\' && pattern[p] != '*' &&
+                 (pattern[p] == '?' || pattern[p] == str[s])) {
             // Match single character or exact match
             p++;
             s++;
@@ -56,30 +66,16 @@ bool match_pattern(const std::string& pattern, const std::string& str) {
 }
 
 // ============================================================================
-// Expand Wildcard Pattern
+// Match Directory Entries
 // ============================================================================
 
-std::vector<std::string> expand_glob(const std::string& pattern) {
+std::vector<std::string> match_directory(const std::string& dir_path,
+                                         const std::string& file_pattern) {
     std::vector<std::string> results;
     
-    // Find directory and file pattern
-    size_t last_slash = pattern.rfind('/');
-    std::string dir_path;
-    std::string file_pattern;
-    
-    if (last_slash != std::string::npos) {
-        dir_path = pattern.substr(0, last_slash + 1);
-        file_pattern = pattern.substr(last_slash + 1);
-    } else {
-        dir_path = ".";
-        file_pattern = pattern;
-    }
-    
     // Open directory
-    DIR* dir = opendir(dir_path.c_str());
+    DIR* dir = opendir(dir_path.empty() ? "." : dir_path.c_str());
     if (dir == nullptr) {
-        // Return original pattern if directory can't be opened
-        results.push_back(pattern);
         return results;
     }
     
@@ -100,11 +96,7 @@ std::vector<std::string> expand_glob(const std::string& pattern) {
         
         // Check if name matches pattern
         if (match_pattern(file_pattern, name)) {
-            if (dir_path != ".") {
-                results.push_back(dir_path + name);
-            } else {
-                results.push_back(name);
-            }
+            results.push_back(name);
         }
     }
     
@@ -113,6 +105,37 @@ std::vector<std::string> expand_glob(const std::string& pattern) {
     // Sort results
     std::sort(results.begin(), results.end());
     
+    return results;
+}
+
+// ============================================================================
+// Expand Wildcard Pattern
+// ============================================================================
+
+std::vector<std::string> expand_glob(const std::string& pattern) {
+    std::vector<std::string> results;
+    
+    // Find directory and file pattern
+    size_t last_slash = pattern.rfind('/');
+    std::string dir_path;
+    std::string file_pattern;
+    
+    if (last_slash != std::string::npos) {
+        dir_path = pattern.substr(0, last_slash + 1);
+        file_pattern = pattern.substr(last_slash + 1);
+    } else {
+        dir_path = ".";
+        file_pattern = pattern;
+    }
+    
+    for (const auto& name : match_directory(dir_path, file_pattern)) {
+        if (dir_path != ".") {
+            results.push_back(dir_path + name);
+        } else {
+            results.push_back(name);
+        }
+    }
+    
     // If no matches, return original pattern
     if (results.empty()) {
         results.push_back(pattern);